@@ -0,0 +1,19 @@
+################################################
+#### Benchmark the decoder                  ####
+################################################
+# An optimized build without the sanitizer, so the numbers mean something.
+# Any arguments are passed on to the benchmark, for example:
+# ./bench.sh --size 256M --mix MOV=4,ADD=1,JNZ=1 --runs 3
+APP_NAME="benchmark"
+COMPILER_OPTIONS="-O2 -DNDEBUG -march=native -Wall -Wfatal-errors -x c -std=c99 -pthread"
+SOURCE="src/benchmark.c src/disassembler.c src/decoded_file.c"
+
+mkdir -p build
+
+if gcc $COMPILER_OPTIONS $SOURCE -o build/$APP_NAME; then
+echo "gcc success"
+else
+exit 1
+fi
+
+build/$APP_NAME "$@"
@@ -2,16 +2,28 @@
 #### Step 1: Produce our little console app ####
 ################################################
 APP_NAME="disassembler"
-COMPILER_OPTIONS="-fsanitize=address -g -o0 -Wall -Wfatal-errors -x c -std=c99"
-SOURCE="src/main.c"
+COMPILER_OPTIONS="-fsanitize=address -g -o0 -Wall -Wfatal-errors -x c -std=c99 -pthread"
+SOURCE="src/main.c src/disassembler.c src/decoded_file.c src/simulator.c"
 
 rm -r build
 mkdir -p build
 
+# the decoder's tables are written by src/generate_tables.c, make sure the
+# checked in src/generated_tables.h is what it writes now
+if gcc -Wall -Wfatal-errors -std=c99 src/generate_tables.c -o build/generate_tables &&
+    build/generate_tables > build/generated_tables.h &&
+    diff src/generated_tables.h build/generated_tables.h; then
+echo "tables up to date"
+else
+echo "src/generated_tables.h is out of date, update it with:"
+echo "build/generate_tables > src/generated_tables.h"
+exit 1
+fi
+
 if gcc $COMPILER_OPTIONS $SOURCE -o build/$APP_NAME; then
 echo "gcc success"
 else
-exit 0
+exit 1
 fi
 
 
@@ -36,6 +48,36 @@ if build/$APP_NAME > build/output.txt; then
     exit 0
     fi
     diff -i build/machinecode build/machinecode2
+    # patching has to give the same text as disassembling the patched bytes
+    if build/$APP_NAME --patch 6=034f02027a04 --patch 48=75fe750075fe \
+        --check build/machinecode build/patched.txt; then
+    echo "patch check success"
+    else
+    echo "patch check failed"
+    fi
+    # a file we can't decode fails on its own, the rest of the batch goes on
+    printf '\x0f\x0f\x0f' > build/bad.bin
+    mkdir -p build/batch
+    if build/$APP_NAME --batch --threads 2 build/batch \
+        build/bad.bin build/machinecode 2> build/batch_errors.txt; then
+    echo "batch check failed, the bad file didn't fail"
+    elif grep -q "build/bad.bin" build/batch_errors.txt &&
+        diff build/output.txt build/batch/machinecode.asm; then
+    echo "batch check success"
+    else
+    echo "batch check failed"
+    fi
+    # without the boundary scan every chunk guesses and resyncs, tiny chunks
+    # so the sample is split too
+    if gcc $COMPILER_OPTIONS -DPARALLEL_SKIP_SCAN -DPARALLEL_MIN_CHUNK_SIZE=16 \
+        $SOURCE -o build/${APP_NAME}_resync &&
+        build/${APP_NAME}_resync --threads 8 build/machinecode \
+            > build/resync_output.txt &&
+        diff build/output.txt build/resync_output.txt; then
+    echo "resync check success"
+    else
+    echo "resync check failed"
+    fi
 else
     echo "program exit code was 1 (failure)"
     cat build/output.txt
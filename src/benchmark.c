@@ -0,0 +1,593 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <assert.h>
+#include <time.h>
+
+#include "disassembler.h"
+
+/*
+A throughput benchmark for the decoder. We generate a big random (but valid)
+stream of 8086 instructions using every form in opcode_table, then time
+the boundary pre-scan, decoding it and writing the text separately, so a
+slowdown in one doesn't hide behind the other.
+
+Build it with bench.sh, which uses an optimized build without the sanitizer.
+*/
+
+#define CORPUS_MIN_SIZE 1024
+#define CORPUS_MAX_SIZE (1024 * 1024 * 1024)
+
+// how many instructions' lines the emit phase writes before starting over
+#define EMIT_PIECE_INSTRUCTIONS 65536
+
+// the most recent instruction starts, so jumps can land on one of them
+#define RECENT_STARTS_SIZE 64
+
+/*
+xorshift64, good enough for making up instructions and always the same
+sequence for the same seed
+*/
+static uint64_t random_state = 88172645463325252ull;
+
+static uint64_t random_u64(void) {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 7;
+    random_state ^= random_state << 17;
+    return random_state;
+}
+
+static uint8_t random_u8(void) {
+    return (uint8_t)(random_u64() >> 32);
+}
+
+static double seconds_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + ((double)now.tv_nsec / 1000000000.0);
+}
+
+/*
+Parses a size like "4096", "64K", "16M" or "1G", returns 0 if it's not one
+*/
+static uint64_t parse_size(
+    const char * text)
+{
+    uint64_t size = 0;
+    uint32_t i = 0;
+    while (text[i] >= '0' && text[i] <= '9') {
+        size = (size * 10) + (uint64_t)(text[i] - '0');
+        i += 1;
+        if (size > CORPUS_MAX_SIZE) {
+            return 0;
+        }
+    }
+    if (i == 0) {
+        return 0;
+    }
+
+    switch (text[i]) {
+        case '\0':
+            return size;
+        case 'k':
+        case 'K':
+            size *= 1024;
+            break;
+        case 'm':
+        case 'M':
+            size *= 1024 * 1024;
+            break;
+        case 'g':
+        case 'G':
+            size *= 1024 * 1024 * 1024;
+            break;
+        default:
+            return 0;
+    }
+
+    if (text[i + 1] != '\0' && text[i + 1] != 'B' && text[i + 1] != 'b') {
+        return 0;
+    }
+    return size;
+}
+
+/*
+Parses a mix like "MOV=4,ADD=1,JNZ=2" into a weight per opcode_table entry.
+Every form of a mnemonic gets its weight, mnemonics that aren't in the mix get
+0. Returns false if a mnemonic doesn't exist or the weights are all 0
+*/
+static uint32_t parse_mix(
+    const char * text,
+    uint32_t * weights)
+{
+    for (uint32_t op_i = 0; op_i < opcode_table_size; op_i++) {
+        weights[op_i] = 0;
+    }
+
+    uint32_t total_weight = 0;
+    uint32_t i = 0;
+    while (text[i] != '\0') {
+        char mnemonic[10];
+        uint32_t mnemonic_size = 0;
+        while (
+            text[i] != '\0' &&
+            text[i] != '=' &&
+            text[i] != ',' &&
+            mnemonic_size + 1 < sizeof(mnemonic))
+        {
+            char c = text[i];
+            if (c >= 'a' && c <= 'z') {
+                c = (char)(c - 'a' + 'A');
+            }
+            mnemonic[mnemonic_size++] = c;
+            i += 1;
+        }
+        mnemonic[mnemonic_size] = '\0';
+
+        uint32_t weight = 1;
+        if (text[i] == '=') {
+            i += 1;
+            weight = 0;
+            while (text[i] >= '0' && text[i] <= '9') {
+                weight = (weight * 10) + (uint32_t)(text[i] - '0');
+                i += 1;
+            }
+        }
+        if (text[i] == ',') {
+            i += 1;
+        } else if (text[i] != '\0') {
+            printf("bad --mix near \"%s\"\n", text + i);
+            return false;
+        }
+
+        uint32_t found = false;
+        for (uint32_t op_i = 0; op_i < opcode_table_size; op_i++) {
+            if (are_equal_strings(opcode_table[op_i].text, mnemonic)) {
+                weights[op_i] = weight;
+                total_weight += weight;
+                found = true;
+            }
+        }
+        if (!found) {
+            printf("--mix: there is no opcode called %s\n", mnemonic);
+            return false;
+        }
+    }
+
+    if (total_weight == 0) {
+        printf("--mix needs at least 1 opcode with a weight above 0\n");
+        return false;
+    }
+    return true;
+}
+
+/*
+Writes 1 random instruction of the form 'opcode' to 'recipient' and returns
+its size in bytes, or 0 if the random fields happened to make it decode as a
+different opcode (the caller just tries again).
+
+Jumps only go back to one of the 'recent_starts' within reach, or to the
+next instruction, so every jump has a label and the corpus disassembles
+without warnings.
+*/
+static uint32_t generate_instruction(
+    const OpCode * opcode,
+    const uint32_t offset,
+    const uint32_t * recent_starts,
+    const uint32_t recent_starts_size,
+    uint8_t * recipient)
+{
+    // the opcode bits go on top, every other bit of the header is random
+    uint16_t header = (uint16_t)random_u64();
+    uint32_t opcode_shift = 16 - opcode->size_in_bits;
+    header &= (uint16_t)((1u << opcode_shift) - 1);
+    header |= (uint16_t)(opcode->number << opcode_shift);
+    if (opcode->has_secondary_3bit_opcode) {
+        header &= (uint16_t)~(7 << 3);
+        header |= (uint16_t)(opcode->secondary_3bit_opcode << 3);
+    }
+
+    uint8_t first_byte = (uint8_t)(header >> 8);
+    uint8_t second_byte = 0;
+    if (opcode->header_bytes > 1) {
+        second_byte = (uint8_t)header;
+    }
+    if (lookup_opcode(first_byte, second_byte) != opcode) {
+        return 0;
+    }
+
+    uint8_t w = 0;
+    if (opcode->has_w_field) {
+        w = (header >> opcode->w_shift) & 1;
+    }
+    uint8_t s = 0;
+    if (opcode->has_s_field) {
+        s = (header >> opcode->s_shift) & 1;
+    }
+
+    uint32_t size = 0;
+    recipient[size++] = first_byte;
+    if (opcode->header_bytes > 1) {
+        recipient[size++] = second_byte;
+    }
+
+    if (opcode->has_mod) {
+        uint8_t mod = (header >> opcode->mod_shift) & 3;
+        uint8_t r_m = (header >> opcode->rm_shift) & 7;
+        uint32_t displacement_bytes = 0;
+        if (mod == 1) {
+            displacement_bytes = 1;
+        } else if (mod == 2 || (mod == 0 && r_m == 6)) {
+            displacement_bytes = 2;
+        }
+        for (uint32_t i = 0; i < displacement_bytes; i++) {
+            recipient[size++] = random_u8();
+        }
+    }
+
+    if (!opcode->has_data_byte_1) {
+        return size;
+    }
+
+    if (opcode->data_bytes_are_jump_offsets) {
+        // all our jumps are rel8 and relative to the end of the jump
+        int32_t jump = 0;
+        if (recent_starts_size > 0 && (random_u64() & 3) != 0) {
+            uint32_t target =
+                recent_starts[random_u64() % recent_starts_size];
+            jump = (int32_t)target - (int32_t)(offset + size + 1);
+        }
+        if (jump < -128) {
+            jump = 0;
+        }
+        recipient[size++] = (uint8_t)(int8_t)jump;
+        return size;
+    }
+
+    recipient[size++] = random_u8();
+    if (
+        opcode->has_data_byte_2_always ||
+        (opcode->has_data_byte_2_if_w && w && (!opcode->has_s_field || !s)))
+    {
+        recipient[size++] = random_u8();
+    }
+
+    return size;
+}
+
+/*
+Fills 'recipient' with 'corpus_size' bytes of whole instructions, picking
+each opcode_table form with probability weights[i] / (sum of weights)
+*/
+static uint32_t generate_corpus(
+    uint8_t * recipient,
+    const uint32_t corpus_size,
+    const uint32_t * weights)
+{
+    uint32_t total_weight = 0;
+    for (uint32_t op_i = 0; op_i < opcode_table_size; op_i++) {
+        if (opcode_table[op_i].text[0] != '\0') {
+            total_weight += weights[op_i];
+        }
+    }
+    assert(total_weight > 0);
+
+    uint32_t recent_starts[RECENT_STARTS_SIZE];
+    uint32_t recent_starts_size = 0;
+    uint32_t instructions_count = 0;
+
+    // stop while there's still room for the longest instruction
+    uint32_t offset = 0;
+    while (offset + 8 <= corpus_size) {
+        uint32_t pick = (uint32_t)(random_u64() % total_weight);
+        uint32_t op_i = 0;
+        while (
+            opcode_table[op_i].text[0] == '\0' ||
+            pick >= weights[op_i])
+        {
+            if (opcode_table[op_i].text[0] != '\0') {
+                pick -= weights[op_i];
+            }
+            op_i += 1;
+        }
+
+        uint8_t instruction[8];
+        uint32_t instruction_size = generate_instruction(
+            /* const OpCode * opcode: */
+                &opcode_table[op_i],
+            /* const uint32_t offset: */
+                offset,
+            /* const uint32_t * recent_starts: */
+                recent_starts,
+            /* const uint32_t recent_starts_size: */
+                recent_starts_size,
+            /* uint8_t * recipient: */
+                instruction);
+
+        if (instruction_size == 0) {
+            continue;
+        }
+
+        for (uint32_t i = 0; i < instruction_size; i++) {
+            recipient[offset + i] = instruction[i];
+        }
+
+        // only keep the starts a rel8 jump from here could still reach
+        uint32_t keep = 0;
+        for (uint32_t i = 0; i < recent_starts_size; i++) {
+            if (recent_starts[i] + 120 >= offset) {
+                recent_starts[keep++] = recent_starts[i];
+            }
+        }
+        recent_starts_size = keep;
+        if (recent_starts_size < RECENT_STARTS_SIZE) {
+            recent_starts[recent_starts_size++] = offset;
+        }
+
+        offset += instruction_size;
+        instructions_count += 1;
+    }
+
+    /*
+    Fill the last 2 to 7 bytes with 'cmp al, imm8' (2 bytes) and, if that
+    leaves an odd gap, 1 'cmp ax, imm16' (3 bytes). Not jumps, because a jump
+    to the next instruction would land on the end of the input here
+    */
+    while (offset < corpus_size) {
+        uint32_t left = corpus_size - offset;
+        assert(left >= 2);
+        recipient[offset] = CMP_IMMTOACC << 1;
+        recipient[offset + 1] = random_u8();
+        if (left % 2 == 1) {
+            recipient[offset] |= 1;
+            recipient[offset + 2] = random_u8();
+            offset += 1;
+        }
+        offset += 2;
+        instructions_count += 1;
+    }
+
+    return instructions_count;
+}
+
+static void print_rate(
+    const char * what,
+    const double seconds,
+    const uint64_t input_bytes,
+    const uint64_t instructions_count)
+{
+    printf(
+        "%-8s %9.3f ms %10.1f MB/s %10.2f M instructions/s\n",
+        what,
+        seconds * 1000.0,
+        ((double)input_bytes / (1024.0 * 1024.0)) / seconds,
+        ((double)instructions_count / 1000000.0) / seconds);
+}
+
+/*
+usage:
+benchmark [--size bytes] [--mix MNEMONIC=weight,...] [--runs count]
+    [--seed number] [--save corpus_file]
+
+--size accepts K, M and G suffixes, from 1K up to 1G (default 16M)
+--mix only generates the listed mnemonics, each form of a mnemonic gets its
+weight (default: every form in opcode_table with weight 1)
+--runs times the boundary scan, decode and emission this many times and
+reports the fastest
+--save also writes the corpus to a file, so you can feed it to the
+disassembler itself
+*/
+int main(int argc, char * argv[]) {
+
+    uint64_t corpus_size = 16 * 1024 * 1024;
+    uint32_t runs = 5;
+    const char * mix = NULL;
+    const char * save_filename = NULL;
+
+    for (int32_t arg_i = 1; arg_i < argc; arg_i++) {
+        if (arg_i + 1 >= argc) {
+            printf("missing value for %s\n", argv[arg_i]);
+            return 1;
+        }
+
+        if (are_equal_strings(argv[arg_i], "--size")) {
+            corpus_size = parse_size(argv[++arg_i]);
+        } else if (are_equal_strings(argv[arg_i], "--mix")) {
+            mix = argv[++arg_i];
+        } else if (are_equal_strings(argv[arg_i], "--runs")) {
+            runs = (uint32_t)atoi(argv[++arg_i]);
+        } else if (are_equal_strings(argv[arg_i], "--seed")) {
+            random_state = strtoull(argv[++arg_i], NULL, 10);
+            if (random_state == 0) {
+                // xorshift gets stuck on 0
+                random_state = 1;
+            }
+        } else if (are_equal_strings(argv[arg_i], "--save")) {
+            save_filename = argv[++arg_i];
+        } else {
+            printf("unknown argument %s\n", argv[arg_i]);
+            return 1;
+        }
+    }
+
+    if (corpus_size < CORPUS_MIN_SIZE || corpus_size > CORPUS_MAX_SIZE) {
+        printf("--size must be between 1K and 1G\n");
+        return 1;
+    }
+    if (runs == 0) {
+        runs = 1;
+    }
+
+    uint32_t * weights =
+        (uint32_t *)malloc(sizeof(uint32_t) * opcode_table_size);
+    if (mix != NULL) {
+        if (!parse_mix(mix, weights)) {
+            return 1;
+        }
+    } else {
+        for (uint32_t op_i = 0; op_i < opcode_table_size; op_i++) {
+            weights[op_i] = 1;
+        }
+    }
+
+    uint8_t * corpus = (uint8_t *)malloc(corpus_size);
+    if (corpus == NULL) {
+        printf("failed to allocate a %llu byte corpus\n",
+            (unsigned long long)corpus_size);
+        return 1;
+    }
+
+    double generate_start = seconds_now();
+    uint32_t instructions_count = generate_corpus(
+        /* uint8_t * recipient: */
+            corpus,
+        /* const uint32_t corpus_size: */
+            (uint32_t)corpus_size,
+        /* const uint32_t * weights: */
+            weights);
+    double generate_seconds = seconds_now() - generate_start;
+
+    printf(
+        "corpus: %llu bytes, %u instructions, generated in %.1f ms\n",
+        (unsigned long long)corpus_size,
+        instructions_count,
+        generate_seconds * 1000.0);
+
+    if (save_filename != NULL) {
+        FILE * save_file = fopen(save_filename, "wb");
+        if (
+            save_file == NULL ||
+            fwrite(corpus, 1, corpus_size, save_file) != corpus_size)
+        {
+            printf("failed to write the corpus to %s\n", save_filename);
+            return 1;
+        }
+        fclose(save_file);
+    }
+
+    DecoderContext decoder;
+    decoder_init(&decoder);
+    OutputBuffer recipient;
+    output_init(&recipient, 64);
+
+    uint64_t * boundaries =
+        (uint64_t *)malloc(sizeof(uint64_t) * ((corpus_size + 63) / 64));
+
+    double best_scan_seconds = 0.0;
+    double best_decode_seconds = 0.0;
+    double best_emit_seconds = 0.0;
+    uint64_t text_size = 0;
+    for (uint32_t run_i = 0; run_i < runs; run_i++) {
+        uint32_t good = false;
+
+        double scan_start = seconds_now();
+        uint32_t scanned_size = scan_instruction_boundaries(
+            /* const uint8_t * input: */
+                corpus,
+            /* const uint32_t input_size: */
+                (uint32_t)corpus_size,
+            /* uint64_t * boundaries: */
+                boundaries);
+        double scan_seconds = seconds_now() - scan_start;
+
+        if (scanned_size != corpus_size) {
+            printf("scanning the corpus stopped at offset %u\n", scanned_size);
+            return 1;
+        }
+
+        double decode_start = seconds_now();
+        decode_all_instructions(
+            /* DecoderContext * decoder: */
+                &decoder,
+            /* const uint8_t * input: */
+                corpus,
+            /* const uint32_t input_size: */
+                (uint32_t)corpus_size,
+            /* uint32_t * good: */
+                &good);
+        double decode_seconds = seconds_now() - decode_start;
+
+        if (!good || decoder.instructions_size != instructions_count) {
+            printf(
+                "decoding the corpus failed (%u of %u instructions)\n",
+                decoder.instructions_size,
+                instructions_count);
+            return 1;
+        }
+
+        /*
+        The text is about 9 times the corpus, so we write it a piece at a
+        time into the same buffer, like --stream flushes it, instead of
+        holding all of it
+        */
+        double emit_start = seconds_now();
+        text_size = 0;
+        for (
+            uint32_t first_i = 0;
+            first_i < decoder.instructions_size;
+            first_i += EMIT_PIECE_INSTRUCTIONS)
+        {
+            uint32_t end_i = first_i + EMIT_PIECE_INSTRUCTIONS;
+            if (end_i > decoder.instructions_size) {
+                end_i = decoder.instructions_size;
+            }
+            recipient.size = 0;
+            recipient.text[0] = '\0';
+            if (first_i == 0) {
+                output_append(&recipient, "bits 16\n");
+            }
+            append_decoded_lines(
+                /* DecoderContext * decoder: */
+                    &decoder,
+                /* const uint32_t first_instruction: */
+                    first_i,
+                /* const uint32_t end_instruction: */
+                    end_i,
+                /* OutputBuffer * recipient: */
+                    &recipient);
+            text_size += recipient.size;
+        }
+        double emit_seconds = seconds_now() - emit_start;
+
+        if (run_i == 0 || scan_seconds < best_scan_seconds) {
+            best_scan_seconds = scan_seconds;
+        }
+        if (run_i == 0 || decode_seconds < best_decode_seconds) {
+            best_decode_seconds = decode_seconds;
+        }
+        if (run_i == 0 || emit_seconds < best_emit_seconds) {
+            best_emit_seconds = emit_seconds;
+        }
+    }
+
+    printf("best of %u runs:\n", runs);
+    print_rate(
+        "scan",
+        best_scan_seconds,
+        corpus_size,
+        instructions_count);
+    print_rate(
+        "decode",
+        best_decode_seconds,
+        corpus_size,
+        instructions_count);
+    print_rate(
+        "emit",
+        best_emit_seconds,
+        corpus_size,
+        instructions_count);
+    printf(
+        "text:    %llu bytes, %.1f MB/s written\n",
+        (unsigned long long)text_size,
+        ((double)text_size / (1024.0 * 1024.0)) / best_emit_seconds);
+
+    decoder_free(&decoder);
+    free(recipient.text);
+    free(corpus);
+    free(weights);
+    free(boundaries);
+
+    return 0;
+}
@@ -0,0 +1,170 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#include "decoded_file.h"
+
+uint32_t open_decoded_file(
+    DecodedFileReader * reader,
+    const uint8_t * data,
+    const uint64_t data_size)
+{
+    reader->header = NULL;
+    reader->record_format = DECODED_RECORDS_FULL;
+    reader->opcodes = NULL;
+    reader->records = NULL;
+    reader->label_ids = NULL;
+    reader->label_ids_size = 0;
+    reader->next_record_i = 0;
+    reader->next_label_id_i = 0;
+    reader->next_offset = 0;
+
+    const DecodedFileHeader * header = (const DecodedFileHeader *)data;
+    if (data_size < DECODED_FILE_V1_HEADER_SIZE) {
+        fprintf(stderr, "Error - too small to be a decoded file\n");
+        return false;
+    }
+    for (uint32_t i = 0; i < sizeof(header->magic); i++) {
+        if (header->magic[i] != DECODED_FILE_MAGIC[i]) {
+            fprintf(stderr, "Error - not a decoded file\n");
+            return false;
+        }
+    }
+    if (header->byte_order != DECODED_FILE_BYTE_ORDER) {
+        fprintf(stderr, "Error - the decoded file has the other byte order\n");
+        return false;
+    }
+    if (header->version > DECODED_FILE_VERSION) {
+        fprintf(
+            stderr,
+            "Error - the decoded file is version %u, we only read up to %u\n",
+            header->version,
+            DECODED_FILE_VERSION);
+        return false;
+    }
+
+    // version 1 headers end before record_format
+    uint32_t record_format = DECODED_RECORDS_FULL;
+    uint32_t label_ids_size = 0;
+    uint32_t header_size = DECODED_FILE_V1_HEADER_SIZE;
+    if (header->version >= 2) {
+        if (data_size < sizeof(DecodedFileHeader)) {
+            fprintf(stderr, "Error - too small to be a decoded file\n");
+            return false;
+        }
+        record_format = header->record_format;
+        label_ids_size = header->label_ids_size;
+        header_size = sizeof(DecodedFileHeader);
+    }
+    uint32_t record_size = sizeof(DecodedRecord);
+    if (record_format == DECODED_RECORDS_COMPACT) {
+        record_size = sizeof(DecodedCompactRecord);
+    } else if (record_format != DECODED_RECORDS_FULL) {
+        fprintf(
+            stderr,
+            "Error - the decoded file's records are in format %u, we only "
+            "know %u and %u\n",
+            record_format,
+            DECODED_RECORDS_FULL,
+            DECODED_RECORDS_COMPACT);
+        return false;
+    }
+
+    // newer versions can only make these bigger
+    if (
+        header->header_size < header_size ||
+        header->opcode_size < sizeof(DecodedFileOpcode) ||
+        header->record_size < record_size)
+    {
+        fprintf(stderr, "Error - the decoded file's header is broken\n");
+        return false;
+    }
+
+    uint64_t records_start =
+        (uint64_t)header->header_size +
+        ((uint64_t)header->opcodes_size * header->opcode_size);
+    uint64_t label_ids_start =
+        records_start +
+        ((uint64_t)header->records_size * header->record_size);
+    uint64_t file_size =
+        label_ids_start + ((uint64_t)label_ids_size * sizeof(int32_t));
+    if (data_size < file_size) {
+        fprintf(
+            stderr,
+            "Error - the decoded file should be %llu bytes, it's %llu\n",
+            (unsigned long long)file_size,
+            (unsigned long long)data_size);
+        return false;
+    }
+
+    reader->header = header;
+    reader->record_format = record_format;
+    reader->opcodes = data + header->header_size;
+    reader->records = data + records_start;
+    reader->label_ids = (const int32_t *)(data + label_ids_start);
+    reader->label_ids_size = label_ids_size;
+    return true;
+}
+
+const DecodedRecord * next_decoded_record(
+    DecodedFileReader * reader)
+{
+    if (reader->next_record_i >= reader->header->records_size) {
+        return NULL;
+    }
+    if (reader->record_format == DECODED_RECORDS_FULL) {
+        return decoded_record_at(reader, reader->next_record_i++);
+    }
+
+    const DecodedCompactRecord * compact = (const DecodedCompactRecord *)(
+        reader->records +
+        ((uint64_t)reader->next_record_i * reader->header->record_size));
+    DecodedRecord * record = &reader->unpacked;
+    record->label_id = -1;
+    record->jump_label_id = -1;
+    if (compact->flags & DECODED_RECORD_LABEL) {
+        if (reader->next_label_id_i >= reader->label_ids_size) {
+            return NULL;
+        }
+        record->label_id = reader->label_ids[reader->next_label_id_i++];
+    }
+    if (compact->flags & DECODED_RECORD_JUMP_LABEL) {
+        if (reader->next_label_id_i >= reader->label_ids_size) {
+            return NULL;
+        }
+        record->jump_label_id = reader->label_ids[reader->next_label_id_i++];
+    }
+
+    record->offset = reader->next_offset;
+    record->displacement = compact->displacement;
+    record->data = compact->data;
+    record->opcode_i = compact->opcode_i;
+    record->machine_bytes = compact->flags >> DECODED_RECORD_BYTES_SHIFT;
+    record->first_operand = compact->operands & 15;
+    record->second_operand = compact->operands >> 4;
+    record->flags = compact->flags & (DECODED_RECORD_D | DECODED_RECORD_W);
+    record->mod = compact->mod_reg_r_m >> 6;
+    record->reg = (compact->mod_reg_r_m >> 3) & 7;
+    record->r_m = compact->mod_reg_r_m & 7;
+
+    reader->next_offset += record->machine_bytes;
+    reader->next_record_i += 1;
+    return record;
+}
+
+const DecodedRecord * decoded_record_at(
+    const DecodedFileReader * reader,
+    const uint32_t record_i)
+{
+    return (const DecodedRecord *)(
+        reader->records +
+        ((uint64_t)record_i * reader->header->record_size));
+}
+
+const DecodedFileOpcode * decoded_opcode_at(
+    const DecodedFileReader * reader,
+    const uint32_t opcode_i)
+{
+    return (const DecodedFileOpcode *)(
+        reader->opcodes +
+        ((uint64_t)opcode_i * reader->header->opcode_size));
+}
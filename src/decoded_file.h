@@ -0,0 +1,180 @@
+#ifndef DECODED_FILE_H
+#define DECODED_FILE_H
+
+#include <stdint.h>
+
+#ifndef true
+#define true 1
+#endif
+#ifndef false
+#define false 0
+#endif
+
+/*
+A binary alternative to the nasm text, for tools that want the decoded
+instructions without parsing text again. It's laid out so a reader can mmap
+the file and use the records where they are, nothing has to be copied or
+parsed (see open_decoded_file()).
+
+The file is, with no gaps:
+    DecodedFileHeader
+    DecodedFileOpcode * header.opcodes_size   (header.opcode_size each)
+    DecodedRecord * header.records_size       (header.record_size each)
+
+Every number is in the byte order of the machine that wrote the file, which
+'byte_order' tells you. A newer version may make the header, the opcodes or
+the records bigger, but only by adding fields at the end, so walk them with
+the sizes in the header rather than with sizeof().
+
+Since version 2 the records can also be DecodedCompactRecords (see
+'record_format'), 3 times smaller but only readable in order, then the
+label ids they need follow them:
+    DecodedCompactRecord * header.records_size
+    int32_t * header.label_ids_size
+Version 1 files have a 48 byte header without record_format and
+label_ids_size, and always full records
+*/
+#define DECODED_FILE_MAGIC "8086dec" // + the '\0', 8 bytes
+#define DECODED_FILE_VERSION 2
+#define DECODED_FILE_BYTE_ORDER 0x01020304
+#define DECODED_FILE_V1_HEADER_SIZE 48
+
+// record formats of a decoded file
+#define DECODED_RECORDS_FULL 0 // DecodedRecords, usable in place
+#define DECODED_RECORDS_COMPACT 1 // DecodedCompactRecords + label ids
+
+typedef struct DecodedFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order; // DECODED_FILE_BYTE_ORDER as the writer stored it
+    uint32_t header_size;
+    uint32_t opcode_size;
+    uint32_t record_size;
+    uint32_t opcodes_size;
+    uint32_t records_size;
+    uint32_t labels_size; // label ids go from 0 to labels_size - 1
+    uint32_t input_size; // of the machine code that was decoded
+    uint32_t record_format; // DECODED_RECORDS_FULL or _COMPACT, since v2
+    uint32_t label_ids_size; // after compact records, since v2
+    uint32_t reserved; // 0, keeps the header a multiple of 8 bytes
+} DecodedFileHeader;
+
+/*
+The opcode forms the records refer to, in opcode_table order. This is the
+only text in the file, so the records don't need any
+*/
+typedef struct DecodedFileOpcode {
+    char text[10]; // the mnemonic, '\0'-terminated
+    uint8_t number; // the opcode bits
+    uint8_t size_in_bits;
+    uint8_t has_s_field;
+    uint8_t reserved[3];
+} DecodedFileOpcode;
+
+// flags of a DecodedRecord
+#define DECODED_RECORD_D 1 // the first operand is the destination
+#define DECODED_RECORD_W 2 // a word operation, otherwise a byte operation
+
+/*
+1 instruction, in the order of the input. The operands are numbers, like in
+DecodedInstruction (see disassembler.h):
+- first_operand and second_operand are OperandKinds: 0 none, 1 a register,
+  2 memory, 3 a direct address, 4 immediate data, 5 a jump offset
+- a register is 'reg' for the first operand and 'r_m' for the second, in the
+  8086's register order (AL CL DL BL AH CH DH BH, or AX CX DX BX SP BP SI DI
+  with the W flag)
+- memory is [registers + displacement], the registers picked by 'mod' and
+  'r_m' like in the 8086 manual (r_m 0 is BX+SI, 1 BX+DI, 2 BP+SI, 3 BP+DI,
+  4 SI, 5 DI, 6 BP, 7 BX)
+- a direct address is [displacement]
+- immediate data and jump offsets are 'data', a jump offset counts from the
+  end of the jump
+*/
+typedef struct DecodedRecord {
+    uint32_t offset; // in bytes, from the start of the input
+    int32_t label_id; // -1 if nothing jumps here
+    int32_t jump_label_id; // -1 if this isn't a jump or it has no target
+    int16_t displacement;
+    int16_t data;
+    uint8_t opcode_i; // which of the file's opcodes
+    uint8_t machine_bytes;
+    uint8_t first_operand;
+    uint8_t second_operand;
+    uint8_t flags; // DECODED_RECORD_D and DECODED_RECORD_W
+    uint8_t mod;
+    uint8_t reg;
+    uint8_t r_m;
+} DecodedRecord;
+
+// flags of a DecodedCompactRecord, on top of DECODED_RECORD_D and _W
+#define DECODED_RECORD_LABEL 4 // its label_id is the next label id
+#define DECODED_RECORD_JUMP_LABEL 8 // its jump_label_id is the next 1 after
+#define DECODED_RECORD_BYTES_SHIFT 4 // machine_bytes are the top 4 bits
+
+/*
+A DecodedRecord packed into 8 bytes, for files that are only read from
+start to end (like the decode cache's). What it leaves out follows from the
+records before it:
+- the offset is where the previous record's machine bytes end (0 for the
+  first 1)
+- the label ids that aren't -1 are in the file's label ids, in record
+  order, a record's label_id before its jump_label_id
+*/
+typedef struct DecodedCompactRecord {
+    int16_t displacement;
+    int16_t data;
+    uint8_t opcode_i;
+    uint8_t mod_reg_r_m; // mod << 6 | reg << 3 | r_m
+    uint8_t operands; // first_operand | second_operand << 4
+    uint8_t flags; // the DECODED_RECORD_ flags | machine_bytes << 4
+} DecodedCompactRecord;
+
+/*
+Reads a decoded file in place. Everything points into the caller's bytes
+*/
+typedef struct DecodedFileReader {
+    const DecodedFileHeader * header;
+    uint32_t record_format; // DECODED_RECORDS_FULL for version 1 files
+    const uint8_t * opcodes; // header->opcode_size apart
+    const uint8_t * records; // header->record_size apart
+    const int32_t * label_ids; // after compact records
+    uint32_t label_ids_size;
+    uint32_t next_record_i;
+    uint32_t next_label_id_i;
+    uint32_t next_offset;
+    DecodedRecord unpacked; // the compact record next_decoded_record() read
+} DecodedFileReader;
+
+/*
+Points 'reader' at the decoded file in 'data' (for example an mmap'd file,
+which has to stay mapped while you use the reader). Returns false, and says
+why on stderr, if it's not a decoded file we can read: a different magic,
+a newer version, the other byte order, a record format we don't know or
+less data than the header says
+*/
+uint32_t open_decoded_file(
+    DecodedFileReader * reader,
+    const uint8_t * data,
+    const uint64_t data_size);
+
+/*
+The next record in either format, or NULL after the last 1. A compact
+record is unpacked into the reader, so the record only lasts until the next
+call. Also NULL (before the last record) if a compact file runs out of
+label ids, compare reader->next_record_i to the header's records_size
+*/
+const DecodedRecord * next_decoded_record(
+    DecodedFileReader * reader);
+
+/*
+Any record, in place. Only for DECODED_RECORDS_FULL files
+*/
+const DecodedRecord * decoded_record_at(
+    const DecodedFileReader * reader,
+    const uint32_t record_i);
+
+const DecodedFileOpcode * decoded_opcode_at(
+    const DecodedFileReader * reader,
+    const uint32_t opcode_i);
+
+#endif
@@ -0,0 +1,3400 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(INSTRUMENT) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#endif
+
+#include "disassembler.h"
+
+static void print_binary(
+    const uint8_t input)
+{
+    for (int32_t i = 7; i >= 0; i--) {
+        fprintf(stderr, "%u", (input >> i) & 1);
+    }
+}
+
+uint32_t are_equal_strings(
+    const char * a,
+    const char * b)
+{
+    uint32_t i = 0;
+    while (a[i] == b[i]) {
+        if (a[i] == '\0') {
+            return true;
+        }
+        i++;
+    }
+    return false;
+}
+
+void output_init(
+    OutputBuffer * output,
+    size_t initial_cap)
+{
+    assert(initial_cap > 0);
+    output->text = (char *)malloc(initial_cap);
+    assert(output->text != NULL);
+    output->text[0] = '\0';
+    output->size = 0;
+    output->cap = initial_cap;
+}
+
+static void output_reserve(
+    OutputBuffer * output,
+    size_t extra_chars)
+{
+    // + 1 for the '\0' terminator
+    if (extra_chars > SIZE_MAX - 1 - output->size) {
+        fprintf(
+            stderr,
+            "Error - the output text is too big to hold in memory\n");
+        exit(1);
+    }
+    size_t needed_cap = output->size + extra_chars + 1;
+    if (needed_cap <= output->cap) {
+        return;
+    }
+
+    // doubling past SIZE_MAX would wrap, so the last step takes just enough
+    size_t new_cap = output->cap;
+    while (new_cap < needed_cap) {
+        if (new_cap > SIZE_MAX / 2) {
+            new_cap = needed_cap;
+        } else {
+            new_cap *= 2;
+        }
+    }
+
+    char * new_text = (char *)realloc(output->text, new_cap);
+    if (new_text == NULL) {
+        fprintf(
+            stderr,
+            "Error - out of memory for %llu bytes of output text\n",
+            (unsigned long long)new_cap);
+        exit(1);
+    }
+    output->text = new_text;
+    output->cap = new_cap;
+}
+
+void output_append(
+    OutputBuffer * output,
+    const char * to_append)
+{
+    uint32_t length = 0;
+    while (to_append[length] != '\0') {
+        length++;
+    }
+    INSTRUMENT_COUNT(output_bytes_scanned, length);
+
+    output_reserve(output, length);
+
+    for (uint32_t i = 0; i < length; i++) {
+        output->text[output->size++] = to_append[i];
+    }
+    output->text[output->size] = '\0';
+}
+
+void output_append_uint(
+    OutputBuffer * output,
+    uint32_t to_append)
+{
+    // uint32_t has at most 10 digits, we write them backwards
+    char digits[10];
+    uint32_t digits_size = 0;
+    do {
+        digits[digits_size++] = '0' + (to_append % 10);
+        to_append /= 10;
+    } while (to_append > 0);
+
+    output_reserve(output, digits_size);
+
+    while (digits_size > 0) {
+        output->text[output->size++] = digits[--digits_size];
+    }
+    output->text[output->size] = '\0';
+}
+
+void output_append_uint64(
+    OutputBuffer * output,
+    uint64_t to_append)
+{
+    // uint64_t has at most 20 digits
+    char digits[20];
+    uint32_t digits_size = 0;
+    do {
+        digits[digits_size++] = '0' + (to_append % 10);
+        to_append /= 10;
+    } while (to_append > 0);
+
+    output_reserve(output, digits_size);
+
+    while (digits_size > 0) {
+        output->text[output->size++] = digits[--digits_size];
+    }
+    output->text[output->size] = '\0';
+}
+
+void output_append_int(
+    OutputBuffer * output,
+    int32_t to_append)
+{
+    if (to_append < 0) {
+        output_append(output, "-");
+        output_append_uint(output, (uint32_t)(-(int64_t)to_append));
+    } else {
+        output_append_uint(output, (uint32_t)to_append);
+    }
+}
+
+/*
+opcode_table, opcode_table_size, reg_table and modsub3_rm_table, and 2 lookup
+tables for the decoder:
+
+The opcode dispatch table maps the first byte of an instruction directly to
+its entry in opcode_table, so we don't have to search the table at every
+possible opcode length.
+
+Some opcodes (like ADD/SUB/CMP 100000) share the same first byte and are only
+told apart by a secondary 3-bit opcode in the 'reg' field of the 2nd byte, so
+the table is also indexed by those 3 bits. For opcodes that don't have a
+secondary opcode, all 8 slots point to the same entry.
+                                  first byte  secondary 3 bits
+                                       |       |
+    static const uint8_t opcode_dispatch_table[256][8]
+
+The reg field and r/m (register/memory) field refer to registers on the cpu,
+reg_table and modsub3_rm_table turn their 3 bits into text (like "BP"):
+
+- reg_table is always used to decode the 'reg' field, regardless of the mod
+- reg_table is also used to decode the 'r/m' if and only if mod = 3
+is indexed by the value from the 'w' bit and then by 'r/m' to yield 3 chars
+                      w  rm 3 chars
+                      |  |  |
+    const char reg_table[2][8][3]
+
+The modsub3 rm table shows the r/m for mods 'below 3' (so 00, 01, and 10)
+If you are decoding the REG field, you DON'T use this table for any mod
+it's indexed by the values in mod and r/m, and yields 15 chars
+                            mod rm 15 chars
+                             |  |  |
+    const char modsub3_rm_table[3][8][15]
+
+And by the whole ModRM byte, how many displacement bytes follow it:
+    static const uint8_t modrm_displacement_bytes[256]
+
+And indexed like the dispatch table, how long the instruction is without its
+displacement (plus OPCODE_LENGTH_PLUS_DISPLACEMENT if it has a ModRM byte):
+    static const uint8_t opcode_length_table[256][8]
+
+And a hash of all of them, so anything we store can tell which tables it was
+decoded with:
+    const uint64_t opcode_table_version
+*/
+#include "generated_tables.h"
+
+const OpCode * lookup_opcode(
+    const uint8_t first_byte,
+    const uint8_t second_byte)
+{
+    INSTRUMENT_COUNT(opcode_table_probes, 1);
+    uint8_t op_i = opcode_dispatch_table[first_byte][(second_byte >> 3) & 7];
+    if (op_i == OPCODE_NONE) {
+        return NULL;
+    }
+    return &opcode_table[op_i];
+}
+
+/*
+Decodes 1 instruction starting at input[bytes_consumed] into 'instruction'
+and advances the decoder's bytes_consumed past it
+*/
+static void decode_instruction(
+    DecoderContext * decoder,
+    DecodedInstruction * instruction,
+    uint32_t * good)
+{
+    uint32_t bytes_consumed_at_sol = decoder->bytes_consumed;
+    assert(bytes_consumed_at_sol < decoder->input_size);
+    uint32_t bytes_left = decoder->input_size - bytes_consumed_at_sol;
+    const uint8_t * next_bytes = decoder->input + bytes_consumed_at_sol;
+    
+    /*
+    The secondary opcode lives in the 'reg' field of the 2nd byte. If
+    there is no 2nd byte, only opcodes without a secondary opcode can
+    match, and those are in every slot
+    */
+    uint8_t second_byte = 0;
+    if (bytes_left > 1) {
+        second_byte = next_bytes[1];
+    }
+    
+    INSTRUMENT_SAMPLED_START(PHASE_OPCODE_LOOKUP, lookup_start);
+    const OpCode * opcode = lookup_opcode(next_bytes[0], second_byte);
+    INSTRUMENT_SAMPLED_END(PHASE_OPCODE_LOOKUP, lookup_start);
+    INSTRUMENT_SAMPLED_START(PHASE_FIELD_EXTRACTION, fields_start);
+    
+    if (opcode == NULL) {
+        if (decoder->speculative) {
+            // decoding from a guessed offset, failing is expected sometimes
+            *good = false;
+            return;
+        }
+        /*
+        Not fatal, the caller decides what a failed input means. A batch
+        carries on with its other files
+        */
+        uint8_t try_opcode = next_bytes[0];
+        fprintf(
+            stderr,
+            "Error - no opcode we know at offset %u: %u - ",
+            bytes_consumed_at_sol,
+            try_opcode);
+        print_binary(try_opcode);
+        fprintf(stderr, "\n");
+        *good = false;
+        return;
+    }
+    
+    /*
+    Load the opcode byte and the ModRM byte (if any) once, every field is
+    then just a shift and a mask with the positions generate_tables.c
+    stored in the opcode
+    */
+    uint16_t header = (uint16_t)(next_bytes[0] << 8);
+    if (opcode->header_bytes > 1) {
+        header |= second_byte;
+    }
+    
+    // the 'd' field generally specifies the 'direction',
+    // to or from register?
+    // 0 means the left hand registry is the destination
+    // 1 means the REG field in the second byte is the destination
+    uint8_t d = opcode->hardcoded_d_field;
+    if (opcode->has_d_field) {
+        d = (header >> opcode->d_shift) & 1;
+    }
+    
+    // sign extension flag
+    uint8_t s = UINT8_MAX;
+    if (opcode->has_s_field) {
+        s = (header >> opcode->s_shift) & 1;
+    }
+    
+    // word or byte operation? 
+    // 0 = instruction operates on byte data
+    // 1 = instruction operates on word data (2 bytes)
+    uint8_t w = UINT8_MAX;
+    if (opcode->has_w_field) {
+        w = (header >> opcode->w_shift) & 1;
+    }
+    
+    // register mode / memory mode with discplacement 
+    uint8_t mod = UINT8_MAX;
+    if (opcode->has_mod) {
+        mod = (header >> opcode->mod_shift) & 3;
+    }
+    
+    uint8_t reg = UINT8_MAX;
+    if (opcode->has_reg) {
+        reg = (header >> opcode->reg_shift) & 7;
+    }
+    
+    uint8_t r_m = UINT8_MAX;
+    if (opcode->has_rm) {
+        r_m = (header >> opcode->rm_shift) & 7;
+    }
+    
+    // the mod and r/m fields are always the ModRM byte's top and bottom bits
+    uint8_t num_displacement_bytes = 0;
+    if (opcode->has_mod) {
+        num_displacement_bytes = modrm_displacement_bytes[second_byte];
+    }
+    
+    uint8_t data_bytes = 0;
+    if (opcode->has_data_byte_1) {
+        data_bytes = 1;
+        if (
+            opcode->has_data_byte_2_always ||
+            (
+            opcode->has_data_byte_2_if_w &&
+                w &&
+                (!opcode->has_s_field || !s)))
+        {
+            data_bytes = 2;
+        }
+    }
+    
+    // we know the whole length now, so we never read past the input
+    uint32_t machine_bytes =
+        opcode->header_bytes + num_displacement_bytes + data_bytes;
+    if (machine_bytes > bytes_left) {
+        if (!decoder->speculative) {
+            fprintf(
+                stderr,
+                "Error - instruction at offset %u needs %u bytes, only %u "
+                "left in the input\n",
+                bytes_consumed_at_sol,
+                machine_bytes,
+                bytes_left);
+        }
+        *good = false;
+        return;
+    }
+    
+    const uint8_t * displacement_at = next_bytes + opcode->header_bytes;
+    int16_t displacement_bytes_combined = 0;
+    if (num_displacement_bytes > 1) {
+        displacement_bytes_combined = (int16_t)(
+            (displacement_at[1] << 8) | displacement_at[0]);
+    } else if (num_displacement_bytes > 0) {
+        displacement_bytes_combined =
+            (int16_t)((int8_t)displacement_at[0]);
+    }
+    
+    const uint8_t * data_at = displacement_at + num_displacement_bytes;
+    int16_t data_bytes_combined = 0;
+    if (data_bytes > 1) {
+        data_bytes_combined = (int16_t)((data_at[1] << 8) | data_at[0]);
+    } else if (data_bytes > 0) {
+        data_bytes_combined = (int16_t)(int8_t)data_at[0];
+    }
+    
+    decoder->bytes_consumed += machine_bytes;
+    
+    instruction->offset = bytes_consumed_at_sol;
+    instruction->displacement = displacement_bytes_combined;
+    instruction->data = data_bytes_combined;
+    instruction->opcode_i = (uint8_t)(opcode - opcode_table);
+    instruction->machine_bytes = (uint8_t)machine_bytes;
+    instruction->d = d;
+    instruction->w = opcode->has_w_field ? w : 0;
+    instruction->mod = opcode->has_mod ? mod : 0;
+    instruction->reg = 0;
+    instruction->r_m = opcode->has_rm ? r_m : 0;
+    instruction->first_operand = OPERAND_NONE;
+    instruction->second_operand = OPERAND_NONE;
+    
+    if (opcode->data_bytes_are_jump_offsets) {
+        instruction->second_operand = OPERAND_JUMP_OFFSET;
+        INSTRUMENT_COUNT(instructions_per_opcode[instruction->opcode_i], 1);
+        INSTRUMENT_SAMPLED_END(PHASE_FIELD_EXTRACTION, fields_start);
+        *good = true;
+        return;
+    }
+    
+    if (opcode->hardcoded_reg_w[0] != '\0') {
+        assert(opcode->hardcoded_reg_b[0] != '\0');
+        instruction->first_operand = OPERAND_REGISTER;
+        instruction->reg = opcode->hardcoded_reg;
+    } else if (opcode->data_bytes_are_immediates) {
+        instruction->first_operand = OPERAND_IMMEDIATE;
+    } else {
+        assert(opcode->has_reg);
+        instruction->first_operand = OPERAND_REGISTER;
+        instruction->reg = reg;
+    }
+    
+    if (opcode->has_mod && mod == 3) {
+        instruction->second_operand = OPERAND_REGISTER;
+    } else if (opcode->has_mod && !(mod == 0 && r_m == 6)) {
+        instruction->second_operand = OPERAND_MEMORY;
+    } else if (opcode->has_mod) {
+        // mod 0 with r/m 110 is a direct address, even with immediate data
+        assert(num_displacement_bytes == 2);
+        instruction->second_operand = OPERAND_DIRECT_ADDRESS;
+    } else if (data_bytes > 0) {
+        if (opcode->data_bytes_are_addresses) {
+            instruction->second_operand = OPERAND_DIRECT_ADDRESS;
+            instruction->displacement = data_bytes_combined;
+        } else {
+            instruction->second_operand = OPERAND_IMMEDIATE;
+        }
+    } else {
+        fprintf(stderr, "Error - no data or secondary register\n");
+        *good = false;
+        return;
+    }
+    
+    INSTRUMENT_COUNT(instructions_per_opcode[instruction->opcode_i], 1);
+    INSTRUMENT_SAMPLED_END(PHASE_FIELD_EXTRACTION, fields_start);
+    *good = true;
+}
+
+static void append_operand(
+    OutputBuffer * recipient,
+    DecodedInstruction * instruction,
+    uint8_t operand_kind,
+    uint8_t is_first_operand)
+{
+    switch (operand_kind) {
+        case OPERAND_REGISTER: {
+            uint8_t reg =
+                is_first_operand ? instruction->reg : instruction->r_m;
+            output_append(recipient, reg_table[instruction->w][reg]);
+            break;
+        }
+        case OPERAND_MEMORY: {
+            output_append(recipient, "[");
+            output_append(
+                recipient,
+                modsub3_rm_table[instruction->mod][instruction->r_m]);
+            if (instruction->displacement != 0) {
+                if (instruction->displacement >= 0) {
+                    output_append(recipient, "+");
+                }
+                output_append_int(recipient, instruction->displacement);
+            }
+            output_append(recipient, "]");
+            break;
+        }
+        case OPERAND_DIRECT_ADDRESS: {
+            output_append(recipient, "[");
+            output_append_int(recipient, instruction->displacement);
+            output_append(recipient, "]");
+            break;
+        }
+        case OPERAND_IMMEDIATE: {
+            if (is_first_operand) {
+                if (
+                    instruction->w &&
+                    opcode_table[instruction->opcode_i].has_s_field)
+                {
+                    output_append(recipient, "word ");
+                } else {
+                    output_append(recipient, "byte ");
+                }
+            }
+            output_append_int(recipient, instruction->data);
+            break;
+        }
+        default:
+            assert(0);
+    }
+}
+
+void append_instruction_text(
+    OutputBuffer * recipient,
+    DecodedInstruction * instruction)
+{
+    INSTRUMENT_SAMPLED_START(PHASE_INSTRUCTION_TEXT, text_start);
+    output_append(recipient, opcode_table[instruction->opcode_i].text);
+    output_append(recipient, " ");
+    
+    if (instruction->second_operand == OPERAND_JUMP_OFFSET) {
+        INSTRUMENT_SAMPLED_END(PHASE_INSTRUCTION_TEXT, text_start);
+        return;
+    }
+    
+    if (instruction->d) {
+        append_operand(
+            recipient,
+            instruction,
+            instruction->first_operand,
+            true);
+        output_append(recipient, ", ");
+        append_operand(
+            recipient,
+            instruction,
+            instruction->second_operand,
+            false);
+    } else {
+        append_operand(
+            recipient,
+            instruction,
+            instruction->second_operand,
+            false);
+        output_append(recipient, ",");
+        append_operand(
+            recipient,
+            instruction,
+            instruction->first_operand,
+            true);
+    }
+    INSTRUMENT_SAMPLED_END(PHASE_INSTRUCTION_TEXT, text_start);
+}
+
+/*
+Clocks for each operand form of MOV, ADD, SUB and CMP, from the 8086 manual's
+instruction timings. Forms with a memory operand also take the EA clocks
+*/
+typedef struct FormClocks {
+    char text[10];
+    uint8_t reg_reg;
+    uint8_t reg_mem;
+    uint8_t mem_reg;
+    uint8_t reg_imm;
+    uint8_t mem_imm;
+} FormClocks;
+
+static const FormClocks form_clocks[4] = {
+    {"MOV", 2, 8, 9, 4, 10},
+    {"ADD", 3, 9, 16, 4, 17},
+    {"SUB", 3, 9, 16, 4, 17},
+    {"CMP", 3, 9, 9, 4, 10}};
+
+/*
+The EA (effective address) clocks of every memory operand, in the same order
+as modsub3_rm_table. mod 1 and 2 both add a displacement, which costs the
+same whether it's 8 or 16 bits. With mod 0, r/m 110 is a direct address
+*/
+static const uint8_t effective_address_clocks[3][8] = {
+    { 7,  8,  8,  7, 5, 5, 6, 5}, // bx+si, bx+di, bp+si, bp+di, si, di, -, bx
+    {11, 12, 12, 11, 9, 9, 9, 9},
+    {11, 12, 12, 11, 9, 9, 9, 9}};
+
+void estimate_clocks(
+    const DecodedInstruction * instruction,
+    ClockEstimate * estimate)
+{
+    const OpCode * opcode = &opcode_table[instruction->opcode_i];
+    estimate->clocks = 0;
+    estimate->ea_clocks = 0;
+    estimate->clocks_if_taken = 0;
+
+    if (instruction->second_operand == OPERAND_JUMP_OFFSET) {
+        // the conditional jumps are 16 taken / 4 not, the rest differ
+        estimate->clocks = 4;
+        estimate->clocks_if_taken = 16;
+        if (opcode->number == LOOP) {
+            estimate->clocks = 5;
+            estimate->clocks_if_taken = 17;
+        } else if (opcode->number == LOOPZ_LOOPE) {
+            estimate->clocks = 6;
+            estimate->clocks_if_taken = 18;
+        } else if (opcode->number == LOOPNZ_LOOPNE) {
+            estimate->clocks = 5;
+            estimate->clocks_if_taken = 19;
+        } else if (opcode->number == JCXZ) {
+            estimate->clocks = 6;
+            estimate->clocks_if_taken = 18;
+        }
+        return;
+    }
+
+    const FormClocks * clocks = NULL;
+    for (uint32_t i = 0; i < 4; i++) {
+        if (are_equal_strings(opcode->text, form_clocks[i].text)) {
+            clocks = &form_clocks[i];
+            break;
+        }
+    }
+    if (clocks == NULL) {
+        return;
+    }
+
+    // the same rule as the text: d says whether the first operand is written
+    uint8_t destination_kind = instruction->d ?
+        instruction->first_operand :
+        instruction->second_operand;
+    uint8_t source_kind = instruction->d ?
+        instruction->second_operand :
+        instruction->first_operand;
+    uint8_t destination_is_memory =
+        destination_kind == OPERAND_MEMORY ||
+        destination_kind == OPERAND_DIRECT_ADDRESS;
+    uint8_t source_is_memory =
+        source_kind == OPERAND_MEMORY ||
+        source_kind == OPERAND_DIRECT_ADDRESS;
+
+    if (!opcode->has_mod && (destination_is_memory || source_is_memory)) {
+        // MOV between the accumulator and a direct address has no EA
+        estimate->clocks = 10;
+    } else if (destination_is_memory) {
+        estimate->ea_clocks =
+            effective_address_clocks[instruction->mod][instruction->r_m];
+        estimate->clocks = source_kind == OPERAND_IMMEDIATE ?
+            clocks->mem_imm :
+            clocks->mem_reg;
+    } else if (source_is_memory) {
+        estimate->ea_clocks =
+            effective_address_clocks[instruction->mod][instruction->r_m];
+        estimate->clocks = clocks->reg_mem;
+    } else if (source_kind == OPERAND_IMMEDIATE) {
+        estimate->clocks = clocks->reg_imm;
+    } else {
+        estimate->clocks = clocks->reg_reg;
+    }
+
+    estimate->clocks += estimate->ea_clocks;
+    estimate->clocks_if_taken = estimate->clocks;
+}
+
+/*
+For example " ; 17 clocks (8 + 9 EA)", or for a jump
+" ; 16 clocks if taken, 4 if not"
+*/
+static void append_clocks_comment(
+    OutputBuffer * recipient,
+    const ClockEstimate * clocks)
+{
+    output_append(recipient, " ; ");
+    if (clocks->clocks_if_taken != clocks->clocks) {
+        output_append_uint(recipient, clocks->clocks_if_taken);
+        output_append(recipient, " clocks if taken, ");
+        output_append_uint(recipient, clocks->clocks);
+        output_append(recipient, " if not");
+        return;
+    }
+
+    output_append_uint(recipient, clocks->clocks);
+    output_append(recipient, " clocks");
+    if (clocks->ea_clocks > 0) {
+        output_append(recipient, " (");
+        output_append_uint(recipient, clocks->clocks - clocks->ea_clocks);
+        output_append(recipient, " + ");
+        output_append_uint(recipient, clocks->ea_clocks);
+        output_append(recipient, " EA)");
+    }
+}
+
+/*
+Appends 1 instruction to 'recipient' as a full line of text, with its label
+(if anything jumps to it) and the label it jumps to (if it's a jump). If
+'clocks' isn't NULL the line ends with a comment estimating its clocks
+*/
+static void append_instruction_line(
+    OutputBuffer * recipient,
+    DecodedInstruction * instruction,
+    LineLabels * labels,
+    const ClockEstimate * clocks)
+{
+    if (labels->label_id >= 0) {
+        output_append(recipient, "label_");
+        output_append_int(recipient, labels->label_id);
+        output_append(recipient, ":\n");
+    }
+    append_instruction_text(recipient, instruction);
+    if (labels->jump_targets_label_id >= 0) {
+        output_append(recipient, "label_");
+        output_append_int(recipient, labels->jump_targets_label_id);
+    } else if (instruction->second_operand == OPERAND_JUMP_OFFSET) {
+        // no label to jump to, '$' is the start of this instruction in nasm
+        output_append(recipient, "$");
+        int32_t relative_to_start =
+            instruction->machine_bytes + instruction->data;
+        if (relative_to_start >= 0) {
+            output_append(recipient, "+");
+        }
+        output_append_int(recipient, relative_to_start);
+    }
+    if (clocks != NULL) {
+        append_clocks_comment(recipient, clocks);
+    }
+    output_append(recipient, "\n");
+}
+
+/*
+Jumps that don't land on the start of an instruction (or land outside of the
+input) can't get a label, we print them relative to the jump instead
+*/
+static void warn_unlabeled_jump(
+    uint64_t jump_offset,
+    int64_t target_offset)
+{
+    fprintf(
+        stderr,
+        "Warning - jump at byte %llu lands on byte %lld, which is not the "
+        "start of an instruction in the input\n",
+        (unsigned long long)jump_offset,
+        (long long)target_offset);
+}
+
+#define ARENA_MIN_BLOCK_SIZE 65536
+#define ARENA_ALIGNMENT 16
+
+// a block's memory starts right after it, at the alignment
+#define ARENA_BLOCK_HEADER_SIZE \
+    ((sizeof(ArenaBlock) + ARENA_ALIGNMENT - 1) & \
+        ~(size_t)(ARENA_ALIGNMENT - 1))
+
+void arena_init(Arena * arena) {
+    arena->first = NULL;
+    arena->current = NULL;
+    arena->used = 0;
+    arena->reserved = 0;
+}
+
+static ArenaBlock * arena_new_block(
+    size_t cap)
+{
+    if (cap < ARENA_MIN_BLOCK_SIZE) {
+        cap = ARENA_MIN_BLOCK_SIZE;
+    }
+    ArenaBlock * block = (ArenaBlock *)malloc(ARENA_BLOCK_HEADER_SIZE + cap);
+    assert(block != NULL);
+    block->next = NULL;
+    block->size = 0;
+    block->cap = cap;
+    return block;
+}
+
+void arena_free(Arena * arena) {
+    ArenaBlock * block = arena->first;
+    while (block != NULL) {
+        ArenaBlock * next = block->next;
+        free(block);
+        block = next;
+    }
+    arena_init(arena);
+}
+
+void arena_reset(Arena * arena) {
+    if (arena->first == NULL) {
+        return;
+    }
+    
+    /*
+    Every allocation is a multiple of the alignment, so all of the last
+    run's fit in 1 block of the size it used
+    */
+    size_t needed = arena->used;
+    if (arena->reserved > needed) {
+        needed = arena->reserved;
+    }
+    if (
+        arena->first->next != NULL ||
+        arena->first->cap / 4 > needed + ARENA_MIN_BLOCK_SIZE)
+    {
+        arena_free(arena);
+        arena->first = arena_new_block(needed);
+    }
+    
+    arena->first->size = 0;
+    arena->current = arena->first;
+    arena->used = 0;
+    arena->reserved = 0;
+}
+
+static size_t arena_aligned_size(
+    const size_t size)
+{
+    return (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+}
+
+// links a new block of at least 'cap' bytes after the current 1
+static ArenaBlock * arena_add_block(
+    Arena * arena,
+    const size_t cap)
+{
+    ArenaBlock * block = arena_new_block(cap);
+    if (arena->current == NULL) {
+        arena->first = block;
+    } else {
+        arena->current->next = block;
+    }
+    arena->current = block;
+    return block;
+}
+
+void * arena_alloc(
+    Arena * arena,
+    const size_t size)
+{
+    size_t aligned_size = arena_aligned_size(size);
+    
+    // the current block is always the last 1
+    ArenaBlock * block = arena->current;
+    if (block == NULL || block->cap - block->size < aligned_size) {
+        size_t cap = aligned_size;
+        if (block != NULL && block->cap * 2 > cap) {
+            cap = block->cap * 2;
+        }
+        block = arena_add_block(arena, cap);
+    }
+    
+    void * memory = (uint8_t *)block + ARENA_BLOCK_HEADER_SIZE + block->size;
+    block->size += aligned_size;
+    arena->used += aligned_size;
+    if (arena->used > arena->reserved) {
+        arena->reserved = arena->used;
+    }
+    return memory;
+}
+
+void arena_reserve(
+    Arena * arena,
+    const size_t size)
+{
+    size_t aligned_size = arena_aligned_size(size);
+    ArenaBlock * block = arena->current;
+    if (block == NULL || block->cap - block->size < aligned_size) {
+        arena_add_block(arena, aligned_size);
+    }
+    if (arena->used + aligned_size > arena->reserved) {
+        arena->reserved = arena->used + aligned_size;
+    }
+}
+
+void * arena_resize(
+    Arena * arena,
+    void * memory,
+    const size_t size,
+    const size_t new_size)
+{
+    size_t aligned_size = arena_aligned_size(size);
+    size_t new_aligned_size = arena_aligned_size(new_size);
+    
+    ArenaBlock * block = arena->current;
+    if (memory != NULL && block != NULL) {
+        uint8_t * block_end =
+            (uint8_t *)block + ARENA_BLOCK_HEADER_SIZE + block->size;
+        size_t size_before = block->size - aligned_size;
+        if (
+            (uint8_t *)memory + aligned_size == block_end &&
+            new_aligned_size <= block->cap - size_before)
+        {
+            block->size = size_before + new_aligned_size;
+            arena->used = arena->used - aligned_size + new_aligned_size;
+            if (arena->used > arena->reserved) {
+                arena->reserved = arena->used;
+            }
+            return memory;
+        }
+    }
+    
+    if (new_size <= size) {
+        return memory;
+    }
+    void * moved = arena_alloc(arena, new_size);
+    if (size > 0) {
+        memcpy(moved, memory, size);
+    }
+    return moved;
+}
+
+void decoder_init(DecoderContext * decoder) {
+    decoder->input = NULL;
+    decoder->input_size = 0;
+    decoder->bytes_consumed = 0;
+    decoder->instructions = NULL;
+    decoder->instruction_labels = NULL;
+    decoder->instructions_size = 0;
+    decoder->instructions_cap = 0;
+    decoder->instruction_at_offset = NULL;
+    decoder->latest_label_id = 0;
+    decoder->labels_resolved = false;
+    decoder->speculative = false;
+    arena_init(&decoder->arena);
+    decoder->chunk_outputs = NULL;
+    decoder->chunk_outputs_size = 0;
+}
+
+void decoder_free(DecoderContext * decoder) {
+    arena_free(&decoder->arena);
+    for (uint32_t i = 0; i < decoder->chunk_outputs_size; i++) {
+        free(decoder->chunk_outputs[i].text);
+    }
+    free(decoder->chunk_outputs);
+    decoder_init(decoder);
+}
+
+/*
+Starts a new run: takes back everything the last run allocated and
+allocates the offsets of an input of 'input_size' bytes. The instructions
+and labels come later, see decoder_reserve_instructions()
+*/
+static void decoder_allocate(
+    DecoderContext * decoder,
+    uint32_t input_size)
+{
+    arena_reset(&decoder->arena);
+    decoder->instructions = NULL;
+    decoder->instruction_labels = NULL;
+    decoder->instructions_cap = 0;
+    decoder->instruction_at_offset = (int32_t *)arena_alloc(
+        &decoder->arena,
+        sizeof(int32_t) * ((size_t)input_size + 1));
+}
+
+#define DECODER_MIN_INSTRUCTIONS_CAP 1024
+
+// an opcode byte and at least a ModRM or data byte
+#define MIN_INSTRUCTION_BYTES 2
+
+/*
+Reserves room for as many instructions (and labels) as the input can hold.
+Only the ones we decode get touched, but it lets the instructions grow in
+place instead of being copied to a bigger block
+*/
+static void decoder_reserve_room(
+    DecoderContext * decoder,
+    const uint32_t input_size)
+{
+    size_t most_instructions = (input_size / MIN_INSTRUCTION_BYTES) + 1;
+    arena_reserve(
+        &decoder->arena,
+        ((sizeof(DecodedInstruction) + sizeof(LineLabels)) *
+            most_instructions) +
+        (2 * ARENA_ALIGNMENT));
+}
+
+/*
+Makes room for at least 'size' instructions (and their labels, if they were
+allocated already), doubling so that decoding 1 at a time stays cheap
+*/
+static void decoder_reserve_instructions(
+    DecoderContext * decoder,
+    const uint32_t size)
+{
+    if (size <= decoder->instructions_cap) {
+        return;
+    }
+    
+    uint64_t new_cap = (uint64_t)decoder->instructions_cap * 2;
+    if (new_cap < size) {
+        new_cap = size;
+    }
+    if (new_cap < DECODER_MIN_INSTRUCTIONS_CAP) {
+        new_cap = DECODER_MIN_INSTRUCTIONS_CAP;
+    }
+    
+    // past what decoder_reserve_room() made room for, we'd be copied
+    uint64_t most_instructions =
+        (decoder->input_size / MIN_INSTRUCTION_BYTES) + 1;
+    if (new_cap > most_instructions && size <= most_instructions) {
+        new_cap = most_instructions;
+    }
+    
+    decoder->instructions = (DecodedInstruction *)arena_resize(
+        &decoder->arena,
+        decoder->instructions,
+        sizeof(DecodedInstruction) * decoder->instructions_cap,
+        sizeof(DecodedInstruction) * new_cap);
+    if (decoder->instruction_labels != NULL) {
+        decoder->instruction_labels = (LineLabels *)arena_resize(
+            &decoder->arena,
+            decoder->instruction_labels,
+            sizeof(LineLabels) * decoder->instructions_cap,
+            sizeof(LineLabels) * new_cap);
+    }
+    decoder->instructions_cap = (uint32_t)new_cap;
+}
+
+/*
+Allocates the labels once all the instructions are decoded, with every line
+starting without 1. The instructions give back the room they didn't use
+first, if they're still the arena's latest allocation
+*/
+static void decoder_allocate_labels(
+    DecoderContext * decoder)
+{
+    if (decoder->instruction_labels != NULL) {
+        return;
+    }
+    
+    decoder->instructions = (DecodedInstruction *)arena_resize(
+        &decoder->arena,
+        decoder->instructions,
+        sizeof(DecodedInstruction) * decoder->instructions_cap,
+        sizeof(DecodedInstruction) * decoder->instructions_size);
+    decoder->instructions_cap = decoder->instructions_size;
+    
+    decoder->instruction_labels = (LineLabels *)arena_alloc(
+        &decoder->arena,
+        sizeof(LineLabels) * decoder->instructions_cap);
+    for (uint32_t i = 0; i < decoder->instructions_cap; i++) {
+        decoder->instruction_labels[i].label_id = -1;
+        decoder->instruction_labels[i].jump_targets_label_id = -1;
+    }
+}
+
+/*
+Prepares 'decoder' to decode all of 'input' from the start
+*/
+static void decoder_start(
+    DecoderContext * decoder,
+    const uint8_t * input,
+    const uint32_t input_size)
+{
+    decoder_allocate(decoder, input_size);
+    decoder_reserve_room(decoder, input_size);
+    decoder->input = input;
+    decoder->input_size = input_size;
+    decoder->bytes_consumed = 0;
+    decoder->instructions_size = 0;
+    decoder->latest_label_id = 0;
+    decoder->labels_resolved = false;
+    
+    for (uint32_t i = 0; i <= input_size; i++) {
+        decoder->instruction_at_offset[i] = -1;
+    }
+}
+
+/*
+Decodes 1 instruction at the decoder's cursor and adds it to its instructions
+*/
+static void decode_next_instruction(
+    DecoderContext * decoder,
+    uint32_t * good)
+{
+    uint32_t instruction_i = decoder->instructions_size;
+    decoder_reserve_instructions(decoder, instruction_i + 1);
+    decoder->instruction_at_offset[decoder->bytes_consumed] =
+        (int32_t)instruction_i;
+    decode_instruction(
+        decoder,
+        &decoder->instructions[instruction_i],
+        good);
+    if (!*good) {
+        decoder->instruction_at_offset[decoder->bytes_consumed] = -1;
+        return;
+    }
+    decoder->instructions_size += 1;
+}
+
+void decode_instruction_at(
+    DecoderContext * decoder,
+    const uint32_t offset,
+    DecodedInstruction * instruction,
+    uint32_t * good)
+{
+    assert(offset < decoder->input_size);
+    decoder->bytes_consumed = offset;
+    decode_instruction(decoder, instruction, good);
+}
+
+/*
+We want to iterate through the decoded instructions looking for jumps, and
+cache the label of the exact instruction that they need to jump to
+*/
+void resolve_jump_labels(
+    DecoderContext * decoder)
+{
+    INSTRUMENT_START(labels_start);
+    decoder_allocate_labels(decoder);
+    DecodedInstruction * instructions = decoder->instructions;
+    LineLabels * instruction_labels = decoder->instruction_labels;
+    
+    for (uint32_t i = 0; i < decoder->instructions_size; i++) {
+        if (instructions[i].second_operand != OPERAND_JUMP_OFFSET) {
+            continue;
+        }
+        
+        // jump offsets are relative to the end of the jump instruction
+        int64_t target_offset =
+            (int64_t)instructions[i].offset +
+            instructions[i].machine_bytes +
+            instructions[i].data;
+        
+        int32_t target_line = -1;
+        if (target_offset >= 0 && target_offset < decoder->input_size) {
+            target_line = decoder->instruction_at_offset[target_offset];
+        }
+        
+        if (target_line < 0) {
+            warn_unlabeled_jump(instructions[i].offset, target_offset);
+            continue;
+        }
+        
+        if (instruction_labels[target_line].label_id < 0) {
+            instruction_labels[target_line].label_id =
+                (int32_t)decoder->latest_label_id++;
+        }
+        assert(instruction_labels[target_line].label_id >= 0);
+        instruction_labels[i].jump_targets_label_id =
+            instruction_labels[target_line].label_id;
+    }
+    decoder->labels_resolved = true;
+    INSTRUMENT_COUNT(label_walk_steps, decoder->instructions_size);
+    INSTRUMENT_END(PHASE_LABEL_RESOLUTION, labels_start);
+}
+
+static void append_instruction_lines(
+    DecoderContext * decoder,
+    uint32_t first_instruction,
+    uint32_t end_instruction,
+    OutputBuffer * recipient)
+{
+    INSTRUMENT_START(emission_start);
+    for (uint32_t i = first_instruction; i < end_instruction; i++) {
+        append_instruction_line(
+            recipient,
+            &decoder->instructions[i],
+            &decoder->instruction_labels[i],
+            NULL);
+    }
+    INSTRUMENT_END(PHASE_EMISSION, emission_start);
+}
+
+void decode_all_instructions(
+    DecoderContext * decoder,
+    const uint8_t * input,
+    const uint32_t input_size,
+    uint32_t * good)
+{
+    decoder_start(decoder, input, input_size);
+    
+    *good = true;
+    while (decoder->bytes_consumed < input_size) {
+        decode_next_instruction(decoder, good);
+        if (!*good) {
+            return;
+        }
+    }
+}
+
+void append_decoded_text(
+    DecoderContext * decoder,
+    OutputBuffer * recipient)
+{
+    // copy our parsed output to 'recipient'
+    // in this step we have to do some extra work to add labels
+    recipient->size = 0;
+    recipient->text[0] = '\0';
+    output_append(recipient, "bits 16\n");
+    
+    // after redecode_patches() they're already up to date
+    if (!decoder->labels_resolved) {
+        resolve_jump_labels(decoder);
+    }
+    
+    append_instruction_lines(
+        decoder,
+        0,
+        decoder->instructions_size,
+        recipient);
+}
+
+void append_decoded_lines(
+    DecoderContext * decoder,
+    const uint32_t first_instruction,
+    const uint32_t end_instruction,
+    OutputBuffer * recipient)
+{
+    if (!decoder->labels_resolved) {
+        resolve_jump_labels(decoder);
+    }
+    
+    append_instruction_lines(
+        decoder,
+        first_instruction,
+        end_instruction,
+        recipient);
+}
+
+void disassemble(
+    DecoderContext * decoder,
+    const uint8_t * input,
+    const uint32_t input_size,
+    OutputBuffer * recipient,
+    uint32_t * good)
+{
+    decode_all_instructions(
+        /* DecoderContext * decoder: */
+            decoder,
+        /* const uint8_t * input: */
+            input,
+        /* const uint32_t input_size: */
+            input_size,
+        /* uint32_t * good: */
+            good);
+    if (!*good) {
+        return;
+    }
+    
+    append_decoded_text(
+        /* DecoderContext * decoder: */
+            decoder,
+        /* OutputBuffer * recipient: */
+            recipient);
+}
+
+static void append_block_total(
+    OutputBuffer * recipient,
+    const uint32_t clocks,
+    const uint32_t clocks_if_taken)
+{
+    output_append(recipient, "; block: ");
+    if (clocks_if_taken != clocks) {
+        output_append_uint(recipient, clocks_if_taken);
+        output_append(recipient, " clocks if the jump is taken, ");
+        output_append_uint(recipient, clocks);
+        output_append(recipient, " if not\n");
+    } else {
+        output_append_uint(recipient, clocks);
+        output_append(recipient, " clocks\n");
+    }
+}
+
+void disassemble_with_clocks(
+    DecoderContext * decoder,
+    const uint8_t * input,
+    const uint32_t input_size,
+    OutputBuffer * recipient,
+    uint32_t * good)
+{
+    decode_all_instructions(decoder, input, input_size, good);
+    if (!*good) {
+        return;
+    }
+
+    recipient->size = 0;
+    recipient->text[0] = '\0';
+    output_append(recipient, "bits 16\n");
+    resolve_jump_labels(decoder);
+
+    /*
+    A block ends with a jump, or right before a line with a label (something
+    can jump into the middle of it otherwise). The program total takes every
+    instruction once and no jump, like a straight run through the input
+    */
+    uint64_t program_clocks = 0;
+    uint32_t block_clocks = 0;
+    uint32_t block_instructions = 0;
+    for (uint32_t i = 0; i < decoder->instructions_size; i++) {
+        DecodedInstruction * instruction = &decoder->instructions[i];
+        LineLabels * labels = &decoder->instruction_labels[i];
+
+        if (labels->label_id >= 0 && block_instructions > 0) {
+            append_block_total(recipient, block_clocks, block_clocks);
+            block_clocks = 0;
+            block_instructions = 0;
+        }
+
+        ClockEstimate clocks;
+        estimate_clocks(instruction, &clocks);
+        append_instruction_line(recipient, instruction, labels, &clocks);
+        program_clocks += clocks.clocks;
+        block_clocks += clocks.clocks;
+        block_instructions += 1;
+
+        if (instruction->second_operand == OPERAND_JUMP_OFFSET) {
+            append_block_total(
+                recipient,
+                block_clocks,
+                block_clocks - clocks.clocks + clocks.clocks_if_taken);
+            block_clocks = 0;
+            block_instructions = 0;
+        }
+    }
+    if (block_instructions > 0) {
+        append_block_total(recipient, block_clocks, block_clocks);
+    }
+
+    output_append(recipient, "; program: ");
+    output_append_uint(recipient, (uint32_t)program_clocks);
+    output_append(recipient, " clocks without taking any jump");
+}
+
+/*
+Recursive traversal mode, for inputs that mix code with data
+
+Instead of sweeping from byte 0, we only decode what the control flow can
+reach from the entry points. Every jump we support is conditional, so after
+each instruction we go on with the next one and also queue the jump's target
+on a worklist. 2 bitmaps remember which bytes are already decoded, so every
+byte is decoded at most once and the work is proportional to the reachable
+code, not to the size of the input. A path stops at anything that doesn't
+decode, runs off the input or would overlap an instruction we already have.
+
+Everything that wasn't reached is written as 'db' lines, so the output still
+assembles to the same bytes
+*/
+#define DB_BYTES_PER_LINE 16
+
+static uint32_t is_bit_set(
+    const uint64_t * bitmap,
+    const uint32_t bit)
+{
+    return (bitmap[bit / 64] >> (bit % 64)) & 1;
+}
+
+static void set_bit(
+    uint64_t * bitmap,
+    const uint32_t bit)
+{
+    bitmap[bit / 64] |= (uint64_t)1 << (bit % 64);
+}
+
+// how many bits of 'bitmap' are set from bit 'start' up to 'end'
+static uint32_t count_set_bits(
+    const uint64_t * bitmap,
+    const uint32_t start,
+    const uint32_t end)
+{
+    uint32_t count = 0;
+    uint32_t bit = start;
+    while (bit < end && bit % 64 != 0) {
+        count += is_bit_set(bitmap, bit++);
+    }
+    while (bit + 64 <= end) {
+        count += (uint32_t)__builtin_popcountll(bitmap[bit / 64]);
+        bit += 64;
+    }
+    while (bit < end) {
+        count += is_bit_set(bitmap, bit++);
+    }
+    return count;
+}
+
+static void append_data_lines(
+    OutputBuffer * recipient,
+    const uint8_t * input,
+    uint32_t start,
+    const uint32_t end)
+{
+    while (start < end) {
+        output_append(recipient, "db ");
+        uint32_t line_end = start + DB_BYTES_PER_LINE;
+        if (line_end > end) {
+            line_end = end;
+        }
+        for (uint32_t i = start; i < line_end; i++) {
+            if (i > start) {
+                output_append(recipient, ", ");
+            }
+            output_append_uint(recipient, input[i]);
+        }
+        output_append(recipient, "\n");
+        start = line_end;
+    }
+}
+
+void disassemble_recursive(
+    DecoderContext * decoder,
+    const uint8_t * input,
+    const uint32_t input_size,
+    const uint32_t * entry_points,
+    const uint32_t entry_points_size,
+    OutputBuffer * recipient,
+    uint32_t * good)
+{
+    /*
+    Unlike decoder_start() we don't touch instruction_at_offset for every
+    byte, only the entries of the instructions we find (and of the jump
+    targets, below)
+    */
+    decoder_allocate(decoder, input_size);
+    decoder->input = input;
+    decoder->input_size = input_size;
+    decoder->instructions_size = 0;
+    decoder->latest_label_id = 0;
+    uint32_t was_speculative = decoder->speculative;
+    decoder->speculative = true; // data is expected, it's not an error
+
+    uint32_t bitmap_words = (input_size / 64) + 1;
+    uint64_t * instruction_starts = (uint64_t *)arena_alloc(
+        &decoder->arena,
+        sizeof(uint64_t) * bitmap_words);
+    uint64_t * decoded_bytes = (uint64_t *)arena_alloc(
+        &decoder->arena,
+        sizeof(uint64_t) * bitmap_words);
+    memset(instruction_starts, 0, sizeof(uint64_t) * bitmap_words);
+    memset(decoded_bytes, 0, sizeof(uint64_t) * bitmap_words);
+    decoder_reserve_room(decoder, input_size);
+
+    uint32_t worklist_cap = entry_points_size + 64;
+    uint32_t worklist_size = 0;
+    uint32_t * worklist = (uint32_t *)malloc(sizeof(uint32_t) * worklist_cap);
+    assert(worklist != NULL);
+    for (uint32_t i = 0; i < entry_points_size; i++) {
+        if (entry_points[i] < input_size) {
+            worklist[worklist_size++] = entry_points[i];
+        }
+    }
+
+    while (worklist_size > 0) {
+        uint32_t offset = worklist[--worklist_size];
+
+        while (offset < input_size && !is_bit_set(decoded_bytes, offset)) {
+            decoder_reserve_instructions(
+                decoder,
+                decoder->instructions_size + 1);
+            DecodedInstruction * instruction =
+                &decoder->instructions[decoder->instructions_size];
+            uint32_t decoded = true;
+            decode_instruction_at(decoder, offset, instruction, &decoded);
+            if (!decoded) {
+                break;
+            }
+
+            uint32_t end = offset + instruction->machine_bytes;
+            uint32_t overlaps = false;
+            for (uint32_t i = offset + 1; i < end; i++) {
+                overlaps |= is_bit_set(decoded_bytes, i);
+            }
+            if (overlaps) {
+                break;
+            }
+
+            decoder->instruction_at_offset[offset] =
+                (int32_t)decoder->instructions_size;
+            decoder->instructions_size += 1;
+            set_bit(instruction_starts, offset);
+            for (uint32_t i = offset; i < end; i++) {
+                set_bit(decoded_bytes, i);
+            }
+
+            if (instruction->second_operand == OPERAND_JUMP_OFFSET) {
+                int64_t target = (int64_t)end + instruction->data;
+                if (target >= 0 && target < input_size) {
+                    if (worklist_size >= worklist_cap) {
+                        worklist_cap *= 2;
+                        worklist = (uint32_t *)realloc(
+                            worklist,
+                            sizeof(uint32_t) * worklist_cap);
+                        assert(worklist != NULL);
+                    }
+                    worklist[worklist_size++] = (uint32_t)target;
+                }
+            }
+            offset = end;
+        }
+    }
+    free(worklist);
+    decoder->speculative = was_speculative;
+
+    /*
+    We found the instructions in control flow order, the text wants them in
+    offset order. Walking the bitmap a word at a time skips 64 bytes of data
+    at once
+    */
+    uint32_t instructions_size = decoder->instructions_size;
+    DecodedInstruction * found = (DecodedInstruction *)arena_alloc(
+        &decoder->arena,
+        sizeof(DecodedInstruction) * ((size_t)instructions_size + 1));
+    for (uint32_t i = 0; i < instructions_size; i++) {
+        found[i] = decoder->instructions[i];
+    }
+    uint32_t sorted_size = 0;
+    for (uint32_t word_i = 0; word_i < bitmap_words; word_i++) {
+        uint64_t word = instruction_starts[word_i];
+        while (word != 0) {
+            uint32_t offset = (word_i * 64) + (uint32_t)__builtin_ctzll(word);
+            word &= word - 1;
+
+            int32_t found_i = decoder->instruction_at_offset[offset];
+            decoder->instructions[sorted_size] = found[found_i];
+            decoder->instruction_at_offset[offset] = (int32_t)sorted_size;
+            sorted_size += 1;
+        }
+    }
+    assert(sorted_size == instructions_size);
+
+    /*
+    resolve_jump_labels() looks up every jump target in
+    instruction_at_offset, those are the only other entries it needs set
+    */
+    for (uint32_t i = 0; i < instructions_size; i++) {
+        DecodedInstruction * instruction = &decoder->instructions[i];
+        if (instruction->second_operand != OPERAND_JUMP_OFFSET) {
+            continue;
+        }
+        int64_t target =
+            (int64_t)instruction->offset +
+            instruction->machine_bytes +
+            instruction->data;
+        if (
+            target >= 0 &&
+            target < input_size &&
+            !is_bit_set(instruction_starts, (uint32_t)target))
+        {
+            decoder->instruction_at_offset[target] = -1;
+        }
+    }
+
+    recipient->size = 0;
+    recipient->text[0] = '\0';
+    output_append(recipient, "bits 16\n");
+    resolve_jump_labels(decoder);
+
+    uint32_t data_start = 0;
+    for (uint32_t i = 0; i < instructions_size; i++) {
+        DecodedInstruction * instruction = &decoder->instructions[i];
+        append_data_lines(recipient, input, data_start, instruction->offset);
+        append_instruction_line(
+            recipient,
+            instruction,
+            &decoder->instruction_labels[i],
+            NULL);
+        data_start = instruction->offset + instruction->machine_bytes;
+    }
+    append_data_lines(recipient, input, data_start, input_size);
+
+    *good = true;
+}
+
+/*
+The boundary pre-scan: every instruction's length only depends on its first 2
+bytes (opcode_length_table and modrm_displacement_bytes), so instead of
+decoding we can work out the length an instruction would have at every offset
+of a block of 16 at once, and then hop from 1 start to the next. With SSE2 the
+ModRM part (mod 1 or 2, or mod 0 with r/m 110) is done for the 16 offsets in
+a few vector instructions, only the opcode lengths are looked up 1 by 1
+*/
+#define SCAN_BLOCK_SIZE 16
+
+/*
+The length of an instruction at every offset in [block_start, block_start +
+SCAN_BLOCK_SIZE), 0 where no opcode starts with that byte. Needs
+SCAN_BLOCK_SIZE + 1 bytes from 'block_start'
+*/
+static void scan_block_lengths(
+    const uint8_t * block_start,
+    uint8_t * lengths)
+{
+    uint8_t opcode_lengths[SCAN_BLOCK_SIZE];
+    for (uint32_t i = 0; i < SCAN_BLOCK_SIZE; i++) {
+        opcode_lengths[i] =
+            opcode_length_table[block_start[i]][(block_start[i + 1] >> 3) & 7];
+    }
+    
+#ifdef __SSE2__
+    __m128i modrm = _mm_loadu_si128((const __m128i *)(block_start + 1));
+    // SSE2 only shifts 16 bit lanes, the mask drops what came from the other
+    __m128i mod = _mm_and_si128(_mm_srli_epi16(modrm, 6), _mm_set1_epi8(3));
+    __m128i r_m = _mm_and_si128(modrm, _mm_set1_epi8(7));
+    __m128i two_bytes = _mm_or_si128(
+        _mm_cmpeq_epi8(mod, _mm_set1_epi8(2)),
+        _mm_and_si128(
+            _mm_cmpeq_epi8(mod, _mm_setzero_si128()),
+            _mm_cmpeq_epi8(r_m, _mm_set1_epi8(6))));
+    __m128i displacement = _mm_or_si128(
+        _mm_and_si128(_mm_cmpeq_epi8(mod, _mm_set1_epi8(1)), _mm_set1_epi8(1)),
+        _mm_and_si128(two_bytes, _mm_set1_epi8(2)));
+    
+    __m128i opcode_length =
+        _mm_loadu_si128((const __m128i *)opcode_lengths);
+    __m128i has_displacement = _mm_cmpeq_epi8(
+        _mm_and_si128(
+            opcode_length,
+            _mm_set1_epi8((char)OPCODE_LENGTH_PLUS_DISPLACEMENT)),
+        _mm_set1_epi8((char)OPCODE_LENGTH_PLUS_DISPLACEMENT));
+    __m128i length = _mm_add_epi8(
+        _mm_andnot_si128(
+            _mm_set1_epi8((char)OPCODE_LENGTH_PLUS_DISPLACEMENT),
+            opcode_length),
+        _mm_and_si128(has_displacement, displacement));
+    _mm_storeu_si128((__m128i *)lengths, length);
+#else
+    for (uint32_t i = 0; i < SCAN_BLOCK_SIZE; i++) {
+        lengths[i] = opcode_lengths[i] & ~OPCODE_LENGTH_PLUS_DISPLACEMENT;
+        if (opcode_lengths[i] & OPCODE_LENGTH_PLUS_DISPLACEMENT) {
+            lengths[i] += modrm_displacement_bytes[block_start[i + 1]];
+        }
+    }
+#endif
+}
+
+uint32_t scan_instruction_boundaries(
+    const uint8_t * input,
+    const uint32_t input_size,
+    uint64_t * boundaries)
+{
+    for (uint32_t i = 0; i < (input_size + 63) / 64; i++) {
+        boundaries[i] = 0;
+    }
+    
+    uint8_t lengths[SCAN_BLOCK_SIZE];
+    uint32_t offset = 0;
+    
+    // whole blocks, as long as the byte after the block is still in the input
+    uint32_t block_start = 0;
+    while (
+        (uint64_t)block_start + SCAN_BLOCK_SIZE + 1 <= input_size &&
+        offset < input_size)
+    {
+        scan_block_lengths(input + block_start, lengths);
+        while (offset < block_start + SCAN_BLOCK_SIZE) {
+            uint8_t length = lengths[offset - block_start];
+            if (length == 0 || length > input_size - offset) {
+                return offset;
+            }
+            set_bit(boundaries, offset);
+            offset += length;
+        }
+        // an instruction can reach past the next block, so skip to it
+        block_start = offset - (offset % SCAN_BLOCK_SIZE);
+    }
+    
+    // the last few bytes 1 by 1, there's no 2nd byte after the last 1
+    while (offset < input_size) {
+        uint8_t second_byte = 0;
+        if (offset + 1 < input_size) {
+            second_byte = input[offset + 1];
+        }
+        uint8_t length =
+            opcode_length_table[input[offset]][(second_byte >> 3) & 7];
+        if (length & OPCODE_LENGTH_PLUS_DISPLACEMENT) {
+            length = (uint8_t)(
+                (length & ~OPCODE_LENGTH_PLUS_DISPLACEMENT) +
+                modrm_displacement_bytes[second_byte]);
+        }
+        if (length == 0 || length > input_size - offset) {
+            return offset;
+        }
+        set_bit(boundaries, offset);
+        offset += length;
+    }
+    
+    return input_size;
+}
+
+/*
+Parallel mode, for big inputs that fit in memory
+
+The input is split into 1 chunk per thread and every chunk is decoded at the
+same time. First scan_instruction_boundaries() tells us where every
+instruction starts, that's a lot cheaper than decoding, so every chunk can
+start at the first instruction after its split point and end where the next
+chunk starts. If the scan stops early (there's something we can't decode),
+each chunk just guesses that it starts right at the chunk boundary and
+decodes until it's past the end of the chunk.
+
+Then we stitch the chunks together in order. The previous chunk tells us where
+this chunk really starts (with the scan it always lines up right away).
+Decoding is deterministic, so if the guess started
+an instruction at that same offset, everything after it is correct too and we
+keep it. If not, we decode the real instructions 1 by 1 until we land on an
+offset the guess also started an instruction at, which usually happens within
+a few instructions.
+
+Labels are resolved on the stitched instructions like disassemble() does, and
+the text is then written by all threads again, so the output is exactly the
+same as disassemble()'s.
+
+With the scan, guessing and resyncing is only the fallback for inputs the
+scan can't get through. Build with -DPARALLEL_SKIP_SCAN to always guess, so
+the fallback can be checked against disassemble() on inputs that decode
+(build.sh does, with a small PARALLEL_MIN_CHUNK_SIZE).
+*/
+#ifndef PARALLEL_MIN_CHUNK_SIZE
+#define PARALLEL_MIN_CHUNK_SIZE 16384
+#endif
+
+typedef struct ParallelChunk {
+    DecoderContext decoder;
+    uint32_t start; // an instruction boundary only if the scan got there
+    uint32_t end;
+    
+    // for writing the text
+    DecoderContext * stitched;
+    uint32_t first_instruction;
+    uint32_t end_instruction;
+    OutputBuffer * output; // 1 of the whole decoder's chunk_outputs
+} ParallelChunk;
+
+static void * decode_chunk(void * chunk_ptr) {
+    ParallelChunk * chunk = (ParallelChunk *)chunk_ptr;
+    DecoderContext * decoder = &chunk->decoder;
+    
+    decoder->speculative = true;
+    decoder->bytes_consumed = chunk->start;
+    decoder->instructions_size = 0;
+    
+    // if the guess fails, we stop and leave the rest to the stitching
+    uint32_t good = true;
+    while (decoder->bytes_consumed < chunk->end) {
+        assert(decoder->instructions_size < decoder->instructions_cap);
+        decode_instruction(
+            decoder,
+            &decoder->instructions[decoder->instructions_size],
+            &good);
+        if (!good) {
+            break;
+        }
+        decoder->instructions_size += 1;
+    }
+    
+    return NULL;
+}
+
+static void * append_chunk_lines(void * chunk_ptr) {
+    ParallelChunk * chunk = (ParallelChunk *)chunk_ptr;
+    
+    chunk->output->size = 0;
+    chunk->output->text[0] = '\0';
+    append_instruction_lines(
+        chunk->stitched,
+        chunk->first_instruction,
+        chunk->end_instruction,
+        chunk->output);
+    
+    return NULL;
+}
+
+/*
+Runs 'function' on every chunk (an array of 'chunks_size' chunks of
+'chunk_bytes' each), each on its own thread (the first one on this thread)
+*/
+static void run_on_chunks(
+    void * chunks,
+    const size_t chunk_bytes,
+    uint32_t chunks_size,
+    void * (* function)(void *))
+{
+    pthread_t * threads =
+        (pthread_t *)malloc(sizeof(pthread_t) * chunks_size);
+    uint32_t * thread_started =
+        (uint32_t *)malloc(sizeof(uint32_t) * chunks_size);
+    uint8_t * chunk_bytes_at = (uint8_t *)chunks;
+    
+    for (uint32_t i = 1; i < chunks_size; i++) {
+        thread_started[i] = pthread_create(
+            &threads[i],
+            NULL,
+            function,
+            chunk_bytes_at + (i * chunk_bytes)) == 0;
+    }
+    
+    function(chunk_bytes_at);
+    
+    for (uint32_t i = 1; i < chunks_size; i++) {
+        if (thread_started[i]) {
+            pthread_join(threads[i], NULL);
+        } else {
+            function(chunk_bytes_at + (i * chunk_bytes));
+        }
+    }
+    
+    free(thread_started);
+    free(threads);
+}
+
+/*
+Returns the index of the instruction in the chunk that starts at 'offset',
+or -1 if none does. The chunk's instructions are sorted by offset
+*/
+static int32_t find_chunk_instruction_at_offset(
+    ParallelChunk * chunk,
+    uint32_t offset)
+{
+    DecodedInstruction * instructions = chunk->decoder.instructions;
+    uint32_t low = 0;
+    uint32_t high = chunk->decoder.instructions_size;
+    while (low < high) {
+        uint32_t middle = low + ((high - low) / 2);
+        if (instructions[middle].offset < offset) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    
+    if (
+        low < chunk->decoder.instructions_size &&
+        instructions[low].offset == offset)
+    {
+        return (int32_t)low;
+    }
+    return -1;
+}
+
+void disassemble_parallel(
+    DecoderContext * decoder,
+    const uint8_t * input,
+    const uint32_t input_size,
+    const uint32_t threads_count,
+    OutputBuffer * recipient,
+    uint32_t * good)
+{
+    uint32_t chunks_size = threads_count;
+    if (chunks_size > input_size / PARALLEL_MIN_CHUNK_SIZE) {
+        chunks_size = input_size / PARALLEL_MIN_CHUNK_SIZE;
+    }
+    if (chunks_size < 2) {
+        disassemble(decoder, input, input_size, recipient, good);
+        return;
+    }
+    
+    decoder_start(decoder, input, input_size);
+    
+    // the scratch lives until the next run, like the decoder's arrays
+    uint64_t * boundaries = (uint64_t *)arena_alloc(
+        &decoder->arena,
+        sizeof(uint64_t) * ((input_size + 63) / 64));
+#ifdef PARALLEL_SKIP_SCAN
+    // as if the scan stopped right away, every chunk has to guess
+    uint32_t scanned_size = 0;
+#else
+    uint32_t scanned_size =
+        scan_instruction_boundaries(input, input_size, boundaries);
+#endif
+    
+    // then we know how many instructions there are, otherwise they grow
+    if (scanned_size == input_size) {
+        decoder_reserve_instructions(
+            decoder,
+            count_set_bits(boundaries, 0, input_size));
+    }
+    
+    ParallelChunk * chunks = (ParallelChunk *)arena_alloc(
+        &decoder->arena,
+        sizeof(ParallelChunk) * chunks_size);
+    uint32_t chunk_size = input_size / chunks_size;
+    for (uint32_t i = 0; i < chunks_size; i++) {
+        ParallelChunk * chunk = &chunks[i];
+        chunk->start = i * chunk_size;
+        if (scanned_size == input_size) {
+            // an instruction starts within a few bytes of every split point
+            while (!is_bit_set(boundaries, chunk->start)) {
+                chunk->start += 1;
+            }
+        }
+        if (i > 0) {
+            chunks[i - 1].end = chunk->start;
+        }
+        chunk->end = input_size;
+    }
+    
+    /*
+    The texts grow on the worker threads, so they can't come from the arena.
+    The decoder keeps them for its next runs instead
+    */
+    if (decoder->chunk_outputs_size < chunks_size) {
+        decoder->chunk_outputs = (OutputBuffer *)realloc(
+            decoder->chunk_outputs,
+            sizeof(OutputBuffer) * chunks_size);
+        assert(decoder->chunk_outputs != NULL);
+        for (uint32_t i = decoder->chunk_outputs_size; i < chunks_size; i++) {
+            output_init(&decoder->chunk_outputs[i], 4096);
+        }
+        decoder->chunk_outputs_size = chunks_size;
+    }
+    
+    for (uint32_t i = 0; i < chunks_size; i++) {
+        ParallelChunk * chunk = &chunks[i];
+        
+        /*
+        each chunk's decoder works with offsets in the whole input, but only
+        ever sees instructions starting in (or just past) its own chunk. Its
+        instructions come from the whole decoder's arena. If the scan got
+        through, the chunk decodes the instructions it found, otherwise every
+        instruction is at least 1 byte, +1 for the one crossing the end
+        */
+        decoder_init(&chunk->decoder);
+        chunk->decoder.input = input;
+        chunk->decoder.input_size = input_size;
+        chunk->decoder.instructions_cap = chunk->end - chunk->start + 1;
+        if (scanned_size == input_size) {
+            chunk->decoder.instructions_cap =
+                count_set_bits(boundaries, chunk->start, chunk->end) + 1;
+        }
+        chunk->decoder.instructions = (DecodedInstruction *)arena_alloc(
+            &decoder->arena,
+            sizeof(DecodedInstruction) * chunk->decoder.instructions_cap);
+        chunk->output = &decoder->chunk_outputs[i];
+    }
+    
+    run_on_chunks(
+        chunks,
+        sizeof(ParallelChunk),
+        chunks_size,
+        decode_chunk);
+    
+    /*
+    Stitch the chunks together. 'decoder' decodes the real instructions 1 by
+    1 whenever a chunk's guess doesn't line up
+    */
+    *good = true;
+    for (uint32_t i = 0; i < chunks_size && *good; i++) {
+        ParallelChunk * chunk = &chunks[i];
+        uint32_t chunk_decoded_end = chunk->decoder.bytes_consumed;
+        
+        while (*good && decoder->bytes_consumed < chunk_decoded_end) {
+            int32_t synced_i = find_chunk_instruction_at_offset(
+                chunk,
+                decoder->bytes_consumed);
+            
+            if (synced_i < 0) {
+                decode_next_instruction(decoder, good);
+                continue;
+            }
+            
+            // from here on, the chunk's guess is the real thing
+            for (
+                uint32_t chunk_i = (uint32_t)synced_i;
+                chunk_i < chunk->decoder.instructions_size;
+                chunk_i++)
+            {
+                uint32_t instruction_i = decoder->instructions_size;
+                decoder_reserve_instructions(decoder, instruction_i + 1);
+                decoder->instructions_size += 1;
+                decoder->instructions[instruction_i] =
+                    chunk->decoder.instructions[chunk_i];
+                decoder->instruction_at_offset[
+                    decoder->instructions[instruction_i].offset] =
+                        (int32_t)instruction_i;
+            }
+            decoder->bytes_consumed = chunk_decoded_end;
+        }
+    }
+    
+    // whatever is left after the last chunk failed, decode it the slow way
+    while (*good && decoder->bytes_consumed < input_size) {
+        decode_next_instruction(decoder, good);
+    }
+    
+    if (*good) {
+        recipient->size = 0;
+        recipient->text[0] = '\0';
+        output_append(recipient, "bits 16\n");
+        
+        resolve_jump_labels(decoder);
+        
+        uint32_t lines_per_chunk = decoder->instructions_size / chunks_size;
+        for (uint32_t i = 0; i < chunks_size; i++) {
+            chunks[i].stitched = decoder;
+            chunks[i].first_instruction = i * lines_per_chunk;
+            chunks[i].end_instruction =
+                (i + 1 == chunks_size) ?
+                    decoder->instructions_size :
+                    (i + 1) * lines_per_chunk;
+        }
+        
+        run_on_chunks(
+        chunks,
+        sizeof(ParallelChunk),
+        chunks_size,
+        append_chunk_lines);
+        
+        for (uint32_t i = 0; i < chunks_size; i++) {
+            OutputBuffer * output = chunks[i].output;
+            output_reserve(recipient, output->size);
+            for (size_t c = 0; c < output->size; c++) {
+                recipient->text[recipient->size++] = output->text[c];
+            }
+            recipient->text[recipient->size] = '\0';
+        }
+    }
+}
+
+/*
+Instruction mix statistics. There's no text to write and no labels to
+resolve, so once the scan got through the whole input every chunk starts and
+ends exactly on an instruction boundary, and just counts what it decodes into
+its own mix. The chunks' mixes are added up at the end
+*/
+typedef struct MixChunk {
+    const uint8_t * input;
+    uint32_t start;
+    uint32_t end;
+    InstructionMix mix;
+    uint32_t good;
+} MixChunk;
+
+void instruction_mix_init(InstructionMix * mix) {
+    memset(mix, 0, sizeof(InstructionMix));
+}
+
+static void add_instruction_mix(
+    InstructionMix * mix,
+    const InstructionMix * to_add)
+{
+    mix->instructions += to_add->instructions;
+    mix->bytes += to_add->bytes;
+    for (uint32_t op_i = 0; op_i < OPCODE_TABLE_SIZE; op_i++) {
+        mix->per_opcode[op_i] += to_add->per_opcode[op_i];
+    }
+    mix->byte_operations += to_add->byte_operations;
+    mix->word_operations += to_add->word_operations;
+    mix->register_operands += to_add->register_operands;
+    for (uint32_t mod = 0; mod < 3; mod++) {
+        for (uint32_t r_m = 0; r_m < 8; r_m++) {
+            mix->memory_operands[mod][r_m] +=
+                to_add->memory_operands[mod][r_m];
+        }
+    }
+    for (uint32_t i = 0; i < JUMP_OFFSETS_SIZE; i++) {
+        mix->jump_offsets[i] += to_add->jump_offsets[i];
+    }
+}
+
+static void count_instruction(
+    InstructionMix * mix,
+    const DecodedInstruction * instruction)
+{
+    const OpCode * opcode = &opcode_table[instruction->opcode_i];
+    
+    mix->instructions += 1;
+    mix->bytes += instruction->machine_bytes;
+    mix->per_opcode[instruction->opcode_i] += 1;
+    
+    if (opcode->has_w_field) {
+        if (instruction->w) {
+            mix->word_operations += 1;
+        } else {
+            mix->byte_operations += 1;
+        }
+    }
+    
+    if (opcode->has_mod) {
+        if (instruction->mod == 3) {
+            mix->register_operands += 1;
+        } else {
+            mix->memory_operands[instruction->mod][instruction->r_m] += 1;
+        }
+    }
+    
+    if (instruction->second_operand == OPERAND_JUMP_OFFSET) {
+        mix->jump_offsets[instruction->data + 128] += 1;
+    }
+}
+
+static void * collect_chunk_mix(void * chunk_ptr) {
+    MixChunk * chunk = (MixChunk *)chunk_ptr;
+    
+    // the chunk ends on a boundary, so the decoder never needs to see past it
+    DecoderContext decoder;
+    decoder_init(&decoder);
+    decoder.input = chunk->input;
+    decoder.input_size = chunk->end;
+    decoder.bytes_consumed = chunk->start;
+    
+    DecodedInstruction instruction;
+    chunk->good = true;
+    while (decoder.bytes_consumed < chunk->end) {
+        decode_instruction(&decoder, &instruction, &chunk->good);
+        if (!chunk->good) {
+            break;
+        }
+        count_instruction(&chunk->mix, &instruction);
+    }
+    
+    return NULL;
+}
+
+void collect_instruction_mix(
+    const uint8_t * input,
+    const uint32_t input_size,
+    const uint32_t threads_count,
+    InstructionMix * mix,
+    uint32_t * good)
+{
+    uint32_t chunks_size = threads_count;
+    if (chunks_size > input_size / PARALLEL_MIN_CHUNK_SIZE) {
+        chunks_size = input_size / PARALLEL_MIN_CHUNK_SIZE;
+    }
+    if (chunks_size < 1) {
+        chunks_size = 1;
+    }
+    
+    MixChunk * chunks = (MixChunk *)malloc(sizeof(MixChunk) * chunks_size);
+    assert(chunks != NULL);
+    chunks[0].input = input;
+    chunks[0].start = 0;
+    chunks[0].end = input_size;
+    instruction_mix_init(&chunks[0].mix);
+    
+    if (chunks_size > 1) {
+        uint64_t * boundaries =
+            (uint64_t *)malloc(sizeof(uint64_t) * ((input_size + 63) / 64));
+        assert(boundaries != NULL);
+        uint32_t scanned_size =
+            scan_instruction_boundaries(input, input_size, boundaries);
+        
+        if (scanned_size < input_size) {
+            /*
+            We'd fail there anyway, so only decode that 1 instruction to say
+            why (like disassemble() would)
+            */
+            DecoderContext decoder;
+            decoder_init(&decoder);
+            decoder.input = input;
+            decoder.input_size = input_size;
+            DecodedInstruction instruction;
+            decode_instruction_at(&decoder, scanned_size, &instruction, good);
+            *good = false;
+            free(boundaries);
+            free(chunks);
+            return;
+        }
+        
+        uint32_t chunk_size = input_size / chunks_size;
+        for (uint32_t i = 1; i < chunks_size; i++) {
+            MixChunk * chunk = &chunks[i];
+            chunk->input = input;
+            chunk->start = i * chunk_size;
+            // an instruction starts within a few bytes of every split point
+            while (!is_bit_set(boundaries, chunk->start)) {
+                chunk->start += 1;
+            }
+            chunks[i - 1].end = chunk->start;
+            chunk->end = input_size;
+            instruction_mix_init(&chunk->mix);
+        }
+        free(boundaries);
+    }
+    
+    run_on_chunks(
+        chunks,
+        sizeof(MixChunk),
+        chunks_size,
+        collect_chunk_mix);
+    
+    *good = true;
+    for (uint32_t i = 0; i < chunks_size; i++) {
+        if (!chunks[i].good) {
+            *good = false;
+        }
+    }
+    if (*good) {
+        for (uint32_t i = 0; i < chunks_size; i++) {
+            add_instruction_mix(mix, &chunks[i].mix);
+        }
+    }
+    
+    free(chunks);
+}
+
+/*
+The bits of an opcode as text, like "100010". A mnemonic has several forms,
+these tell them apart
+*/
+static void opcode_bits_text(
+    const OpCode * opcode,
+    char bits[9])
+{
+    for (uint32_t bit = 0; bit < opcode->size_in_bits; bit++) {
+        uint32_t shift = opcode->size_in_bits - 1 - bit;
+        bits[bit] = ((opcode->number >> shift) & 1) ? '1' : '0';
+    }
+    bits[opcode->size_in_bits] = '\0';
+}
+
+static double percentage(
+    uint64_t count,
+    uint64_t total)
+{
+    return total > 0 ? ((double)count * 100.0) / (double)total : 0.0;
+}
+
+// the ranges of jump offsets we count together, each up to the next 1
+static const int32_t jump_offset_ranges[] = {
+    -128, -64, -32, -16, -8, 0, 8, 16, 32, 64, 128};
+
+void append_instruction_mix(
+    const InstructionMix * mix,
+    OutputBuffer * recipient)
+{
+    // for the percentages, OutputBuffer only does integers
+    char line[128];
+    
+    output_append(recipient, "instructions: ");
+    output_append_uint64(recipient, mix->instructions);
+    output_append(recipient, " in ");
+    output_append_uint64(recipient, mix->bytes);
+    output_append(recipient, " bytes\n");
+    
+    uint64_t sized_operations = mix->byte_operations + mix->word_operations;
+    snprintf(
+        line,
+        sizeof(line),
+        "byte operations: %llu (%.2f%%)\nword operations: %llu (%.2f%%)\n",
+        (unsigned long long)mix->byte_operations,
+        percentage(mix->byte_operations, sized_operations),
+        (unsigned long long)mix->word_operations,
+        percentage(mix->word_operations, sized_operations));
+    output_append(recipient, line);
+    
+    // the forms that were used, most common first
+    uint8_t sorted[OPCODE_TABLE_SIZE];
+    uint32_t sorted_size = 0;
+    for (uint32_t op_i = 0; op_i < opcode_table_size; op_i++) {
+        uint64_t count = mix->per_opcode[op_i];
+        if (count == 0) {
+            continue;
+        }
+        uint32_t i = sorted_size++;
+        while (i > 0 && mix->per_opcode[sorted[i - 1]] < count) {
+            sorted[i] = sorted[i - 1];
+            i -= 1;
+        }
+        sorted[i] = (uint8_t)op_i;
+    }
+    
+    output_append(
+        recipient,
+        "\nopcode forms:\n"
+        "       count        %  form\n");
+    for (uint32_t i = 0; i < sorted_size; i++) {
+        const OpCode * opcode = &opcode_table[sorted[i]];
+        char bits[9];
+        opcode_bits_text(opcode, bits);
+        snprintf(
+            line,
+            sizeof(line),
+            "%12llu %7.2f%%  %s %s\n",
+            (unsigned long long)mix->per_opcode[sorted[i]],
+            percentage(mix->per_opcode[sorted[i]], mix->instructions),
+            opcode->text,
+            bits);
+        output_append(recipient, line);
+    }
+    
+    uint64_t modrm_operands = mix->register_operands;
+    for (uint32_t mod = 0; mod < 3; mod++) {
+        for (uint32_t r_m = 0; r_m < 8; r_m++) {
+            modrm_operands += mix->memory_operands[mod][r_m];
+        }
+    }
+    output_append(
+        recipient,
+        "\naddressing modes (mod and r/m):\n"
+        "       count        %  operand\n");
+    snprintf(
+        line,
+        sizeof(line),
+        "%12llu %7.2f%%  register\n",
+        (unsigned long long)mix->register_operands,
+        percentage(mix->register_operands, modrm_operands));
+    output_append(recipient, line);
+    for (uint32_t mod = 0; mod < 3; mod++) {
+        for (uint32_t r_m = 0; r_m < 8; r_m++) {
+            uint64_t count = mix->memory_operands[mod][r_m];
+            if (count == 0) {
+                continue;
+            }
+            
+            const char * displacement = "";
+            if (mod == 1) {
+                displacement = "+d8";
+            } else if (mod == 2) {
+                displacement = "+d16";
+            }
+            snprintf(
+                line,
+                sizeof(line),
+                "%12llu %7.2f%%  [%s%s]\n",
+                (unsigned long long)count,
+                percentage(count, modrm_operands),
+                (mod == 0 && r_m == 6) ?
+                    "address" :
+                    modsub3_rm_table[mod][r_m],
+                displacement);
+            output_append(recipient, line);
+        }
+    }
+    
+    uint64_t jumps = 0;
+    for (uint32_t i = 0; i < JUMP_OFFSETS_SIZE; i++) {
+        jumps += mix->jump_offsets[i];
+    }
+    output_append(
+        recipient,
+        "\njump offsets (bytes from the end of the jump):\n"
+        "       count        %  offsets\n");
+    uint32_t ranges_size =
+        (sizeof(jump_offset_ranges) / sizeof(jump_offset_ranges[0])) - 1;
+    for (uint32_t range_i = 0; range_i < ranges_size; range_i++) {
+        int32_t first = jump_offset_ranges[range_i];
+        int32_t end = jump_offset_ranges[range_i + 1];
+        uint64_t count = 0;
+        for (int32_t offset = first; offset < end; offset++) {
+            count += mix->jump_offsets[offset + 128];
+        }
+        snprintf(
+            line,
+            sizeof(line),
+            "%12llu %7.2f%%  %d to %d\n",
+            (unsigned long long)count,
+            percentage(count, jumps),
+            first,
+            end - 1);
+        output_append(recipient, line);
+    }
+}
+
+uint64_t hash_input(
+    const uint8_t * input,
+    const uint32_t input_size)
+{
+    /*
+    8 bytes at a time: mix each word in with a multiply and fold the high
+    bits back down, the way murmur's finalizer does. Starting from the size
+    keeps inputs that only differ in trailing zero bytes apart
+    */
+    uint64_t hash = 0x9e3779b97f4a7c15 ^ input_size;
+    uint32_t i = 0;
+    for (; i + 8 <= input_size; i += 8) {
+        uint64_t word;
+        memcpy(&word, input + i, sizeof(word));
+        hash = (hash ^ word) * 0xff51afd7ed558ccd;
+        hash ^= hash >> 32;
+    }
+    
+    uint64_t last_bytes = 0;
+    for (; i < input_size; i++) {
+        last_bytes = (last_bytes << 8) | input[i];
+    }
+    hash = (hash ^ last_bytes) * 0xff51afd7ed558ccd;
+    
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+/*
+Decoded files (see decoded_file.h). The records are written in batches, so
+we never hold more than a few KB of them on top of the decoder's instructions
+*/
+#define DECODED_RECORDS_BATCH_SIZE 4096
+
+static void write_full_records(
+    DecoderContext * decoder,
+    FILE * output_file,
+    uint32_t * good)
+{
+    DecodedRecord * records = (DecodedRecord *)malloc(
+        sizeof(DecodedRecord) * DECODED_RECORDS_BATCH_SIZE);
+    assert(records != NULL);
+    uint32_t records_size = 0;
+    for (uint32_t i = 0; i < decoder->instructions_size && *good; i++) {
+        DecodedInstruction * instruction = &decoder->instructions[i];
+        DecodedRecord * record = &records[records_size++];
+        record->offset = instruction->offset;
+        record->label_id = decoder->instruction_labels[i].label_id;
+        record->jump_label_id =
+            decoder->instruction_labels[i].jump_targets_label_id;
+        record->displacement = instruction->displacement;
+        record->data = instruction->data;
+        record->opcode_i = instruction->opcode_i;
+        record->machine_bytes = instruction->machine_bytes;
+        record->first_operand = instruction->first_operand;
+        record->second_operand = instruction->second_operand;
+        record->flags =
+            (instruction->d ? DECODED_RECORD_D : 0) |
+            (instruction->w ? DECODED_RECORD_W : 0);
+        record->mod = instruction->mod;
+        record->reg = instruction->reg;
+        record->r_m = instruction->r_m;
+        
+        if (
+            records_size == DECODED_RECORDS_BATCH_SIZE ||
+            i + 1 == decoder->instructions_size)
+        {
+            size_t records_written = fwrite(
+                records,
+                sizeof(DecodedRecord),
+                records_size,
+                output_file);
+            *good = records_written == records_size;
+            records_size = 0;
+        }
+    }
+    free(records);
+}
+
+/*
+The compact records, then the label ids in the same order. The labels are
+only a few percent of the records, so they get their own pass instead of
+being kept around
+*/
+static void write_compact_records(
+    DecoderContext * decoder,
+    FILE * output_file,
+    uint32_t * good)
+{
+    DecodedCompactRecord * records = (DecodedCompactRecord *)malloc(
+        sizeof(DecodedCompactRecord) * DECODED_RECORDS_BATCH_SIZE);
+    assert(records != NULL);
+    uint32_t records_size = 0;
+    for (uint32_t i = 0; i < decoder->instructions_size && *good; i++) {
+        DecodedInstruction * instruction = &decoder->instructions[i];
+        LineLabels * labels = &decoder->instruction_labels[i];
+        DecodedCompactRecord * record = &records[records_size++];
+        record->displacement = instruction->displacement;
+        record->data = instruction->data;
+        record->opcode_i = instruction->opcode_i;
+        record->mod_reg_r_m = (uint8_t)(
+            (instruction->mod << 6) |
+            (instruction->reg << 3) |
+            instruction->r_m);
+        record->operands = (uint8_t)(
+            instruction->first_operand |
+            (instruction->second_operand << 4));
+        record->flags = (uint8_t)(
+            (instruction->d ? DECODED_RECORD_D : 0) |
+            (instruction->w ? DECODED_RECORD_W : 0) |
+            (labels->label_id >= 0 ? DECODED_RECORD_LABEL : 0) |
+            (labels->jump_targets_label_id >= 0 ?
+                DECODED_RECORD_JUMP_LABEL : 0) |
+            (instruction->machine_bytes << DECODED_RECORD_BYTES_SHIFT));
+        
+        if (
+            records_size == DECODED_RECORDS_BATCH_SIZE ||
+            i + 1 == decoder->instructions_size)
+        {
+            size_t records_written = fwrite(
+                records,
+                sizeof(DecodedCompactRecord),
+                records_size,
+                output_file);
+            *good = records_written == records_size;
+            records_size = 0;
+        }
+    }
+    free(records);
+    
+    int32_t * label_ids = (int32_t *)malloc(
+        sizeof(int32_t) * DECODED_RECORDS_BATCH_SIZE);
+    assert(label_ids != NULL);
+    uint32_t label_ids_size = 0;
+    for (uint32_t i = 0; i < decoder->instructions_size && *good; i++) {
+        LineLabels * labels = &decoder->instruction_labels[i];
+        if (labels->label_id >= 0) {
+            label_ids[label_ids_size++] = labels->label_id;
+        }
+        if (labels->jump_targets_label_id >= 0) {
+            label_ids[label_ids_size++] = labels->jump_targets_label_id;
+        }
+        
+        // room for the next record's 2
+        if (
+            label_ids_size + 2 > DECODED_RECORDS_BATCH_SIZE ||
+            i + 1 == decoder->instructions_size)
+        {
+            size_t label_ids_written = fwrite(
+                label_ids,
+                sizeof(int32_t),
+                label_ids_size,
+                output_file);
+            *good = label_ids_written == label_ids_size;
+            label_ids_size = 0;
+        }
+    }
+    free(label_ids);
+}
+
+void write_decoded_file(
+    DecoderContext * decoder,
+    const uint32_t record_format,
+    FILE * output_file,
+    uint32_t * good)
+{
+    if (!decoder->labels_resolved) {
+        resolve_jump_labels(decoder);
+    }
+    
+    DecodedFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, DECODED_FILE_MAGIC, sizeof(header.magic));
+    header.version = DECODED_FILE_VERSION;
+    header.byte_order = DECODED_FILE_BYTE_ORDER;
+    header.header_size = sizeof(DecodedFileHeader);
+    header.opcode_size = sizeof(DecodedFileOpcode);
+    header.record_size = sizeof(DecodedRecord);
+    header.opcodes_size = opcode_table_size;
+    header.records_size = decoder->instructions_size;
+    header.labels_size = decoder->latest_label_id;
+    header.input_size = decoder->input_size;
+    header.record_format = record_format;
+    if (record_format == DECODED_RECORDS_COMPACT) {
+        header.record_size = sizeof(DecodedCompactRecord);
+        for (uint32_t i = 0; i < decoder->instructions_size; i++) {
+            LineLabels * labels = &decoder->instruction_labels[i];
+            header.label_ids_size +=
+                (labels->label_id >= 0) +
+                (labels->jump_targets_label_id >= 0);
+        }
+    }
+    *good = fwrite(&header, sizeof(header), 1, output_file) == 1;
+    
+    for (uint32_t op_i = 0; op_i < opcode_table_size && *good; op_i++) {
+        DecodedFileOpcode opcode;
+        memset(&opcode, 0, sizeof(opcode));
+        memcpy(opcode.text, opcode_table[op_i].text, sizeof(opcode.text));
+        opcode.number = opcode_table[op_i].number;
+        opcode.size_in_bits = opcode_table[op_i].size_in_bits;
+        opcode.has_s_field = opcode_table[op_i].has_s_field;
+        *good = fwrite(&opcode, sizeof(opcode), 1, output_file) == 1;
+    }
+    
+    if (!*good) {
+        return;
+    }
+    if (record_format == DECODED_RECORDS_COMPACT) {
+        write_compact_records(decoder, output_file, good);
+    } else {
+        write_full_records(decoder, output_file, good);
+    }
+}
+
+/*
+Whether a record's operand kinds are the ones decode_instruction() gives its
+opcode form, anything else (like a truncated or corrupt file's) would make
+the text up or trip append_operand()
+*/
+static uint32_t record_operands_fit_opcode(
+    const DecodedRecord * record,
+    const OpCode * opcode)
+{
+    if (opcode->data_bytes_are_jump_offsets) {
+        return
+            record->first_operand == OPERAND_NONE &&
+            record->second_operand == OPERAND_JUMP_OFFSET;
+    }
+    
+    uint8_t first_operand = OPERAND_REGISTER;
+    if (
+        opcode->hardcoded_reg_w[0] == '\0' &&
+        opcode->data_bytes_are_immediates)
+    {
+        first_operand = OPERAND_IMMEDIATE;
+    }
+    
+    uint8_t second_operand = OPERAND_IMMEDIATE;
+    if (opcode->has_mod && record->mod == 3) {
+        second_operand = OPERAND_REGISTER;
+    } else if (opcode->has_mod && !(record->mod == 0 && record->r_m == 6)) {
+        second_operand = OPERAND_MEMORY;
+    } else if (opcode->has_mod || opcode->data_bytes_are_addresses) {
+        second_operand = OPERAND_DIRECT_ADDRESS;
+    }
+    
+    return
+        record->first_operand == first_operand &&
+        record->second_operand == second_operand;
+}
+
+void append_decoded_file_text(
+    DecodedFileReader * reader,
+    OutputBuffer * recipient,
+    uint32_t * good)
+{
+    // the records only have opcode indexes, so they have to be ours
+    *good = reader->header->opcodes_size <= opcode_table_size;
+    for (
+        uint32_t op_i = 0;
+        op_i < reader->header->opcodes_size && *good;
+        op_i++)
+    {
+        const DecodedFileOpcode * opcode = decoded_opcode_at(reader, op_i);
+        *good =
+            memchr(opcode->text, '\0', sizeof(opcode->text)) != NULL &&
+            opcode->number == opcode_table[op_i].number &&
+            opcode->size_in_bits == opcode_table[op_i].size_in_bits &&
+            are_equal_strings(opcode->text, opcode_table[op_i].text);
+    }
+    if (!*good) {
+        fprintf(
+            stderr,
+            "Error - the decoded file has opcodes we don't know\n");
+        return;
+    }
+    
+    recipient->size = 0;
+    recipient->text[0] = '\0';
+    output_append(recipient, "bits 16\n");
+    
+    while (reader->next_record_i < reader->header->records_size) {
+        uint32_t record_i = reader->next_record_i;
+        const DecodedRecord * record = next_decoded_record(reader);
+        if (
+            record == NULL ||
+            record->opcode_i >= reader->header->opcodes_size ||
+            record->mod > 3 ||
+            record->reg > 7 ||
+            record->r_m > 7 ||
+            !record_operands_fit_opcode(
+                record,
+                &opcode_table[record->opcode_i]))
+        {
+            fprintf(
+                stderr,
+                "Error - decoded record %u is broken\n",
+                record_i);
+            *good = false;
+            return;
+        }
+        
+        DecodedInstruction instruction;
+        instruction.offset = record->offset;
+        instruction.displacement = record->displacement;
+        instruction.data = record->data;
+        instruction.opcode_i = record->opcode_i;
+        instruction.machine_bytes = record->machine_bytes;
+        instruction.d = (record->flags & DECODED_RECORD_D) != 0;
+        instruction.w = (record->flags & DECODED_RECORD_W) != 0;
+        instruction.mod = record->mod;
+        instruction.reg = record->reg;
+        instruction.r_m = record->r_m;
+        instruction.first_operand = record->first_operand;
+        instruction.second_operand = record->second_operand;
+        
+        LineLabels labels;
+        labels.label_id = record->label_id;
+        labels.jump_targets_label_id = record->jump_label_id;
+        
+        append_instruction_line(recipient, &instruction, &labels, NULL);
+    }
+}
+
+/*
+Streaming mode, for inputs that are too big to decode all at once
+
+Instead of decoding everything up front, we read the input through a sliding
+window and write finished lines to 'output_file' as soon as nothing can change
+them anymore, so memory use doesn't depend on the size of the input.
+
+That works because all of the jumps and loops we decode take an 8-bit signed
+offset from the end of the jump instruction, so a jump can only ever land
+within JUMP_REACH bytes of itself. We keep a small ring of recent lines
+around:
+- a jump is resolved once we've decoded past its target
+- a line is written out once every jump that could land on it is resolved
+Jumps are resolved in the same order as disassemble() does it, so the label
+numbers (and the whole output) come out exactly the same.
+*/
+#define STREAM_WINDOW_SIZE 65536
+#define STREAM_LINES_RING_SIZE 1024 // must be a power of 2
+#define STREAM_OUTPUT_FLUSH_SIZE 65536
+#define MAX_INSTRUCTION_BYTES 6
+#define JUMP_REACH 128
+
+typedef struct StreamState {
+    DecoderContext decoder; // only its cursor and labels are used
+    FILE * input_file;
+    uint32_t input_finished;
+    uint8_t * window;
+    uint64_t window_offset; // absolute offset of window[0] in the input
+    
+    DecodedInstruction * lines;
+    LineLabels * line_labels;
+    uint64_t * line_offsets; // absolute offset of each line in the input
+    uint64_t first_line;     // oldest line that wasn't written out yet
+    uint64_t resolved_lines; // lines before this have their jumps resolved
+    uint64_t decoded_lines;  // total lines decoded so far
+    
+    OutputBuffer output;
+    FILE * output_file;
+} StreamState;
+
+static void stream_refill_window(
+    StreamState * stream)
+{
+    DecoderContext * decoder = &stream->decoder;
+    
+    // move the bytes we haven't decoded yet to the start of the window
+    uint32_t leftover = decoder->input_size - decoder->bytes_consumed;
+    for (uint32_t i = 0; i < leftover; i++) {
+        stream->window[i] = stream->window[decoder->bytes_consumed + i];
+    }
+    stream->window_offset += decoder->bytes_consumed;
+    decoder->bytes_consumed = 0;
+    
+    size_t bytes_read = fread(
+        stream->window + leftover,
+        1,
+        STREAM_WINDOW_SIZE - leftover,
+        stream->input_file);
+    if (bytes_read < STREAM_WINDOW_SIZE - leftover) {
+        stream->input_finished = true;
+    }
+    
+    decoder->input = stream->window;
+    decoder->input_size = leftover + (uint32_t)bytes_read;
+}
+
+static DecodedInstruction * stream_line(
+    StreamState * stream,
+    uint64_t line_i)
+{
+    return &stream->lines[line_i & (STREAM_LINES_RING_SIZE - 1)];
+}
+
+static LineLabels * stream_line_labels(
+    StreamState * stream,
+    uint64_t line_i)
+{
+    return &stream->line_labels[line_i & (STREAM_LINES_RING_SIZE - 1)];
+}
+
+static uint64_t stream_line_offset(
+    StreamState * stream,
+    uint64_t line_i)
+{
+    return stream->line_offsets[line_i & (STREAM_LINES_RING_SIZE - 1)];
+}
+
+/*
+Resolves jumps and writes out lines as far as we can. Once the whole input is
+decoded, pass 'finished' to resolve and write everything that's left
+*/
+static void stream_resolve_and_flush(
+    StreamState * stream,
+    uint32_t finished,
+    uint32_t * good)
+{
+    uint64_t decoded_end =
+        stream->window_offset + stream->decoder.bytes_consumed;
+    
+    while (stream->resolved_lines < stream->decoded_lines) {
+        uint64_t jump_i = stream->resolved_lines;
+        DecodedInstruction * jump = stream_line(stream, jump_i);
+        
+        if (jump->second_operand == OPERAND_JUMP_OFFSET) {
+            int64_t target_offset =
+                (int64_t)stream_line_offset(stream, jump_i) +
+                jump->machine_bytes +
+                jump->data;
+            
+            if (!finished && target_offset >= (int64_t)decoded_end) {
+                // we haven't decoded the target yet
+                break;
+            }
+            
+            // the target is close by, so just walk to it
+            uint64_t target_i = jump_i;
+            while (
+                target_i > stream->first_line &&
+                (int64_t)stream_line_offset(stream, target_i) > target_offset)
+            {
+                target_i -= 1;
+            }
+            while (
+                target_i + 1 < stream->decoded_lines &&
+                (int64_t)stream_line_offset(stream, target_i) < target_offset)
+            {
+                target_i += 1;
+            }
+            
+            if ((int64_t)stream_line_offset(stream, target_i) == target_offset)
+            {
+                LineLabels * target = stream_line_labels(stream, target_i);
+                if (target->label_id < 0) {
+                    target->label_id =
+                        (int32_t)stream->decoder.latest_label_id++;
+                }
+                stream_line_labels(stream, jump_i)->jump_targets_label_id =
+                    target->label_id;
+            } else {
+                warn_unlabeled_jump(
+                    stream_line_offset(stream, jump_i),
+                    target_offset);
+            }
+        }
+        
+        stream->resolved_lines += 1;
+    }
+    
+    /*
+    Nothing can jump to a line anymore if every line up to JUMP_REACH bytes
+    after it has its jumps resolved
+    */
+    uint64_t resolved_offset = decoded_end;
+    if (stream->resolved_lines < stream->decoded_lines) {
+        resolved_offset = stream_line_offset(stream, stream->resolved_lines);
+    }
+    
+    while (
+        stream->first_line < stream->resolved_lines &&
+        (finished ||
+            stream_line_offset(stream, stream->first_line) + JUMP_REACH <
+                resolved_offset))
+    {
+        append_instruction_line(
+            &stream->output,
+            stream_line(stream, stream->first_line),
+            stream_line_labels(stream, stream->first_line),
+            NULL);
+        stream->first_line += 1;
+    }
+    
+    if (finished || stream->output.size >= STREAM_OUTPUT_FLUSH_SIZE) {
+        fwrite(
+            stream->output.text,
+            1,
+            stream->output.size,
+            stream->output_file);
+        stream->output.size = 0;
+        stream->output.text[0] = '\0';
+    }
+    
+    *good = true;
+}
+
+void disassemble_stream(
+    FILE * input_file,
+    FILE * output_file,
+    uint32_t * good)
+{
+    StreamState stream;
+    decoder_init(&stream.decoder);
+    stream.input_file = input_file;
+    stream.input_finished = false;
+    stream.window = (uint8_t *)malloc(STREAM_WINDOW_SIZE);
+    stream.window_offset = 0;
+    stream.lines = (DecodedInstruction *)malloc(
+        sizeof(DecodedInstruction) * STREAM_LINES_RING_SIZE);
+    stream.line_labels =
+        (LineLabels *)malloc(sizeof(LineLabels) * STREAM_LINES_RING_SIZE);
+    stream.line_offsets =
+        (uint64_t *)malloc(sizeof(uint64_t) * STREAM_LINES_RING_SIZE);
+    stream.first_line = 0;
+    stream.resolved_lines = 0;
+    stream.decoded_lines = 0;
+    output_init(&stream.output, STREAM_OUTPUT_FLUSH_SIZE * 2);
+    stream.output_file = output_file;
+    
+    DecoderContext * decoder = &stream.decoder;
+    decoder->input = stream.window;
+    
+    output_append(&stream.output, "bits 16\n");
+    
+    *good = true;
+    while (*good) {
+        if (
+            !stream.input_finished &&
+            decoder->input_size - decoder->bytes_consumed <
+                MAX_INSTRUCTION_BYTES)
+        {
+            stream_refill_window(&stream);
+        }
+        
+        if (decoder->bytes_consumed >= decoder->input_size) {
+            stream_resolve_and_flush(&stream, true, good);
+            break;
+        }
+        
+        // this can't overflow because lines get flushed within ~2 jumps
+        assert(
+            stream.decoded_lines - stream.first_line < STREAM_LINES_RING_SIZE);
+        stream.line_offsets[
+            stream.decoded_lines & (STREAM_LINES_RING_SIZE - 1)] =
+                stream.window_offset + decoder->bytes_consumed;
+        decode_instruction(
+            decoder,
+            stream_line(&stream, stream.decoded_lines),
+            good);
+        if (!*good) {
+            break;
+        }
+        // decode_instruction() only knows the offset inside the window
+        stream_line(&stream, stream.decoded_lines)->offset +=
+            (uint32_t)stream.window_offset;
+        stream_line_labels(&stream, stream.decoded_lines)->label_id = -1;
+        stream_line_labels(
+            &stream,
+            stream.decoded_lines)->jump_targets_label_id = -1;
+        stream.decoded_lines += 1;
+        
+        stream_resolve_and_flush(&stream, false, good);
+    }
+    
+    free(stream.output.text);
+    free(stream.line_offsets);
+    free(stream.line_labels);
+    free(stream.lines);
+    free(stream.window);
+}
+
+/*
+Incremental mode, for re-disassembling after patching a few bytes
+
+Decoding is deterministic, so once the new decode lands on an offset where
+an old instruction started, everything after it is the same as before (the
+same trick the parallel mode's stitching uses). For every patch we go back to
+the start of the instruction the patch begins in, decode until we're past
+the patch and back on an old boundary, and swap those instructions in.
+
+Jumps only reach JUMP_REACH bytes or so, so the only labels that can change
+are those of the new instructions, of what they jump to, and of what the
+old ones jumped to. Only the jumps near the patch are looked at.
+
+The only work that depends on the size of the input is moving the rest of
+the instructions when a patch changes how many there are (1 pass of plain
+copies, no decoding)
+*/
+
+// a jump at 'offset' lands somewhere in [offset - 126, offset + 129]
+#define JUMPS_TO_FROM_BEFORE (JUMP_REACH + 1)
+#define JUMPS_TO_FROM_AFTER (JUMP_REACH - 2)
+
+/*
+The index of the first instruction at or after 'offset', found by walking
+from instruction 'near_i' (which should be close to it)
+*/
+static uint32_t instruction_index_at_or_after(
+    const DecoderContext * decoder,
+    int64_t offset,
+    uint32_t near_i)
+{
+    uint32_t i = near_i;
+    while (i > 0 && decoder->instructions[i - 1].offset >= offset) {
+        i -= 1;
+    }
+    while (
+        i < decoder->instructions_size &&
+        decoder->instructions[i].offset < offset)
+    {
+        i += 1;
+    }
+    return i;
+}
+
+static int64_t jump_target(const DecodedInstruction * instruction) {
+    return
+        (int64_t)instruction->offset +
+        instruction->machine_bytes +
+        instruction->data;
+}
+
+/*
+Points the jump at 'jump_i' at the label of its target, giving the target a
+label if it doesn't have 1. If the target had a label before the patch
+replaced it ('old_labels'), it gets the same 1 back
+*/
+static void relabel_jump(
+    DecoderContext * decoder,
+    const uint32_t jump_i,
+    const LineLabels * old_labels,
+    const DecodedInstruction * old_instructions,
+    const uint32_t old_size)
+{
+    DecodedInstruction * jump = &decoder->instructions[jump_i];
+    int64_t target = jump_target(jump);
+    int32_t target_line = -1;
+    if (target >= 0 && target < decoder->input_size) {
+        target_line = decoder->instruction_at_offset[target];
+    }
+    if (target_line < 0) {
+        warn_unlabeled_jump(jump->offset, target);
+        decoder->instruction_labels[jump_i].jump_targets_label_id = -1;
+        return;
+    }
+
+    LineLabels * target_labels = &decoder->instruction_labels[target_line];
+    if (target_labels->label_id < 0) {
+        for (uint32_t i = 0; i < old_size; i++) {
+            if (
+                old_instructions[i].offset == target &&
+                old_labels[i].label_id >= 0)
+            {
+                target_labels->label_id = old_labels[i].label_id;
+            }
+        }
+    }
+    if (target_labels->label_id < 0) {
+        target_labels->label_id = (int32_t)decoder->latest_label_id++;
+    }
+    decoder->instruction_labels[jump_i].jump_targets_label_id =
+        target_labels->label_id;
+}
+
+/*
+Re-decodes the patch at '*patch_i' in 'patches' (sorted by start), and the
+ones after it that it runs into before the instructions line up again, the
+old instructions in those can't be lined up with. Moves '*patch_i' past the
+last 1 it did. Returns false (and changes nothing) if the patched bytes
+don't decode
+*/
+static uint32_t redecode_patch(
+    DecoderContext * decoder,
+    const PatchedRange * patches,
+    const uint32_t patches_size,
+    uint32_t * patch_i,
+    DecodedInstruction ** scratch,
+    uint32_t * scratch_cap)
+{
+    const PatchedRange * patch = &patches[*patch_i];
+    *patch_i += 1;
+    uint32_t input_size = decoder->input_size;
+    uint32_t patch_end = patch->end < input_size ? patch->end : input_size;
+    if (patch->start >= patch_end) {
+        return true;
+    }
+
+    // an instruction is at most MAX_INSTRUCTION_BYTES, so this is close
+    uint32_t start = patch->start;
+    while (decoder->instruction_at_offset[start] < 0) {
+        assert(start > 0);
+        start -= 1;
+    }
+    uint32_t first_i = (uint32_t)decoder->instruction_at_offset[start];
+
+    uint32_t new_size = 0;
+    uint32_t end = start;
+    uint32_t was_speculative = decoder->speculative;
+    decoder->speculative = true;
+    while (
+        end < input_size &&
+        (end < patch_end || decoder->instruction_at_offset[end] < 0))
+    {
+        if (new_size >= *scratch_cap) {
+            *scratch_cap = (*scratch_cap * 2) + 16;
+            *scratch = (DecodedInstruction *)realloc(
+                *scratch,
+                sizeof(DecodedInstruction) * *scratch_cap);
+            assert(*scratch != NULL);
+        }
+        uint32_t decoded = true;
+        decode_instruction_at(decoder, end, &(*scratch)[new_size], &decoded);
+        if (!decoded) {
+            decoder->speculative = was_speculative;
+            fprintf(
+                stderr,
+                "Error - the patch at offset %u leaves no instruction we "
+                "know at offset %u\n",
+                patch->start,
+                end);
+            return false;
+        }
+        end += (*scratch)[new_size].machine_bytes;
+        new_size += 1;
+        
+        while (*patch_i < patches_size && end > patches[*patch_i].start) {
+            if (patches[*patch_i].end > patch_end) {
+                patch_end = patches[*patch_i].end < input_size ?
+                    patches[*patch_i].end :
+                    input_size;
+            }
+            *patch_i += 1;
+        }
+    }
+    decoder->speculative = was_speculative;
+
+    uint32_t end_i = end < input_size ?
+        (uint32_t)decoder->instruction_at_offset[end] :
+        decoder->instructions_size;
+    uint32_t old_size = end_i - first_i;
+
+    // keep the replaced instructions, their labels and jumps still matter
+    DecodedInstruction * old_instructions = (DecodedInstruction *)malloc(
+        sizeof(DecodedInstruction) * (old_size + 1));
+    LineLabels * old_labels =
+        (LineLabels *)malloc(sizeof(LineLabels) * (old_size + 1));
+    assert(old_instructions != NULL);
+    assert(old_labels != NULL);
+    for (uint32_t i = 0; i < old_size; i++) {
+        old_instructions[i] = decoder->instructions[first_i + i];
+        old_labels[i] = decoder->instruction_labels[first_i + i];
+        decoder->instruction_at_offset[old_instructions[i].offset] = -1;
+    }
+
+    /*
+    Move everything after the patch if the number of instructions changed.
+    This and renumbering the tail below are the O(image size) part of a
+    patch, the instructions are 1 flat array that append_decoded_text() and
+    the cache writer walk straight through
+    */
+    uint32_t tail_size = decoder->instructions_size - end_i;
+    uint32_t new_end_i = first_i + new_size;
+    decoder_reserve_instructions(decoder, new_end_i + tail_size);
+    if (new_end_i > end_i) {
+        for (uint32_t i = tail_size; i > 0; i--) {
+            decoder->instructions[new_end_i + i - 1] =
+                decoder->instructions[end_i + i - 1];
+            decoder->instruction_labels[new_end_i + i - 1] =
+                decoder->instruction_labels[end_i + i - 1];
+        }
+    } else if (new_end_i < end_i) {
+        for (uint32_t i = 0; i < tail_size; i++) {
+            decoder->instructions[new_end_i + i] =
+                decoder->instructions[end_i + i];
+            decoder->instruction_labels[new_end_i + i] =
+                decoder->instruction_labels[end_i + i];
+        }
+    }
+    decoder->instructions_size = new_end_i + tail_size;
+    if (new_end_i != end_i) {
+        for (uint32_t i = new_end_i; i < decoder->instructions_size; i++) {
+            decoder->instruction_at_offset[decoder->instructions[i].offset] =
+                (int32_t)i;
+        }
+    }
+
+    for (uint32_t i = 0; i < new_size; i++) {
+        decoder->instructions[first_i + i] = (*scratch)[i];
+        decoder->instruction_labels[first_i + i].label_id = -1;
+        decoder->instruction_labels[first_i + i].jump_targets_label_id = -1;
+        decoder->instruction_at_offset[(*scratch)[i].offset] =
+            (int32_t)(first_i + i);
+    }
+
+    /*
+    Every jump that can land in [start, end), or that is in there itself,
+    gets its label again
+    */
+    uint32_t near_start_i = instruction_index_at_or_after(
+        decoder,
+        (int64_t)start - JUMPS_TO_FROM_BEFORE,
+        first_i);
+    uint32_t near_end_i = instruction_index_at_or_after(
+        decoder,
+        (int64_t)end + JUMPS_TO_FROM_AFTER,
+        new_end_i);
+    for (uint32_t i = near_start_i; i < near_end_i; i++) {
+        DecodedInstruction * instruction = &decoder->instructions[i];
+        if (instruction->second_operand != OPERAND_JUMP_OFFSET) {
+            continue;
+        }
+        int64_t target = jump_target(instruction);
+        uint32_t is_new = i >= first_i && i < new_end_i;
+        if (is_new || (target >= start && target < end)) {
+            relabel_jump(decoder, i, old_labels, old_instructions, old_size);
+        }
+    }
+
+    /*
+    What the old jumps pointed at (outside the patch) keeps its label only
+    if some other jump still lands there
+    */
+    for (uint32_t old_i = 0; old_i < old_size; old_i++) {
+        if (old_instructions[old_i].second_operand != OPERAND_JUMP_OFFSET) {
+            continue;
+        }
+        int64_t target = jump_target(&old_instructions[old_i]);
+        if (
+            target < 0 ||
+            target >= input_size ||
+            (target >= start && target < end) ||
+            decoder->instruction_at_offset[target] < 0)
+        {
+            continue;
+        }
+        uint32_t target_i = (uint32_t)decoder->instruction_at_offset[target];
+        uint32_t jumpers_start_i = instruction_index_at_or_after(
+            decoder,
+            target - JUMPS_TO_FROM_BEFORE,
+            target_i);
+        uint32_t jumpers_end_i = instruction_index_at_or_after(
+            decoder,
+            target + JUMPS_TO_FROM_AFTER + 1,
+            target_i);
+        uint32_t still_jumped_to = false;
+        for (uint32_t i = jumpers_start_i; i < jumpers_end_i; i++) {
+            if (
+                decoder->instructions[i].second_operand ==
+                    OPERAND_JUMP_OFFSET &&
+                jump_target(&decoder->instructions[i]) == target)
+            {
+                still_jumped_to = true;
+                break;
+            }
+        }
+        if (!still_jumped_to) {
+            decoder->instruction_labels[target_i].label_id = -1;
+        }
+    }
+
+    free(old_instructions);
+    free(old_labels);
+    return true;
+}
+
+void redecode_patches(
+    DecoderContext * decoder,
+    const PatchedRange * patches,
+    const uint32_t patches_size,
+    uint32_t * good)
+{
+    if (!decoder->labels_resolved) {
+        resolve_jump_labels(decoder);
+    }
+
+    // sorted by start, so each patch only has to look at the next ones
+    PatchedRange * sorted =
+        (PatchedRange *)malloc(sizeof(PatchedRange) * (patches_size + 1));
+    assert(sorted != NULL);
+    for (uint32_t i = 0; i < patches_size; i++) {
+        uint32_t j = i;
+        while (j > 0 && sorted[j - 1].start > patches[i].start) {
+            sorted[j] = sorted[j - 1];
+            j -= 1;
+        }
+        sorted[j] = patches[i];
+    }
+
+    DecodedInstruction * scratch = NULL;
+    uint32_t scratch_cap = 0;
+    *good = true;
+    uint32_t patch_i = 0;
+    while (patch_i < patches_size) {
+        if (!redecode_patch(
+            decoder,
+            sorted,
+            patches_size,
+            &patch_i,
+            &scratch,
+            &scratch_cap))
+        {
+            *good = false;
+            break;
+        }
+    }
+    free(scratch);
+    free(sorted);
+}
+
+/*
+Instrumentation (only with -DINSTRUMENT, see disassembler.h). We don't know
+the rdtsc tick rate, so the report measures it against the clock over
+everything since the 1st tick
+*/
+#ifdef INSTRUMENT
+
+Instrumentation instrumentation;
+
+static uint64_t nanoseconds_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * 1000000000) + (uint64_t)now.tv_nsec;
+}
+
+static uint64_t read_ticks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return nanoseconds_now();
+#endif
+}
+
+uint64_t instrument_ticks(void) {
+    if (instrumentation.first_nanoseconds == 0) {
+        // the fastest of a few back to back reads is what 1 read costs
+        instrumentation.clock_read_ticks = UINT64_MAX;
+        for (uint32_t i = 0; i < 16; i++) {
+            uint64_t before = read_ticks();
+            uint64_t read = read_ticks() - before;
+            if (read < instrumentation.clock_read_ticks) {
+                instrumentation.clock_read_ticks = read;
+            }
+        }
+        instrumentation.first_ticks = read_ticks();
+        instrumentation.first_nanoseconds = nanoseconds_now();
+    }
+    return read_ticks();
+}
+
+uint64_t instrument_ticks_since(const uint64_t start) {
+    uint64_t ticks = instrument_ticks() - start;
+    if (ticks < instrumentation.clock_read_ticks) {
+        return 0;
+    }
+    return ticks - instrumentation.clock_read_ticks;
+}
+
+static const char * phase_names[PHASES_COUNT] = {
+    "opcode_lookup",
+    "field_extraction",
+    "label_resolution",
+    "instruction_text",
+    "emission",
+};
+
+#endif // INSTRUMENT
+
+void append_instrumentation_report(
+    OutputBuffer * recipient,
+    const uint32_t as_json)
+{
+#ifndef INSTRUMENT
+    output_append(
+        recipient,
+        as_json ?
+            "{\"instrumented\": false}\n" :
+            "instrumentation is off, build with -DINSTRUMENT\n");
+#else
+    uint64_t ticks = instrument_ticks() - instrumentation.first_ticks;
+    uint64_t nanoseconds =
+        nanoseconds_now() - instrumentation.first_nanoseconds;
+    double ticks_per_millisecond = nanoseconds > 0 ?
+        ((double)ticks / (double)nanoseconds) * 1000000.0 :
+        1.0;
+    
+    // for the doubles, OutputBuffer only does integers
+    char number[128];
+    
+    output_append(
+        recipient,
+        as_json ? "{\n\"instrumented\": true,\n\"phases\": {\n" :
+            "instrumentation:\n"
+            "phase                     spans          ms   ticks/span\n");
+    for (uint32_t phase = 0; phase < PHASES_COUNT; phase++) {
+        uint64_t spans = instrumentation.phase_spans[phase];
+        uint64_t phase_ticks = instrumentation.phase_ticks[phase];
+        double milliseconds = (double)phase_ticks / ticks_per_millisecond;
+        double ticks_per_span =
+            spans > 0 ? (double)phase_ticks / (double)spans : 0.0;
+        if (as_json) {
+            snprintf(
+                number,
+                sizeof(number),
+                "%.3f",
+                milliseconds);
+            output_append(recipient, "    \"");
+            output_append(recipient, phase_names[phase]);
+            output_append(recipient, "\": {\"spans\": ");
+            output_append_uint64(recipient, spans);
+            output_append(recipient, ", \"ticks\": ");
+            output_append_uint64(recipient, phase_ticks);
+            output_append(recipient, ", \"ms\": ");
+            output_append(recipient, number);
+            output_append(recipient, "}");
+            output_append(recipient, phase + 1 < PHASES_COUNT ? ",\n" : "\n");
+        } else {
+            snprintf(
+                number,
+                sizeof(number),
+                "%-18s %12llu %11.3f %12.1f\n",
+                phase_names[phase],
+                (unsigned long long)spans,
+                milliseconds,
+                ticks_per_span);
+            output_append(recipient, number);
+        }
+    }
+    
+    #define APPEND_COUNTER(name) \
+        output_append(recipient, as_json ? "\"" #name "\": " : #name ": "); \
+        output_append_uint64(recipient, instrumentation.name); \
+        output_append(recipient, as_json ? ",\n" : "\n");
+    output_append(recipient, as_json ? "},\n" : "");
+    APPEND_COUNTER(opcode_table_probes);
+    APPEND_COUNTER(output_bytes_scanned);
+    APPEND_COUNTER(label_walk_steps);
+    #undef APPEND_COUNTER
+    
+    output_append(
+        recipient,
+        as_json ?
+            "\"instructions_per_opcode\": [\n" :
+            "instructions per opcode:\n");
+    uint32_t listed = 0;
+    for (uint32_t op_i = 0; op_i < opcode_table_size; op_i++) {
+        uint64_t count = instrumentation.instructions_per_opcode[op_i];
+        if (count == 0) {
+            continue;
+        }
+        
+        const OpCode * opcode = &opcode_table[op_i];
+        char bits[9];
+        opcode_bits_text(opcode, bits);
+        
+        if (as_json) {
+            output_append(recipient, listed > 0 ? ",\n" : "");
+            output_append(recipient, "    {\"mnemonic\": \"");
+            output_append(recipient, opcode->text);
+            output_append(recipient, "\", \"opcode\": \"");
+            output_append(recipient, bits);
+            output_append(recipient, "\", \"instructions\": ");
+            output_append_uint64(recipient, count);
+            output_append(recipient, "}");
+        } else {
+            output_append(recipient, "    ");
+            output_append(recipient, opcode->text);
+            output_append(recipient, " ");
+            output_append(recipient, bits);
+            output_append(recipient, ": ");
+            output_append_uint64(recipient, count);
+            output_append(recipient, "\n");
+        }
+        listed += 1;
+    }
+    output_append(recipient, as_json ? "\n]\n}\n" : "");
+#endif
+}
@@ -0,0 +1,674 @@
+#ifndef DISASSEMBLER_H
+#define DISASSEMBLER_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "decoded_file.h"
+
+#ifndef true
+#define true 1
+#endif
+#ifndef false
+#define false 0
+#endif
+
+/*
+What each operand of a decoded instruction is. An instruction has a 'first'
+operand (usually the REG field) and a 'second' operand (usually the R/M field),
+the 'd' field decides which one comes first in the text
+*/
+typedef enum OperandKind {
+    OPERAND_NONE = 0,
+    OPERAND_REGISTER,       // reg_table[w][register]
+    OPERAND_MEMORY,         // [modsub3_rm_table[mod][r_m] + displacement]
+    OPERAND_DIRECT_ADDRESS, // [displacement]
+    OPERAND_IMMEDIATE,      // data
+    OPERAND_JUMP_OFFSET,    // data, relative to the end of the instruction
+} OperandKind;
+
+/*
+A decoded instruction, with no text. Turning it into text is a separate step
+(see append_instruction_text()), so analyses can work on these directly
+*/
+typedef struct DecodedInstruction {
+    uint32_t offset; // in bytes, from the start of the input
+    int16_t displacement; // also used for direct addresses
+    int16_t data; // immediate or jump offset, already sign extended
+    uint8_t opcode_i; // index in opcode_table
+    uint8_t machine_bytes;
+    uint8_t d;
+    uint8_t w;
+    uint8_t mod;
+    uint8_t reg; // register of the first operand
+    uint8_t r_m; // register(s) of the second operand
+    uint8_t first_operand; // OperandKind
+    uint8_t second_operand; // OperandKind
+} DecodedInstruction;
+
+typedef struct LineLabels {
+    int32_t label_id; // -1 if nothing jumps here
+    int32_t jump_targets_label_id; // -1 if this is not a jump
+} LineLabels;
+
+/*
+A growable text buffer that remembers where its end is, so appending doesn't
+have to search for the '\0' terminator like strcat() does. The text is always
+kept '\0'-terminated so it can be printed directly.
+*/
+typedef struct OutputBuffer {
+    char * text;
+    size_t size; // not counting the '\0' terminator
+    size_t cap;
+} OutputBuffer;
+
+
+void output_init(
+    OutputBuffer * output,
+    size_t initial_cap);
+
+void output_append(
+    OutputBuffer * output,
+    const char * to_append);
+
+void output_append_uint(
+    OutputBuffer * output,
+    uint32_t to_append);
+
+void output_append_uint64(
+    OutputBuffer * output,
+    uint64_t to_append);
+
+void output_append_int(
+    OutputBuffer * output,
+    int32_t to_append);
+
+uint32_t are_equal_strings(
+    const char * a,
+    const char * b);
+
+/*
+From 1+ bytes of machine code, we will get an opcode, a 'W' flag, a 'D' flag,
+a 'mod' field, a 'reg' field and an 'r_m' field.
+
+Which fields you expect to see are always different depending on the opcode,
+but the order of fields always seems to be the same, and the fields are always
+the same number of bits
+
+Here is an example of 1 of the MOV opcodes' signatures:
+
+####################################################
+# Byte 1                 ## Byte 2                 #
+#//////////////////      ##////////////////////////#
+#/0  1  2  3  4  5/ 6  7 ##/8  7/ 6  5  4/ 3  2  1/#
+#/#######/########/########/####/########/########/#
+ / O P C O D E    / W  D   / MOD/ R E G  /  R_M   / 
+ //////////////////        //////////////////////// 
+*/
+
+/*
+The OPCODE is a 3 to 8 bits and represents the 1st part of the
+assembly instruction
+*/
+#define MOV_REGMEMTOREG        34 // binary: 100010
+#define MOV_IMMTOREG           11 // binary: 1011
+#define MOV_IMMTOREGMEM        99 // binary: 1100011
+
+/*
+note: these names are from the intel manual, actually I would reverse them
+('memory to accumulator' actually moves what's in the accumulator to memory)
+*/
+#define MOV_MEMTOACC           80 // binary: 1010000
+#define MOV_ACCTOMEM           81 // binary: 1010001
+
+
+#define ADD_REGMEMTOREG         0 // binary: 000000
+#define ADD_IMMTOREGMEM        32 // binary: 100000
+#define ADD_IMMTOACC            2 // binary: 0000010
+
+#define SUB_REGMEMTOREG        10 // binary: 001010
+#define SUB_IMMTOREGMEM        32 // binary: 100000
+#define SUB_IMMTOACC           22 // binary: 0010110
+
+#define CMP_REGMEMTOREG        14 // binary: 001110
+#define CMP_IMMTOREGMEM        32 // binary: 100000
+#define CMP_IMMTOACC           30 // binary: 0011110
+
+// #define RET_WITHINSEGMENT  195 // 11000011
+
+#define JO                    112 // 01110000 (jump on overflow)
+#define JNO                   113 // 01110001 (jump on not overflow)
+#define JB                    114 // 01110010 (jump below)
+#define JNB                   115 // 01110011 (jump not below)
+#define JE                    116 // 01110100 (jump equal)
+#define JNE_JNZ               117 // 01110101 (jump not equal, jump not zero)
+#define JBE_JNA               118 // 01110110 (below equal, not above)
+#define JA                    119 // 01110111 (jump above)
+#define JS                    120 // 01111000 (jump on sign)
+#define JNS                   121 // 01111001 (?)
+#define JP                    122 // 01111010 (jump on parity)
+#define JNP                   123 // 01111011 (jump on not parity)
+#define JL                    124 // 01111100 (jump less)
+#define JNL                   125 // 01111101 (jump not less)
+#define JLE                   126 // 01111110 (jump less or equal)
+#define JG                    127 // 01111111 (jump greater)
+#define LOOPNZ_LOOPNE         224 // 11100000 (loop while not 0 / not equal)
+#define LOOPZ_LOOPE           225 // 11100001 (loop while 0 / while equal)
+#define LOOP                  226 // 11100010 (loop cx times)
+#define JCXZ                  227 // 11100011 (jump when cx is 0)
+
+typedef struct OpCode {
+    char text[10];
+    uint8_t number;
+    uint8_t size_in_bits;
+    uint8_t has_secondary_3bit_opcode;
+    uint8_t secondary_3bit_opcode;
+    uint32_t secondary_3bit_offset;
+    uint8_t has_d_field;
+    uint8_t hardcoded_d_field; // this opcode always behaves as if d = x
+    uint8_t has_s_field;
+    uint8_t has_w_field;
+    uint8_t has_mod;
+    uint8_t has_reg;
+    char hardcoded_reg_w[3]; // always use this register if w = 1
+    char hardcoded_reg_b[3]; // always use this register if w = 0
+    uint8_t hardcoded_reg; // index of hardcoded_reg_w/b in reg_table
+    uint8_t has_rm;
+    uint8_t data_bytes_are_addresses;
+    uint8_t data_bytes_are_immediates;
+    uint8_t data_bytes_are_jump_offsets;
+    uint8_t has_data_byte_1;
+    uint8_t has_data_byte_2_if_w;
+    uint8_t has_data_byte_2_always;
+    
+    /*
+    Worked out by src/generate_tables.c: where each field sits in the first
+    2 bytes of the instruction, read as 1 big-endian 16 bit value (the opcode
+    byte, then the ModRM byte). Every field fits inside 1 byte, so the
+    decoder can load those 2 bytes once and just shift and mask
+    */
+    uint8_t header_bytes; // 1, or 2 if there's a ModRM byte
+    uint8_t d_shift;
+    uint8_t s_shift;
+    uint8_t w_shift;
+    uint8_t mod_shift;
+    uint8_t reg_shift;
+    uint8_t rm_shift;
+} OpCode;
+
+
+/*
+These tables are generated by src/generate_tables.c ahead of time (see
+src/generated_tables.h), so they're read-only and can be shared by any number
+of decoders (and threads) without any setup
+*/
+#define OPCODE_TABLE_SIZE 200
+#define OPCODE_NONE 255 // an empty slot in the opcode dispatch table
+#define OPCODE_LENGTH_PLUS_DISPLACEMENT 0x80 // see opcode_length_table
+extern const OpCode opcode_table[OPCODE_TABLE_SIZE];
+extern const uint32_t opcode_table_size;
+extern const char reg_table[2][8][3];
+extern const char modsub3_rm_table[3][8][15];
+extern const uint64_t opcode_table_version; // a hash of all the tables
+
+/*
+The opcode_table entry an instruction starting with these 2 bytes decodes as,
+or NULL if there isn't one. Pass 0 as 'second_byte' if there is no 2nd byte
+*/
+const OpCode * lookup_opcode(
+    const uint8_t first_byte,
+    const uint8_t second_byte);
+
+/*
+A bump allocator for the memory 1 run of the decoder needs: allocating is
+moving a cursor, and there's no freeing, arena_reset() takes it all back at
+once before the next run. The blocks are kept for the next run, so a decoder
+that runs over and over (like in batch mode) doesn't go back to malloc().
+If a run needed more than 1 block, or much less than the block it had, the
+reset swaps the blocks for 1 block the size that run needed (or reserved),
+so the memory follows the size of the inputs instead of only ever growing.
+Zero-initialize it or call arena_init(). Not thread safe
+*/
+typedef struct ArenaBlock {
+    struct ArenaBlock * next;
+    size_t size;
+    size_t cap; // the memory follows the block
+} ArenaBlock;
+
+typedef struct Arena {
+    ArenaBlock * first;
+    ArenaBlock * current;
+    size_t used; // by this run, in every block
+    size_t reserved; // the most this run used or reserved, at least 'used'
+} Arena;
+
+void arena_init(Arena * arena);
+
+void arena_free(Arena * arena);
+
+void arena_reset(Arena * arena);
+
+/*
+'size' bytes aligned to 16, they stay valid until the next arena_reset()
+*/
+void * arena_alloc(
+    Arena * arena,
+    const size_t size);
+
+/*
+Resizes the allocation at 'memory' from 'size' to 'new_size' bytes and
+returns where it is now. The arena's latest allocation grows or shrinks in
+place while its block has the room, anything else moves to a new 1 (the old
+1 only comes back on the next reset)
+*/
+void * arena_resize(
+    Arena * arena,
+    void * memory,
+    const size_t size,
+    const size_t new_size);
+
+/*
+Makes sure the current block has 'size' bytes free, so the allocations after
+this (like 1 that keeps growing with arena_resize()) fit in it without being
+moved. The next reset keeps the room. What's reserved but never used is never
+touched either, so it doesn't take up memory
+*/
+void arena_reserve(
+    Arena * arena,
+    const size_t size);
+
+/*
+Everything 1 run of the disassembler reads and writes. Each decoder owns its
+own cursor and results, so you can have as many as you like (for example 1 per
+thread), they only share the read-only tables above.
+
+Zero-initialize it or call decoder_init(), and decoder_free() when done. The
+arrays come from the decoder's arena, which every run resets. The
+instructions grow as they're decoded (in place, they're the arena's latest
+allocation while we decode) and the labels are only allocated once we know
+how many instructions there are, so they follow the real number of
+instructions rather than the size of the input
+*/
+typedef struct DecoderContext {
+    const uint8_t * input;
+    uint32_t input_size;
+    uint32_t bytes_consumed;
+    
+    DecodedInstruction * instructions;
+    LineLabels * instruction_labels; // NULL until the labels get resolved
+    uint32_t instructions_size;
+    uint32_t instructions_cap; // of both arrays
+    
+    /*
+    For every byte offset in the input, the index of the instruction that
+    starts there, or -1 if no instruction starts there (it's in the middle of
+    one). Lets us find the target of a jump without walking the instructions
+    */
+    int32_t * instruction_at_offset;
+    
+    uint32_t latest_label_id;
+    uint32_t labels_resolved; // the jumps in 'instruction_labels' are set
+    
+    // if set, failing to decode is silent and never asserts
+    uint32_t speculative;
+    
+    Arena arena;
+    
+    /*
+    The parallel mode's threads each write their text to 1 of these. They
+    grow on their own thread, so they can't come from the arena, but they're
+    kept between runs like the arena's blocks
+    */
+    OutputBuffer * chunk_outputs;
+    uint32_t chunk_outputs_size;
+} DecoderContext;
+
+void decoder_init(DecoderContext * decoder);
+
+void decoder_free(DecoderContext * decoder);
+
+/*
+Decodes all of 'input' and writes it as nasm-compatible text to 'recipient'.
+The decoded instructions and labels stay available in 'decoder' afterwards
+*/
+void disassemble(
+    DecoderContext * decoder,
+    const uint8_t * input,
+    const uint32_t input_size,
+    OutputBuffer * recipient,
+    uint32_t * good);
+
+/*
+Decodes the 1 instruction at 'offset' in the decoder's input, without adding
+it to the decoder's instructions. Set the decoder's input and input_size
+first. Useful when something other than a linear sweep decides where the
+instructions are (like a simulator following the IP)
+*/
+void decode_instruction_at(
+    DecoderContext * decoder,
+    const uint32_t offset,
+    DecodedInstruction * instruction,
+    uint32_t * good);
+
+/*
+The 2 halves of disassemble(), for when you want to time or use them
+separately: decode_all_instructions() fills the decoder's instructions, and
+append_decoded_text() resolves the jump labels and writes the text
+*/
+void decode_all_instructions(
+    DecoderContext * decoder,
+    const uint8_t * input,
+    const uint32_t input_size,
+    uint32_t * good);
+
+void append_decoded_text(
+    DecoderContext * decoder,
+    OutputBuffer * recipient);
+
+/*
+The first thing append_decoded_text() does, gives every jump target a label.
+For when you need the labels without the text, like before
+redecode_patches()
+*/
+void resolve_jump_labels(
+    DecoderContext * decoder);
+
+/*
+Like append_decoded_text(), but appends only the lines of the instructions
+from 'first_instruction' up to 'end_instruction' (not included), without the
+"bits 16" at the top. For writing a big text a piece at a time
+*/
+void append_decoded_lines(
+    DecoderContext * decoder,
+    const uint32_t first_instruction,
+    const uint32_t end_instruction,
+    OutputBuffer * recipient);
+
+/*
+Appends the text of 1 decoded instruction to 'recipient', without a label or
+a newline. Jumps only get the mnemonic, the caller appends the label name
+*/
+void append_instruction_text(
+    OutputBuffer * recipient,
+    DecodedInstruction * instruction);
+
+/*
+An estimate of how many clocks an instruction takes on an 8086, from the
+instruction timings in Intel's manual: the base clocks of its operand form
+plus the EA clocks of its memory operand (which depend on mod and r/m, for
+example [bx+si] is 7 and [bp+di+disp] is 11). It leaves out the 4 extra
+clocks of a word at an odd address, we can't know the address here
+*/
+typedef struct ClockEstimate {
+    uint16_t clocks; // including ea_clocks, for a jump: when it's not taken
+    uint16_t ea_clocks;
+    uint16_t clocks_if_taken; // the same as 'clocks' if it's not a jump
+} ClockEstimate;
+
+void estimate_clocks(
+    const DecodedInstruction * instruction,
+    ClockEstimate * estimate);
+
+/*
+Like disassemble(), but every line ends with a comment estimating its clocks,
+every basic block (the lines up to a jump, or up to the next label) is
+followed by a comment with its total and the last line is the program's total
+*/
+void disassemble_with_clocks(
+    DecoderContext * decoder,
+    const uint8_t * input,
+    const uint32_t input_size,
+    OutputBuffer * recipient,
+    uint32_t * good);
+
+/*
+Like disassemble(), but only decodes what the jumps and loops can reach from
+the 'entry_points' (offsets in the input), instead of every byte from the
+start. Whatever isn't reached is written as 'db' data, so data in the input
+doesn't stop the disassembly
+*/
+void disassemble_recursive(
+    DecoderContext * decoder,
+    const uint8_t * input,
+    const uint32_t input_size,
+    const uint32_t * entry_points,
+    const uint32_t entry_points_size,
+    OutputBuffer * recipient,
+    uint32_t * good);
+
+/*
+Finds where every instruction in 'input' starts without decoding them: sets
+bit i of 'boundaries' ((input_size + 63) / 64 words) if an instruction starts
+at offset i, and clears the others. Returns how far it got: input_size, or
+the offset of the first instruction we can't decode (the same 1 disassemble()
+would stop at)
+*/
+uint32_t scan_instruction_boundaries(
+    const uint8_t * input,
+    const uint32_t input_size,
+    uint64_t * boundaries);
+
+/*
+Like disassemble(), but splits the work over up to 'threads_count' threads.
+The output is exactly the same
+*/
+void disassemble_parallel(
+    DecoderContext * decoder,
+    const uint8_t * input,
+    const uint32_t input_size,
+    const uint32_t threads_count,
+    OutputBuffer * recipient,
+    uint32_t * good);
+
+/*
+Like disassemble(), but reads 'input_file' through a small window and writes
+to 'output_file' as it goes, so the input can be any size
+*/
+void disassemble_stream(
+    FILE * input_file,
+    FILE * output_file,
+    uint32_t * good);
+
+/*
+The instruction mix of an input: what it's made of, counted straight from the
+decoded instructions without writing any text. Zero it with
+instruction_mix_init(), every collect_instruction_mix() adds to it
+*/
+#define JUMP_OFFSETS_SIZE 256 // every 8-bit jump offset, -128 to 127
+
+typedef struct InstructionMix {
+    uint64_t instructions;
+    uint64_t bytes;
+    uint64_t per_opcode[OPCODE_TABLE_SIZE]; // by opcode_table entry (form)
+    
+    // only instructions with a w field count as 1 or the other
+    uint64_t byte_operations;
+    uint64_t word_operations;
+    
+    /*
+    Instructions with a ModRM byte: mod 3 is a register, the others a memory
+    operand in the same slots as modsub3_rm_table (mod 0 r/m 110 being the
+    direct address)
+    */
+    uint64_t register_operands;
+    uint64_t memory_operands[3][8];
+    
+    // by the offset from the end of the jump + 128, the way the CPU adds it
+    uint64_t jump_offsets[JUMP_OFFSETS_SIZE];
+} InstructionMix;
+
+void instruction_mix_init(InstructionMix * mix);
+
+/*
+Decodes all of 'input' on up to 'threads_count' threads and adds what's in
+it to 'mix'. It fails like disassemble() does, at the first instruction we
+can't decode, and then adds nothing
+*/
+void collect_instruction_mix(
+    const uint8_t * input,
+    const uint32_t input_size,
+    const uint32_t threads_count,
+    InstructionMix * mix,
+    uint32_t * good);
+
+/*
+Appends 'mix' as a text report: the share of every opcode form (most common
+first), of byte and word operations, of every addressing mode and of jump
+offsets in ranges
+*/
+void append_instruction_mix(
+    const InstructionMix * mix,
+    OutputBuffer * recipient);
+
+/*
+A fast (not cryptographic) 64-bit hash of 'input', to recognize inputs we've
+seen before, like in a cache of decoded files
+*/
+uint64_t hash_input(
+    const uint8_t * input,
+    const uint32_t input_size);
+
+/*
+Writes the decoder's instructions and jump labels (after disassemble() or
+decode_all_instructions()) to 'output_file' as a decoded file, the binary
+format in decoded_file.h, with DECODED_RECORDS_FULL or DECODED_RECORDS_COMPACT
+records. 'good' is false if writing failed
+*/
+void write_decoded_file(
+    DecoderContext * decoder,
+    const uint32_t record_format,
+    FILE * output_file,
+    uint32_t * good);
+
+/*
+Writes the text of a decoded file, the same as disassemble() wrote for the
+input it came from. The file has to use our opcode_table. Reads the records
+with next_decoded_record(), so 'reader' has to be fresh from
+open_decoded_file()
+*/
+void append_decoded_file_text(
+    DecodedFileReader * reader,
+    OutputBuffer * recipient,
+    uint32_t * good);
+
+/*
+A range of bytes [start, end) that was changed in a decoder's input
+*/
+typedef struct PatchedRange {
+    uint32_t start;
+    uint32_t end;
+} PatchedRange;
+
+/*
+After disassemble() (or decode_all_instructions()), and after the bytes in
+'patches' were changed in place in the decoder's input: updates the
+decoder's instructions and jump labels to match, re-decoding only around
+each patch (from the instruction it starts in, until the instructions line
+up with the old ones again). Write the text again with
+append_decoded_text().
+Labels keep their numbers, new ones get new numbers, so the text can differ
+from a fresh disassemble() in label numbers only. If a patch leaves bytes we
+can't decode, 'good' is set to false and the patches at lower offsets
+than it stay applied.
+The decoding is local to the patch, the bookkeeping isn't always: a patch
+that changes how many instructions there are moves every instruction after
+it and renumbers them in instruction_at_offset, which costs about as much
+as the rest of the image is big. Patches that keep the count (same-length
+instructions over same-length ones) cost only their own size
+*/
+void redecode_patches(
+    DecoderContext * decoder,
+    const PatchedRange * patches,
+    const uint32_t patches_size,
+    uint32_t * good);
+
+/*
+Instrumentation, to see where the time goes inside disassemble(). It's only
+compiled in when building with -DINSTRUMENT, otherwise the INSTRUMENT_ macros
+below are empty and cost nothing.
+
+Every phase adds up its time (rdtsc ticks on x86, nanoseconds elsewhere) and
+how often it ran. Reading the clock costs about as much as looking up an
+opcode, so the phases that run for every instruction only time 1 in
+INSTRUMENT_SAMPLE_EVERY of them and count that 1 as many times. The counters
+are exact. They and the times are global and not atomic, so they only add up
+right when 1 thread decodes
+*/
+#ifdef INSTRUMENT
+
+typedef enum InstrumentedPhase {
+    PHASE_OPCODE_LOOKUP,    // the dispatch table lookup for 1 instruction
+    PHASE_FIELD_EXTRACTION, // the rest of decoding 1 instruction
+    PHASE_LABEL_RESOLUTION, // resolve_jump_labels()
+    PHASE_INSTRUCTION_TEXT, // append_instruction_text(), part of emission
+    PHASE_EMISSION,         // writing the lines with their labels
+    PHASES_COUNT,
+} InstrumentedPhase;
+
+typedef struct Instrumentation {
+    uint64_t phase_ticks[PHASES_COUNT];
+    uint64_t phase_spans[PHASES_COUNT];
+    uint64_t opcode_table_probes;
+    uint64_t output_bytes_scanned; // output_append() looking for the '\0'
+    uint64_t label_walk_steps; // instructions resolve_jump_labels() visits
+    uint64_t instructions_per_opcode[OPCODE_TABLE_SIZE];
+    
+    // from the 1st instrument_ticks(), to turn ticks into milliseconds
+    uint64_t first_ticks;
+    uint64_t first_nanoseconds;
+    uint64_t clock_read_ticks; // what reading the clock itself costs
+} Instrumentation;
+
+extern Instrumentation instrumentation;
+
+uint64_t instrument_ticks(void);
+
+// the ticks since 'start', without the cost of reading the clock
+uint64_t instrument_ticks_since(const uint64_t start);
+
+#define INSTRUMENT_START(start) uint64_t start = instrument_ticks()
+#define INSTRUMENT_END(phase, start) \
+    do { \
+        instrumentation.phase_ticks[phase] += \
+            instrument_ticks_since(start); \
+        instrumentation.phase_spans[phase] += 1; \
+    } while (0)
+#define INSTRUMENT_COUNT(counter, amount) \
+    instrumentation.counter += (amount)
+
+#ifndef INSTRUMENT_SAMPLE_EVERY
+#define INSTRUMENT_SAMPLE_EVERY 16
+#endif
+#define INSTRUMENT_SAMPLED_START(phase, start) \
+    uint64_t start = \
+        (instrumentation.phase_spans[phase] % INSTRUMENT_SAMPLE_EVERY) == 0 ? \
+            instrument_ticks() : \
+            0
+#define INSTRUMENT_SAMPLED_END(phase, start) \
+    do { \
+        if ((start) != 0) { \
+            instrumentation.phase_ticks[phase] += \
+                instrument_ticks_since(start) * INSTRUMENT_SAMPLE_EVERY; \
+        } \
+        instrumentation.phase_spans[phase] += 1; \
+    } while (0)
+
+#else
+
+#define INSTRUMENT_START(start)
+#define INSTRUMENT_END(phase, start)
+#define INSTRUMENT_COUNT(counter, amount)
+#define INSTRUMENT_SAMPLED_START(phase, start)
+#define INSTRUMENT_SAMPLED_END(phase, start)
+
+#endif // INSTRUMENT
+
+/*
+Appends everything the instrumentation recorded so far, as text or (with
+'as_json') as 1 JSON object. Without -DINSTRUMENT it only says it's off
+*/
+void append_instrumentation_report(
+    OutputBuffer * recipient,
+    const uint32_t as_json);
+
+#endif // DISASSEMBLER_H
@@ -0,0 +1,877 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include "disassembler.h"
+
+/*
+Writes the decoder's tables (opcode_table, the register names and the 2
+lookup tables the decoder indexes with the first 2 bytes of an instruction)
+as static const C to stdout. The output is checked in as
+src/generated_tables.h, so the disassembler doesn't build anything at startup
+and the tables end up in read-only memory that every process can share.
+
+build.sh runs this and stops if its output doesn't match the checked in file,
+so after changing an opcode here do:
+    gcc -std=c99 src/generate_tables.c -o build/generate_tables
+    build/generate_tables > src/generated_tables.h
+*/
+
+static OpCode opcodes[OPCODE_TABLE_SIZE];
+static uint32_t opcodes_size = 0;
+static char reg_names[2][8][3];
+static char modsub3_rm_names[3][8][15];
+
+/*
+opcode_dispatch[first byte][the 3 bits of the 2nd byte a secondary opcode
+would be in] is the index of the opcode in 'opcodes', or OPCODE_NONE
+*/
+static uint8_t opcode_dispatch[256][8];
+
+// by ModRM byte: how many displacement bytes follow it
+static uint8_t modrm_displacement_bytes[256];
+
+/*
+Indexed like opcode_dispatch: the length of the instruction without its
+displacement, plus OPCODE_LENGTH_PLUS_DISPLACEMENT if the ModRM byte after
+the first byte adds a displacement. 0 if there's no opcode
+*/
+static uint8_t opcode_lengths[256][8];
+
+/*
+Adds an opcode with every field 0 (they're static) except the mnemonic
+*/
+static OpCode * new_opcode(
+    const char * text)
+{
+    assert(opcodes_size < OPCODE_TABLE_SIZE);
+    assert(opcodes_size < OPCODE_NONE);
+    OpCode * opcode = &opcodes[opcodes_size];
+    opcodes_size += 1;
+    strcpy(opcode->text, text);
+    return opcode;
+}
+
+static void describe_opcodes(void) {
+    
+    OpCode * opcode = NULL;
+    
+    opcode = new_opcode("MOV");
+    opcode->number = MOV_IMMTOREG; // 1011
+    opcode->size_in_bits = 4;
+    opcode->has_d_field = false;
+    opcode->hardcoded_d_field = 1;
+    opcode->has_w_field = true;
+    opcode->has_mod = false;
+    opcode->has_reg = true;
+    opcode->has_rm = false;
+    opcode->has_data_byte_1 = true;
+    opcode->has_data_byte_2_if_w = true;
+    
+    opcode = new_opcode("MOV");
+    opcode->number = MOV_REGMEMTOREG; // 100010
+    opcode->size_in_bits = 6;
+    opcode->has_d_field = true;
+    opcode->has_w_field = true;
+    opcode->has_mod = true;
+    opcode->has_reg = true;
+    opcode->has_rm = true;
+    
+    /* 
+    note: these names are from the intel manual, actually I would reverse them
+    ('memory to accumulator' moves what's in the accumulator to memory)
+    
+    mov [2555], ax
+    */
+    opcode = new_opcode("MOV");
+    opcode->number = MOV_ACCTOMEM; // 1010001
+    strcpy(opcode->hardcoded_reg_w, "AX");
+    strcpy(opcode->hardcoded_reg_b, "AL");
+    opcode->size_in_bits = 7;
+    opcode->has_w_field = true;
+    opcode->hardcoded_d_field = 0;
+    opcode->has_data_byte_1 = true;
+    opcode->has_data_byte_2_always = true;
+    opcode->data_bytes_are_addresses = true;
+    
+    /* 
+    mov ax, [2555] (yes, intel's opcode name is reversed)
+    */
+    opcode = new_opcode("MOV");
+    opcode->number = MOV_MEMTOACC; // 1010000
+    strcpy(opcode->hardcoded_reg_w, "AX");
+    strcpy(opcode->hardcoded_reg_b, "AL");
+    opcode->size_in_bits = 7;
+    opcode->has_w_field = true;
+    opcode->hardcoded_d_field = 1;
+    opcode->has_data_byte_1 = true;
+    opcode->has_data_byte_2_always = true;
+    opcode->data_bytes_are_addresses = true;
+    
+    opcode = new_opcode("MOV");
+    opcode->number = MOV_IMMTOREGMEM; // 1100011
+    opcode->size_in_bits = 7;
+    opcode->has_secondary_3bit_opcode = true;
+    opcode->secondary_3bit_opcode = 0; // 000
+    opcode->secondary_3bit_offset = 10;
+    opcode->has_w_field = true;
+    opcode->has_d_field = false;
+    // opcode->hardcoded_d_field = 0;
+    opcode->has_mod = true;
+    opcode->has_reg = false;
+    opcode->has_rm = true;
+    opcode->has_data_byte_1 = true;
+    opcode->has_data_byte_2_if_w = true;
+    opcode->data_bytes_are_immediates = true;
+    
+    opcode = new_opcode("ADD");
+    opcode->number = ADD_REGMEMTOREG; // 000000
+    opcode->size_in_bits = 6;
+    opcode->has_d_field = true;
+    opcode->has_w_field = true;
+    opcode->has_mod = true;
+    opcode->has_reg = true;
+    opcode->has_rm = true;
+    
+    opcode = new_opcode("ADD");
+    opcode->number = ADD_IMMTOREGMEM; // 100000
+    opcode->size_in_bits = 6;
+    opcode->has_secondary_3bit_opcode = true;
+    opcode->secondary_3bit_opcode = 0; // 100
+    opcode->secondary_3bit_offset = 10;
+    opcode->has_s_field = true;
+    opcode->has_w_field = true;
+    // opcode->hardcoded_d_field = 0;
+    opcode->has_mod = true;
+    opcode->has_reg = false;
+    opcode->has_rm = true;
+    opcode->has_data_byte_1 = true;
+    opcode->has_data_byte_2_if_w = true;
+    opcode->data_bytes_are_immediates = true;
+    
+    opcode = new_opcode("SUB");
+    opcode->number = SUB_REGMEMTOREG; // 001010
+    opcode->size_in_bits = 6;
+    opcode->has_d_field = true;
+    opcode->has_w_field = true;
+    opcode->has_mod = true;
+    opcode->has_reg = true;
+    opcode->has_rm = true;
+    
+    opcode = new_opcode("SUB");
+    opcode->number = SUB_IMMTOREGMEM; // 100000
+    opcode->size_in_bits = 6;
+    opcode->has_secondary_3bit_opcode = true;
+    opcode->secondary_3bit_opcode = 5; // 101
+    opcode->secondary_3bit_offset = 10;
+    opcode->has_s_field = true;
+    opcode->has_w_field = true;
+    opcode->hardcoded_d_field = 0;
+    opcode->has_mod = true;
+    opcode->has_reg = false;
+    opcode->has_rm = true;
+    opcode->has_data_byte_1 = true;
+    opcode->has_data_byte_2_if_w = true;
+    opcode->data_bytes_are_immediates = true;
+    
+    opcode = new_opcode("CMP");
+    opcode->number = CMP_REGMEMTOREG; // 001110
+    opcode->size_in_bits = 6;
+    opcode->has_d_field = true;
+    opcode->has_w_field = true;
+    opcode->has_mod = true;
+    opcode->has_reg = true;
+    opcode->has_rm = true;
+
+    /*
+    cmp si, 2
+    */
+    opcode = new_opcode("CMP");
+    opcode->number = SUB_IMMTOREGMEM; // 100000
+    opcode->size_in_bits = 6;
+    opcode->has_secondary_3bit_opcode = true;
+    opcode->secondary_3bit_opcode = 7; // 111
+    opcode->secondary_3bit_offset = 10;
+    opcode->has_s_field = true;
+    opcode->has_w_field = true;
+    opcode->hardcoded_d_field = 0;
+    opcode->has_mod = true;
+    opcode->has_reg = false;
+    opcode->has_rm = true;
+    opcode->has_data_byte_1 = true;
+    opcode->has_data_byte_2_if_w = true;
+    opcode->data_bytes_are_immediates = true;
+
+    /*
+    cmp ax, 2
+    */
+    opcode = new_opcode("CMP");
+    opcode->number = CMP_IMMTOACC; // binary: 0011110
+    opcode->size_in_bits = 7;
+    strcpy(opcode->hardcoded_reg_w, "AX");
+    strcpy(opcode->hardcoded_reg_b, "AL");
+    opcode->hardcoded_d_field = 1;
+    opcode->has_w_field = true;
+    opcode->has_data_byte_1 = true;
+    opcode->has_data_byte_2_if_w = true;
+    opcode->data_bytes_are_immediates = true;
+    
+    /*
+    add ax, 1000
+    */
+    opcode = new_opcode("ADD");
+    opcode->number = ADD_IMMTOACC; // 0000010
+    opcode->size_in_bits = 7;
+    strcpy(opcode->hardcoded_reg_w, "AX");
+    strcpy(opcode->hardcoded_reg_b, "AL");
+    opcode->hardcoded_d_field = 1;
+    opcode->has_w_field = true;
+    opcode->has_data_byte_1 = true;
+    opcode->has_data_byte_2_if_w = true;
+    opcode->data_bytes_are_immediates = true;
+
+    /*
+    sub ax, 1000
+    */
+    opcode = new_opcode("SUB");
+    opcode->number = SUB_IMMTOACC; // binary: 0010110
+    opcode->size_in_bits = 7;
+    strcpy(opcode->hardcoded_reg_w, "AX");
+    strcpy(opcode->hardcoded_reg_b, "AL");
+    opcode->hardcoded_d_field = 1;
+    opcode->has_w_field = true;
+    opcode->has_data_byte_1 = true;
+    opcode->has_data_byte_2_if_w = true;
+    opcode->data_bytes_are_immediates = true;
+    
+    /*
+    jump not zero
+    jnz test_label1
+    */
+    opcode = new_opcode("JNZ");
+    opcode->number = JNE_JNZ; // binary: 01110101
+    opcode->size_in_bits = 8;
+    opcode->has_data_byte_1 = true;
+    opcode->data_bytes_are_jump_offsets = true;
+    
+    /*
+    jump equal
+    je label2
+    */
+    opcode = new_opcode("JE");
+    opcode->number = JE; // binary: 01110100
+    opcode->size_in_bits = 8;
+    opcode->has_data_byte_1 = true;
+    opcode->data_bytes_are_jump_offsets = true;
+    
+    /*
+    jump on overflow
+    jo label2
+    */
+    opcode = new_opcode("JO");
+    opcode->number = JO;
+    opcode->size_in_bits = 8;
+    opcode->has_data_byte_1 = true;
+    opcode->data_bytes_are_jump_offsets = true;
+    
+    /*
+    jump on overflow
+    jno label2
+    */
+    opcode = new_opcode("JNO");
+    opcode->number = JNO;
+    opcode->size_in_bits = 8;
+    opcode->has_data_byte_1 = true;
+    opcode->data_bytes_are_jump_offsets = true;
+    
+    /*
+    jump below (TODO: understand how is this different from jump less)
+    jb label2
+    */
+    opcode = new_opcode("JB");
+    opcode->number = JB; // binary: 01110010
+    opcode->size_in_bits = 8;
+    opcode->has_data_byte_1 = true;
+    opcode->data_bytes_are_jump_offsets = true;
+    
+    /*
+    jump not below
+    jnb label2
+    */
+    opcode = new_opcode("JNB");
+    opcode->number = JNB;
+    opcode->size_in_bits = 8;
+    opcode->has_data_byte_1 = true;
+    opcode->data_bytes_are_jump_offsets = true;
+
+    /*
+    jump if below or equal
+    jbe label2
+    */ 
+    opcode = new_opcode("JBE");
+    opcode->number = JBE_JNA; // binary: 01110110
+    opcode->size_in_bits = 8;
+    opcode->has_data_byte_1 = true;
+    opcode->data_bytes_are_jump_offsets = true;
+    
+    /*
+    jump abovej
+    ja label2
+    */
+    opcode = new_opcode("JA");
+    opcode->number = JA;
+    opcode->size_in_bits = 8;
+    opcode->has_data_byte_1 = true;
+    opcode->data_bytes_are_jump_offsets = true;
+    
+    /*
+    jump on sign
+    js label2
+    */
+    opcode = new_opcode("JS");
+    opcode->number = JS;
+    opcode->size_in_bits = 8;
+    opcode->has_data_byte_1 = true;
+    opcode->data_bytes_are_jump_offsets = true;
+
+    /*
+    JNS (jump on not sign)
+    */
+    opcode = new_opcode("JNS");
+    assert(opcode->text[0] != '\0');
+    assert(!opcode->has_secondary_3bit_opcode);
+    opcode->number = JNS;
+    opcode->size_in_bits = 8;
+    opcode->has_data_byte_1 = true;
+    opcode->data_bytes_are_jump_offsets = true;
+    
+    /*
+    jump parity
+    jp label2
+    */
+    opcode = new_opcode("JP");
+    opcode->number = JP;
+    opcode->size_in_bits = 8;
+    opcode->has_data_byte_1 = true;
+    opcode->data_bytes_are_jump_offsets = true;
+    
+    /*
+    jump not parity
+    jnp label2
+    */
+    opcode = new_opcode("JNP");
+    opcode->number = JNP;
+    opcode->size_in_bits = 8;
+    opcode->has_data_byte_1 = true;
+    opcode->data_bytes_are_jump_offsets = true;
+    
+    /*
+    jump less
+    jl label2
+    */
+    opcode = new_opcode("JL");
+    opcode->number = JL; // binary: 01111100
+    opcode->size_in_bits = 8;
+    opcode->has_data_byte_1 = true;
+    opcode->data_bytes_are_jump_offsets = true;
+    
+    /*
+    jump not less
+    jnl label2
+    */
+    opcode = new_opcode("JNL");
+    opcode->number = JNL;
+    opcode->size_in_bits = 8;
+    opcode->has_data_byte_1 = true;
+    opcode->data_bytes_are_jump_offsets = true;
+
+    /*
+    jump less or equal
+    jle label2
+    */
+    opcode = new_opcode("JLE");
+    opcode->number = JLE; // binary: 01111110
+    opcode->size_in_bits = 8;
+    opcode->has_data_byte_1 = true;
+    opcode->data_bytes_are_jump_offsets = true;
+
+    /*
+    jump greater
+    jg label2
+    */
+    opcode = new_opcode("JG");
+    opcode->number = JG; // binary: 01111111
+    opcode->size_in_bits = 8;
+    opcode->has_data_byte_1 = true;
+    opcode->data_bytes_are_jump_offsets = true;
+
+    /*
+    loop while 0 (aka equal)
+    */
+    opcode = new_opcode("LOOPZ");
+    opcode->number = LOOPZ_LOOPE; // binary: 11100001
+    opcode->size_in_bits = 8;
+    opcode->has_data_byte_1 = true;
+    opcode->data_bytes_are_jump_offsets = true;
+    
+    /*
+    loop while not 0 (aka not equal)
+    */
+    opcode = new_opcode("LOOPNZ");
+    opcode->number = LOOPNZ_LOOPNE; // binary: 11100000
+    opcode->size_in_bits = 8;
+    opcode->has_data_byte_1 = true;
+    opcode->data_bytes_are_jump_offsets = true;
+
+    /*
+    'loop cx times' - i think that means the value in the cx register is
+    implicitly used, we'll figure it out
+    loop label2
+    */
+    opcode = new_opcode("LOOP");
+    opcode->number = LOOP; // binary: 11100010
+    opcode->size_in_bits = 8;
+    opcode->has_data_byte_1 = true;
+    opcode->data_bytes_are_jump_offsets = true;
+
+    /*
+    JCXZ (jump when cx is 0)
+    */
+    opcode = new_opcode("JCXZ");
+    opcode->number = JCXZ; // binary: 11100011
+    opcode->size_in_bits = 8;
+    opcode->has_data_byte_1 = true;
+    opcode->data_bytes_are_jump_offsets = true;
+}
+
+static void describe_registers(void) {
+    
+    // mod '11' or 3 with its own table
+    strcpy(reg_names[0][0], "AL");
+    strcpy(reg_names[0][1], "CL");
+    strcpy(reg_names[0][2], "DL");
+    strcpy(reg_names[0][3], "BL");
+    strcpy(reg_names[0][4], "AH");
+    strcpy(reg_names[0][5], "CH");
+    strcpy(reg_names[0][6], "DH");
+    strcpy(reg_names[0][7], "BH");
+    
+    strcpy(reg_names[1][0], "AX");
+    strcpy(reg_names[1][1], "CX");
+    strcpy(reg_names[1][2], "DX");
+    strcpy(reg_names[1][3], "BX");
+    strcpy(reg_names[1][4], "SP");
+    strcpy(reg_names[1][5], "BP");
+    strcpy(reg_names[1][6], "SI");
+    strcpy(reg_names[1][7], "DI");
+    
+    // mod '10' or 2
+    strcpy(modsub3_rm_names[2][0], "BX+SI");
+    strcpy(modsub3_rm_names[2][1], "BX+DI");
+    strcpy(modsub3_rm_names[2][2], "BP+SI");
+    strcpy(modsub3_rm_names[2][3], "BP+DI");
+    strcpy(modsub3_rm_names[2][4], "SI");
+    strcpy(modsub3_rm_names[2][5], "DI");
+    strcpy(modsub3_rm_names[2][6], "BP");
+    strcpy(modsub3_rm_names[2][7], "BX");
+    
+    // mod '01' or 1
+    strcpy(modsub3_rm_names[1][0], "BX+SI");
+    strcpy(modsub3_rm_names[1][1], "BX+DI");
+    strcpy(modsub3_rm_names[1][2], "BP+SI");
+    strcpy(modsub3_rm_names[1][3], "BP+DI");
+    strcpy(modsub3_rm_names[1][4], "SI"); // SI + D8
+    strcpy(modsub3_rm_names[1][5], "DI"); // DI + D8
+    strcpy(modsub3_rm_names[1][6], "BP"); // BP + D8
+    strcpy(modsub3_rm_names[1][7], "BX"); // BX + D8
+    
+    // mod '00' or 0
+    strcpy(modsub3_rm_names[0][0], "BX+SI");
+    strcpy(modsub3_rm_names[0][1], "BX+DI");
+    strcpy(modsub3_rm_names[0][2], "BP+SI");
+    strcpy(modsub3_rm_names[0][3], "BP+DI");
+    strcpy(modsub3_rm_names[0][4], "SI");
+    strcpy(modsub3_rm_names[0][5], "DI");
+    strcpy(modsub3_rm_names[0][6], "DIRADDR");
+    strcpy(modsub3_rm_names[0][7], "BX");
+}
+
+/*
+Everything the decoder needs that follows from the descriptions: the index of
+each hardcoded register, where each field sits and the 2 lookup tables
+*/
+static void derive_tables(void) {
+    
+    /*
+    Find the hardcoded registers in reg_names, so decoded instructions can
+    refer to them the same way as to any other register
+    */
+    for (uint32_t op_i = 0; op_i < opcodes_size; op_i++) {
+        OpCode * opcode = &opcodes[op_i];
+        if (opcode->hardcoded_reg_w[0] == '\0') {
+            continue;
+        }
+        
+        uint32_t found = false;
+        for (uint8_t reg = 0; reg < 8; reg++) {
+            if (
+                strcmp(reg_names[1][reg], opcode->hardcoded_reg_w) == 0 &&
+                strcmp(reg_names[0][reg], opcode->hardcoded_reg_b) == 0)
+            {
+                opcode->hardcoded_reg = reg;
+                found = true;
+                break;
+            }
+        }
+        assert(found);
+        (void)found; // only read by the assert
+    }
+    
+    /*
+    Work out where every field of every opcode lives. The fields come in the
+    same order the old bit-by-bit decoder consumed them: d, s, w, mod, reg,
+    the secondary opcode and r/m, right after the opcode bits. 'bits_used'
+    counts from the top bit of the 16 bit header (opcode byte << 8 | ModRM)
+    */
+    for (uint32_t op_i = 0; op_i < opcodes_size; op_i++) {
+        OpCode * opcode = &opcodes[op_i];
+        
+        uint32_t bits_used = opcode->size_in_bits;
+        
+        #define PLACE_FIELD(has_field, field_shift, field_size) \
+            if (has_field) { \
+                bits_used += field_size; \
+                /* a field never straddles the opcode byte and ModRM */ \
+                assert( \
+                    bits_used <= 8 || \
+                    bits_used - field_size >= 8); \
+                assert(bits_used <= 16); \
+                field_shift = (uint8_t)(16 - bits_used); \
+            }
+        PLACE_FIELD(opcode->has_d_field, opcode->d_shift, 1);
+        PLACE_FIELD(opcode->has_s_field, opcode->s_shift, 1);
+        PLACE_FIELD(opcode->has_w_field, opcode->w_shift, 1);
+        PLACE_FIELD(opcode->has_mod, opcode->mod_shift, 2);
+        PLACE_FIELD(opcode->has_reg, opcode->reg_shift, 3);
+        if (opcode->has_secondary_3bit_opcode) {
+            bits_used += 3;
+        }
+        PLACE_FIELD(opcode->has_rm, opcode->rm_shift, 3);
+        #undef PLACE_FIELD
+        
+        // every 8086 opcode ends on a byte boundary
+        assert(bits_used == 8 || bits_used == 16);
+        opcode->header_bytes = (uint8_t)(bits_used / 8);
+        
+        // so the decoder can look up the displacement by the whole ModRM byte
+        assert(
+            !opcode->has_mod ||
+            (
+                opcode->mod_shift == 6 &&
+                opcode->has_rm &&
+                opcode->rm_shift == 0));
+    }
+    
+    /*
+    Fill the dispatch table. We go from the shortest opcodes to the longest
+    and never overwrite a slot that's already taken, so we get the same
+    priority as trying 2 bits, then 3 bits, etc.
+    */
+    for (uint32_t first_byte = 0; first_byte < 256; first_byte++) {
+        for (uint32_t secondary = 0; secondary < 8; secondary++) {
+            opcode_dispatch[first_byte][secondary] = OPCODE_NONE;
+        }
+    }
+
+    for (uint8_t size_in_bits = 2; size_in_bits <= 8; size_in_bits++) {
+        for (uint32_t op_i = 0; op_i < opcodes_size; op_i++) {
+            OpCode * opcode = &opcodes[op_i];
+            if (opcode->size_in_bits != size_in_bits) {
+                continue;
+            }
+
+            // the secondary opcode is always the 'reg' field of byte 2
+            assert(
+                !opcode->has_secondary_3bit_opcode ||
+                opcode->secondary_3bit_offset == 10);
+
+            for (uint32_t first_byte = 0; first_byte < 256; first_byte++) {
+                if ((first_byte >> (8 - size_in_bits)) != opcode->number) {
+                    continue;
+                }
+
+                for (uint32_t secondary = 0; secondary < 8; secondary++) {
+                    if (
+                        opcode->has_secondary_3bit_opcode &&
+                        opcode->secondary_3bit_opcode != secondary)
+                    {
+                        continue;
+                    }
+
+                    if (opcode_dispatch[first_byte][secondary] == OPCODE_NONE)
+                    {
+                        opcode_dispatch[first_byte][secondary] = (uint8_t)op_i;
+                    }
+                }
+            }
+        }
+    }
+    
+    for (uint32_t modrm = 0; modrm < 256; modrm++) {
+        uint32_t mod = modrm >> 6;
+        uint32_t r_m = modrm & 7;
+        modrm_displacement_bytes[modrm] = 0;
+        if (mod == 1) {
+            // memory mode, 8-bit displacement follows
+            modrm_displacement_bytes[modrm] = 1;
+        } else if (mod == 2) {
+            // memory mode, 16-bit displacement follows
+            modrm_displacement_bytes[modrm] = 2;
+        } else if (mod == 0 && r_m == 6) {
+            // memory mode has no displacement, 'except when r/m = 110, then
+            // 16 bit discplacement follows'
+            modrm_displacement_bytes[modrm] = 2;
+        }
+        // mod 3 is register mode (no displacement)
+    }
+    
+    /*
+    The lengths, with the same rules as the decoder. 'w' and 's' are always
+    in the first byte, so it and the opcode decide how many data bytes follow
+    */
+    for (uint32_t first_byte = 0; first_byte < 256; first_byte++) {
+        for (uint32_t secondary = 0; secondary < 8; secondary++) {
+            opcode_lengths[first_byte][secondary] = 0;
+            uint8_t op_i = opcode_dispatch[first_byte][secondary];
+            if (op_i == OPCODE_NONE) {
+                continue;
+            }
+            OpCode * opcode = &opcodes[op_i];
+            
+            // no field means UINT8_MAX, like in the decoder
+            uint8_t w = UINT8_MAX;
+            if (opcode->has_w_field) {
+                assert(opcode->w_shift >= 8);
+                w = (first_byte >> (opcode->w_shift - 8)) & 1;
+            }
+            uint8_t s = UINT8_MAX;
+            if (opcode->has_s_field) {
+                assert(opcode->s_shift >= 8);
+                s = (first_byte >> (opcode->s_shift - 8)) & 1;
+            }
+            
+            uint8_t data_bytes = 0;
+            if (opcode->has_data_byte_1) {
+                data_bytes = 1;
+                if (
+                    opcode->has_data_byte_2_always ||
+                    (
+                    opcode->has_data_byte_2_if_w &&
+                        w &&
+                        (!opcode->has_s_field || !s)))
+                {
+                    data_bytes = 2;
+                }
+            }
+            
+            uint8_t length = (uint8_t)(opcode->header_bytes + data_bytes);
+            assert(length < OPCODE_LENGTH_PLUS_DISPLACEMENT);
+            if (opcode->has_mod) {
+                length |= OPCODE_LENGTH_PLUS_DISPLACEMENT;
+            }
+            opcode_lengths[first_byte][secondary] = length;
+        }
+    }
+}
+
+/*
+Everything the tables are printed with goes through here, so we can hash it
+as we go: opcode_table_version is the FNV-1a hash of the tables' text, and
+changes whenever anything in them does
+*/
+static uint64_t tables_hash = 0xcbf29ce484222325;
+
+static void emit(
+    const char * format,
+    ...)
+{
+    char text[256];
+    va_list args;
+    va_start(args, format);
+    int text_size = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    assert(text_size >= 0 && text_size < (int)sizeof(text));
+    
+    for (int i = 0; i < text_size; i++) {
+        tables_hash = (tables_hash ^ (uint8_t)text[i]) * 0x100000001b3;
+    }
+    fputs(text, stdout);
+}
+
+static void print_binary(
+    const uint32_t input,
+    const uint32_t digits)
+{
+    for (int32_t i = (int32_t)digits - 1; i >= 0; i--) {
+        emit("%u", (input >> i) & 1);
+    }
+}
+
+static void print_opcode_table(void) {
+    
+    emit("const uint32_t opcode_table_size = %u;\n\n", opcodes_size);
+    emit("const OpCode opcode_table[OPCODE_TABLE_SIZE] = {\n");
+    for (uint32_t op_i = 0; op_i < opcodes_size; op_i++) {
+        OpCode * opcode = &opcodes[op_i];
+        emit("    { // %u\n", op_i);
+        emit("        .text = \"%s\",\n", opcode->text);
+        emit("        .number = %u, // ", opcode->number);
+        print_binary(opcode->number, opcode->size_in_bits);
+        emit("\n");
+        
+        // only what isn't 0, the rest is 0 anyway
+        #define PRINT_FIELD(field) \
+            if (opcode->field) { \
+                emit( \
+                    "        ." #field " = %u,\n", \
+                    (uint32_t)opcode->field); \
+            }
+        #define PRINT_STRING_FIELD(field) \
+            if (opcode->field[0] != '\0') { \
+                emit("        ." #field " = \"%s\",\n", opcode->field); \
+            }
+        PRINT_FIELD(size_in_bits);
+        PRINT_FIELD(has_secondary_3bit_opcode);
+        PRINT_FIELD(secondary_3bit_opcode);
+        PRINT_FIELD(secondary_3bit_offset);
+        PRINT_FIELD(has_d_field);
+        PRINT_FIELD(hardcoded_d_field);
+        PRINT_FIELD(has_s_field);
+        PRINT_FIELD(has_w_field);
+        PRINT_FIELD(has_mod);
+        PRINT_FIELD(has_reg);
+        PRINT_STRING_FIELD(hardcoded_reg_w);
+        PRINT_STRING_FIELD(hardcoded_reg_b);
+        PRINT_FIELD(hardcoded_reg);
+        PRINT_FIELD(has_rm);
+        PRINT_FIELD(data_bytes_are_addresses);
+        PRINT_FIELD(data_bytes_are_immediates);
+        PRINT_FIELD(data_bytes_are_jump_offsets);
+        PRINT_FIELD(has_data_byte_1);
+        PRINT_FIELD(has_data_byte_2_if_w);
+        PRINT_FIELD(has_data_byte_2_always);
+        PRINT_FIELD(header_bytes);
+        PRINT_FIELD(d_shift);
+        PRINT_FIELD(s_shift);
+        PRINT_FIELD(w_shift);
+        PRINT_FIELD(mod_shift);
+        PRINT_FIELD(reg_shift);
+        PRINT_FIELD(rm_shift);
+        #undef PRINT_FIELD
+        #undef PRINT_STRING_FIELD
+        emit("    },\n");
+    }
+    emit("};\n\n");
+}
+
+static void print_names(
+    const char * declaration,
+    const char * names,
+    const uint32_t rows,
+    const uint32_t name_size)
+{
+    emit("%s = {\n", declaration);
+    for (uint32_t row = 0; row < rows; row++) {
+        emit("    {");
+        for (uint32_t i = 0; i < 8; i++) {
+            emit(
+                "%s\"%s\"",
+                i > 0 ? ", " : "",
+                &names[((row * 8) + i) * name_size]);
+        }
+        emit("},\n");
+    }
+    emit("};\n\n");
+}
+
+static void print_lookup_tables(void) {
+    
+    emit(
+        "// %u means there's no opcode starting with these bits\n",
+        OPCODE_NONE);
+    emit("static const uint8_t opcode_dispatch_table[256][8] = {\n");
+    for (uint32_t first_byte = 0; first_byte < 256; first_byte++) {
+        emit("    /* 0x%02x */ {", first_byte);
+        for (uint32_t secondary = 0; secondary < 8; secondary++) {
+            emit(
+                "%s%3u",
+                secondary > 0 ? ", " : "",
+                opcode_dispatch[first_byte][secondary]);
+        }
+        emit("},\n");
+    }
+    emit("};\n\n");
+    
+    emit("static const uint8_t modrm_displacement_bytes[256] = {\n");
+    for (uint32_t modrm = 0; modrm < 256; modrm += 16) {
+        emit("    /* 0x%02x */", modrm);
+        for (uint32_t i = 0; i < 16; i++) {
+            emit(" %u,", modrm_displacement_bytes[modrm + i]);
+        }
+        emit("\n");
+    }
+    emit("};\n\n");
+    
+    emit(
+        "// 0x%02x means the ModRM byte's displacement is added\n",
+        OPCODE_LENGTH_PLUS_DISPLACEMENT);
+    emit("static const uint8_t opcode_length_table[256][8] = {\n");
+    for (uint32_t first_byte = 0; first_byte < 256; first_byte++) {
+        emit("    /* 0x%02x */ {", first_byte);
+        for (uint32_t secondary = 0; secondary < 8; secondary++) {
+            emit(
+                "%s0x%02x",
+                secondary > 0 ? ", " : "",
+                opcode_lengths[first_byte][secondary]);
+        }
+        emit("},\n");
+    }
+    emit("};\n");
+}
+
+int main(void) {
+    
+    describe_opcodes();
+    describe_registers();
+    derive_tables();
+    
+    printf(
+        "/*\n"
+        "Generated by src/generate_tables.c, don't edit it by hand: change "
+        "the\n"
+        "generator and run it again (build.sh checks they match).\n"
+        "Only disassembler.c includes this, it defines the tables "
+        "disassembler.h\n"
+        "declares\n"
+        "*/\n\n");
+    print_opcode_table();
+    print_names(
+        "const char reg_table[2][8][3]",
+        &reg_names[0][0][0],
+        2,
+        3);
+    print_names(
+        "const char modsub3_rm_table[3][8][15]",
+        &modsub3_rm_names[0][0][0],
+        3,
+        15);
+    print_lookup_tables();
+    printf(
+        "\nconst uint64_t opcode_table_version = 0x%016llx;\n",
+        (unsigned long long)tables_hash);
+    
+    return 0;
+}
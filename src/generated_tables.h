@@ -0,0 +1,937 @@
+/*
+Generated by src/generate_tables.c, don't edit it by hand: change the
+generator and run it again (build.sh checks they match).
+Only disassembler.c includes this, it defines the tables disassembler.h
+declares
+*/
+
+const uint32_t opcode_table_size = 34;
+
+const OpCode opcode_table[OPCODE_TABLE_SIZE] = {
+    { // 0
+        .text = "MOV",
+        .number = 11, // 1011
+        .size_in_bits = 4,
+        .hardcoded_d_field = 1,
+        .has_w_field = 1,
+        .has_reg = 1,
+        .has_data_byte_1 = 1,
+        .has_data_byte_2_if_w = 1,
+        .header_bytes = 1,
+        .w_shift = 11,
+        .reg_shift = 8,
+    },
+    { // 1
+        .text = "MOV",
+        .number = 34, // 100010
+        .size_in_bits = 6,
+        .has_d_field = 1,
+        .has_w_field = 1,
+        .has_mod = 1,
+        .has_reg = 1,
+        .has_rm = 1,
+        .header_bytes = 2,
+        .d_shift = 9,
+        .w_shift = 8,
+        .mod_shift = 6,
+        .reg_shift = 3,
+    },
+    { // 2
+        .text = "MOV",
+        .number = 81, // 1010001
+        .size_in_bits = 7,
+        .has_w_field = 1,
+        .hardcoded_reg_w = "AX",
+        .hardcoded_reg_b = "AL",
+        .data_bytes_are_addresses = 1,
+        .has_data_byte_1 = 1,
+        .has_data_byte_2_always = 1,
+        .header_bytes = 1,
+        .w_shift = 8,
+    },
+    { // 3
+        .text = "MOV",
+        .number = 80, // 1010000
+        .size_in_bits = 7,
+        .hardcoded_d_field = 1,
+        .has_w_field = 1,
+        .hardcoded_reg_w = "AX",
+        .hardcoded_reg_b = "AL",
+        .data_bytes_are_addresses = 1,
+        .has_data_byte_1 = 1,
+        .has_data_byte_2_always = 1,
+        .header_bytes = 1,
+        .w_shift = 8,
+    },
+    { // 4
+        .text = "MOV",
+        .number = 99, // 1100011
+        .size_in_bits = 7,
+        .has_secondary_3bit_opcode = 1,
+        .secondary_3bit_offset = 10,
+        .has_w_field = 1,
+        .has_mod = 1,
+        .has_rm = 1,
+        .data_bytes_are_immediates = 1,
+        .has_data_byte_1 = 1,
+        .has_data_byte_2_if_w = 1,
+        .header_bytes = 2,
+        .w_shift = 8,
+        .mod_shift = 6,
+    },
+    { // 5
+        .text = "ADD",
+        .number = 0, // 000000
+        .size_in_bits = 6,
+        .has_d_field = 1,
+        .has_w_field = 1,
+        .has_mod = 1,
+        .has_reg = 1,
+        .has_rm = 1,
+        .header_bytes = 2,
+        .d_shift = 9,
+        .w_shift = 8,
+        .mod_shift = 6,
+        .reg_shift = 3,
+    },
+    { // 6
+        .text = "ADD",
+        .number = 32, // 100000
+        .size_in_bits = 6,
+        .has_secondary_3bit_opcode = 1,
+        .secondary_3bit_offset = 10,
+        .has_s_field = 1,
+        .has_w_field = 1,
+        .has_mod = 1,
+        .has_rm = 1,
+        .data_bytes_are_immediates = 1,
+        .has_data_byte_1 = 1,
+        .has_data_byte_2_if_w = 1,
+        .header_bytes = 2,
+        .s_shift = 9,
+        .w_shift = 8,
+        .mod_shift = 6,
+    },
+    { // 7
+        .text = "SUB",
+        .number = 10, // 001010
+        .size_in_bits = 6,
+        .has_d_field = 1,
+        .has_w_field = 1,
+        .has_mod = 1,
+        .has_reg = 1,
+        .has_rm = 1,
+        .header_bytes = 2,
+        .d_shift = 9,
+        .w_shift = 8,
+        .mod_shift = 6,
+        .reg_shift = 3,
+    },
+    { // 8
+        .text = "SUB",
+        .number = 32, // 100000
+        .size_in_bits = 6,
+        .has_secondary_3bit_opcode = 1,
+        .secondary_3bit_opcode = 5,
+        .secondary_3bit_offset = 10,
+        .has_s_field = 1,
+        .has_w_field = 1,
+        .has_mod = 1,
+        .has_rm = 1,
+        .data_bytes_are_immediates = 1,
+        .has_data_byte_1 = 1,
+        .has_data_byte_2_if_w = 1,
+        .header_bytes = 2,
+        .s_shift = 9,
+        .w_shift = 8,
+        .mod_shift = 6,
+    },
+    { // 9
+        .text = "CMP",
+        .number = 14, // 001110
+        .size_in_bits = 6,
+        .has_d_field = 1,
+        .has_w_field = 1,
+        .has_mod = 1,
+        .has_reg = 1,
+        .has_rm = 1,
+        .header_bytes = 2,
+        .d_shift = 9,
+        .w_shift = 8,
+        .mod_shift = 6,
+        .reg_shift = 3,
+    },
+    { // 10
+        .text = "CMP",
+        .number = 32, // 100000
+        .size_in_bits = 6,
+        .has_secondary_3bit_opcode = 1,
+        .secondary_3bit_opcode = 7,
+        .secondary_3bit_offset = 10,
+        .has_s_field = 1,
+        .has_w_field = 1,
+        .has_mod = 1,
+        .has_rm = 1,
+        .data_bytes_are_immediates = 1,
+        .has_data_byte_1 = 1,
+        .has_data_byte_2_if_w = 1,
+        .header_bytes = 2,
+        .s_shift = 9,
+        .w_shift = 8,
+        .mod_shift = 6,
+    },
+    { // 11
+        .text = "CMP",
+        .number = 30, // 0011110
+        .size_in_bits = 7,
+        .hardcoded_d_field = 1,
+        .has_w_field = 1,
+        .hardcoded_reg_w = "AX",
+        .hardcoded_reg_b = "AL",
+        .data_bytes_are_immediates = 1,
+        .has_data_byte_1 = 1,
+        .has_data_byte_2_if_w = 1,
+        .header_bytes = 1,
+        .w_shift = 8,
+    },
+    { // 12
+        .text = "ADD",
+        .number = 2, // 0000010
+        .size_in_bits = 7,
+        .hardcoded_d_field = 1,
+        .has_w_field = 1,
+        .hardcoded_reg_w = "AX",
+        .hardcoded_reg_b = "AL",
+        .data_bytes_are_immediates = 1,
+        .has_data_byte_1 = 1,
+        .has_data_byte_2_if_w = 1,
+        .header_bytes = 1,
+        .w_shift = 8,
+    },
+    { // 13
+        .text = "SUB",
+        .number = 22, // 0010110
+        .size_in_bits = 7,
+        .hardcoded_d_field = 1,
+        .has_w_field = 1,
+        .hardcoded_reg_w = "AX",
+        .hardcoded_reg_b = "AL",
+        .data_bytes_are_immediates = 1,
+        .has_data_byte_1 = 1,
+        .has_data_byte_2_if_w = 1,
+        .header_bytes = 1,
+        .w_shift = 8,
+    },
+    { // 14
+        .text = "JNZ",
+        .number = 117, // 01110101
+        .size_in_bits = 8,
+        .data_bytes_are_jump_offsets = 1,
+        .has_data_byte_1 = 1,
+        .header_bytes = 1,
+    },
+    { // 15
+        .text = "JE",
+        .number = 116, // 01110100
+        .size_in_bits = 8,
+        .data_bytes_are_jump_offsets = 1,
+        .has_data_byte_1 = 1,
+        .header_bytes = 1,
+    },
+    { // 16
+        .text = "JO",
+        .number = 112, // 01110000
+        .size_in_bits = 8,
+        .data_bytes_are_jump_offsets = 1,
+        .has_data_byte_1 = 1,
+        .header_bytes = 1,
+    },
+    { // 17
+        .text = "JNO",
+        .number = 113, // 01110001
+        .size_in_bits = 8,
+        .data_bytes_are_jump_offsets = 1,
+        .has_data_byte_1 = 1,
+        .header_bytes = 1,
+    },
+    { // 18
+        .text = "JB",
+        .number = 114, // 01110010
+        .size_in_bits = 8,
+        .data_bytes_are_jump_offsets = 1,
+        .has_data_byte_1 = 1,
+        .header_bytes = 1,
+    },
+    { // 19
+        .text = "JNB",
+        .number = 115, // 01110011
+        .size_in_bits = 8,
+        .data_bytes_are_jump_offsets = 1,
+        .has_data_byte_1 = 1,
+        .header_bytes = 1,
+    },
+    { // 20
+        .text = "JBE",
+        .number = 118, // 01110110
+        .size_in_bits = 8,
+        .data_bytes_are_jump_offsets = 1,
+        .has_data_byte_1 = 1,
+        .header_bytes = 1,
+    },
+    { // 21
+        .text = "JA",
+        .number = 119, // 01110111
+        .size_in_bits = 8,
+        .data_bytes_are_jump_offsets = 1,
+        .has_data_byte_1 = 1,
+        .header_bytes = 1,
+    },
+    { // 22
+        .text = "JS",
+        .number = 120, // 01111000
+        .size_in_bits = 8,
+        .data_bytes_are_jump_offsets = 1,
+        .has_data_byte_1 = 1,
+        .header_bytes = 1,
+    },
+    { // 23
+        .text = "JNS",
+        .number = 121, // 01111001
+        .size_in_bits = 8,
+        .data_bytes_are_jump_offsets = 1,
+        .has_data_byte_1 = 1,
+        .header_bytes = 1,
+    },
+    { // 24
+        .text = "JP",
+        .number = 122, // 01111010
+        .size_in_bits = 8,
+        .data_bytes_are_jump_offsets = 1,
+        .has_data_byte_1 = 1,
+        .header_bytes = 1,
+    },
+    { // 25
+        .text = "JNP",
+        .number = 123, // 01111011
+        .size_in_bits = 8,
+        .data_bytes_are_jump_offsets = 1,
+        .has_data_byte_1 = 1,
+        .header_bytes = 1,
+    },
+    { // 26
+        .text = "JL",
+        .number = 124, // 01111100
+        .size_in_bits = 8,
+        .data_bytes_are_jump_offsets = 1,
+        .has_data_byte_1 = 1,
+        .header_bytes = 1,
+    },
+    { // 27
+        .text = "JNL",
+        .number = 125, // 01111101
+        .size_in_bits = 8,
+        .data_bytes_are_jump_offsets = 1,
+        .has_data_byte_1 = 1,
+        .header_bytes = 1,
+    },
+    { // 28
+        .text = "JLE",
+        .number = 126, // 01111110
+        .size_in_bits = 8,
+        .data_bytes_are_jump_offsets = 1,
+        .has_data_byte_1 = 1,
+        .header_bytes = 1,
+    },
+    { // 29
+        .text = "JG",
+        .number = 127, // 01111111
+        .size_in_bits = 8,
+        .data_bytes_are_jump_offsets = 1,
+        .has_data_byte_1 = 1,
+        .header_bytes = 1,
+    },
+    { // 30
+        .text = "LOOPZ",
+        .number = 225, // 11100001
+        .size_in_bits = 8,
+        .data_bytes_are_jump_offsets = 1,
+        .has_data_byte_1 = 1,
+        .header_bytes = 1,
+    },
+    { // 31
+        .text = "LOOPNZ",
+        .number = 224, // 11100000
+        .size_in_bits = 8,
+        .data_bytes_are_jump_offsets = 1,
+        .has_data_byte_1 = 1,
+        .header_bytes = 1,
+    },
+    { // 32
+        .text = "LOOP",
+        .number = 226, // 11100010
+        .size_in_bits = 8,
+        .data_bytes_are_jump_offsets = 1,
+        .has_data_byte_1 = 1,
+        .header_bytes = 1,
+    },
+    { // 33
+        .text = "JCXZ",
+        .number = 227, // 11100011
+        .size_in_bits = 8,
+        .data_bytes_are_jump_offsets = 1,
+        .has_data_byte_1 = 1,
+        .header_bytes = 1,
+    },
+};
+
+const char reg_table[2][8][3] = {
+    {"AL", "CL", "DL", "BL", "AH", "CH", "DH", "BH"},
+    {"AX", "CX", "DX", "BX", "SP", "BP", "SI", "DI"},
+};
+
+const char modsub3_rm_table[3][8][15] = {
+    {"BX+SI", "BX+DI", "BP+SI", "BP+DI", "SI", "DI", "DIRADDR", "BX"},
+    {"BX+SI", "BX+DI", "BP+SI", "BP+DI", "SI", "DI", "BP", "BX"},
+    {"BX+SI", "BX+DI", "BP+SI", "BP+DI", "SI", "DI", "BP", "BX"},
+};
+
+// 255 means there's no opcode starting with these bits
+static const uint8_t opcode_dispatch_table[256][8] = {
+    /* 0x00 */ {  5,   5,   5,   5,   5,   5,   5,   5},
+    /* 0x01 */ {  5,   5,   5,   5,   5,   5,   5,   5},
+    /* 0x02 */ {  5,   5,   5,   5,   5,   5,   5,   5},
+    /* 0x03 */ {  5,   5,   5,   5,   5,   5,   5,   5},
+    /* 0x04 */ { 12,  12,  12,  12,  12,  12,  12,  12},
+    /* 0x05 */ { 12,  12,  12,  12,  12,  12,  12,  12},
+    /* 0x06 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x07 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x08 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x09 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x0a */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x0b */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x0c */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x0d */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x0e */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x0f */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x10 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x11 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x12 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x13 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x14 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x15 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x16 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x17 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x18 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x19 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x1a */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x1b */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x1c */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x1d */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x1e */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x1f */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x20 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x21 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x22 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x23 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x24 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x25 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x26 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x27 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x28 */ {  7,   7,   7,   7,   7,   7,   7,   7},
+    /* 0x29 */ {  7,   7,   7,   7,   7,   7,   7,   7},
+    /* 0x2a */ {  7,   7,   7,   7,   7,   7,   7,   7},
+    /* 0x2b */ {  7,   7,   7,   7,   7,   7,   7,   7},
+    /* 0x2c */ { 13,  13,  13,  13,  13,  13,  13,  13},
+    /* 0x2d */ { 13,  13,  13,  13,  13,  13,  13,  13},
+    /* 0x2e */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x2f */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x30 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x31 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x32 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x33 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x34 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x35 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x36 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x37 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x38 */ {  9,   9,   9,   9,   9,   9,   9,   9},
+    /* 0x39 */ {  9,   9,   9,   9,   9,   9,   9,   9},
+    /* 0x3a */ {  9,   9,   9,   9,   9,   9,   9,   9},
+    /* 0x3b */ {  9,   9,   9,   9,   9,   9,   9,   9},
+    /* 0x3c */ { 11,  11,  11,  11,  11,  11,  11,  11},
+    /* 0x3d */ { 11,  11,  11,  11,  11,  11,  11,  11},
+    /* 0x3e */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x3f */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x40 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x41 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x42 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x43 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x44 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x45 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x46 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x47 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x48 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x49 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x4a */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x4b */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x4c */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x4d */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x4e */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x4f */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x50 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x51 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x52 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x53 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x54 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x55 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x56 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x57 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x58 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x59 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x5a */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x5b */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x5c */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x5d */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x5e */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x5f */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x60 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x61 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x62 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x63 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x64 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x65 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x66 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x67 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x68 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x69 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x6a */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x6b */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x6c */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x6d */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x6e */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x6f */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x70 */ { 16,  16,  16,  16,  16,  16,  16,  16},
+    /* 0x71 */ { 17,  17,  17,  17,  17,  17,  17,  17},
+    /* 0x72 */ { 18,  18,  18,  18,  18,  18,  18,  18},
+    /* 0x73 */ { 19,  19,  19,  19,  19,  19,  19,  19},
+    /* 0x74 */ { 15,  15,  15,  15,  15,  15,  15,  15},
+    /* 0x75 */ { 14,  14,  14,  14,  14,  14,  14,  14},
+    /* 0x76 */ { 20,  20,  20,  20,  20,  20,  20,  20},
+    /* 0x77 */ { 21,  21,  21,  21,  21,  21,  21,  21},
+    /* 0x78 */ { 22,  22,  22,  22,  22,  22,  22,  22},
+    /* 0x79 */ { 23,  23,  23,  23,  23,  23,  23,  23},
+    /* 0x7a */ { 24,  24,  24,  24,  24,  24,  24,  24},
+    /* 0x7b */ { 25,  25,  25,  25,  25,  25,  25,  25},
+    /* 0x7c */ { 26,  26,  26,  26,  26,  26,  26,  26},
+    /* 0x7d */ { 27,  27,  27,  27,  27,  27,  27,  27},
+    /* 0x7e */ { 28,  28,  28,  28,  28,  28,  28,  28},
+    /* 0x7f */ { 29,  29,  29,  29,  29,  29,  29,  29},
+    /* 0x80 */ {  6, 255, 255, 255, 255,   8, 255,  10},
+    /* 0x81 */ {  6, 255, 255, 255, 255,   8, 255,  10},
+    /* 0x82 */ {  6, 255, 255, 255, 255,   8, 255,  10},
+    /* 0x83 */ {  6, 255, 255, 255, 255,   8, 255,  10},
+    /* 0x84 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x85 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x86 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x87 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x88 */ {  1,   1,   1,   1,   1,   1,   1,   1},
+    /* 0x89 */ {  1,   1,   1,   1,   1,   1,   1,   1},
+    /* 0x8a */ {  1,   1,   1,   1,   1,   1,   1,   1},
+    /* 0x8b */ {  1,   1,   1,   1,   1,   1,   1,   1},
+    /* 0x8c */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x8d */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x8e */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x8f */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x90 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x91 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x92 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x93 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x94 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x95 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x96 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x97 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x98 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x99 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x9a */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x9b */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x9c */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x9d */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x9e */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0x9f */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xa0 */ {  3,   3,   3,   3,   3,   3,   3,   3},
+    /* 0xa1 */ {  3,   3,   3,   3,   3,   3,   3,   3},
+    /* 0xa2 */ {  2,   2,   2,   2,   2,   2,   2,   2},
+    /* 0xa3 */ {  2,   2,   2,   2,   2,   2,   2,   2},
+    /* 0xa4 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xa5 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xa6 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xa7 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xa8 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xa9 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xaa */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xab */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xac */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xad */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xae */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xaf */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xb0 */ {  0,   0,   0,   0,   0,   0,   0,   0},
+    /* 0xb1 */ {  0,   0,   0,   0,   0,   0,   0,   0},
+    /* 0xb2 */ {  0,   0,   0,   0,   0,   0,   0,   0},
+    /* 0xb3 */ {  0,   0,   0,   0,   0,   0,   0,   0},
+    /* 0xb4 */ {  0,   0,   0,   0,   0,   0,   0,   0},
+    /* 0xb5 */ {  0,   0,   0,   0,   0,   0,   0,   0},
+    /* 0xb6 */ {  0,   0,   0,   0,   0,   0,   0,   0},
+    /* 0xb7 */ {  0,   0,   0,   0,   0,   0,   0,   0},
+    /* 0xb8 */ {  0,   0,   0,   0,   0,   0,   0,   0},
+    /* 0xb9 */ {  0,   0,   0,   0,   0,   0,   0,   0},
+    /* 0xba */ {  0,   0,   0,   0,   0,   0,   0,   0},
+    /* 0xbb */ {  0,   0,   0,   0,   0,   0,   0,   0},
+    /* 0xbc */ {  0,   0,   0,   0,   0,   0,   0,   0},
+    /* 0xbd */ {  0,   0,   0,   0,   0,   0,   0,   0},
+    /* 0xbe */ {  0,   0,   0,   0,   0,   0,   0,   0},
+    /* 0xbf */ {  0,   0,   0,   0,   0,   0,   0,   0},
+    /* 0xc0 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xc1 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xc2 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xc3 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xc4 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xc5 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xc6 */ {  4, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xc7 */ {  4, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xc8 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xc9 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xca */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xcb */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xcc */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xcd */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xce */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xcf */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xd0 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xd1 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xd2 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xd3 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xd4 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xd5 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xd6 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xd7 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xd8 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xd9 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xda */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xdb */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xdc */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xdd */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xde */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xdf */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xe0 */ { 31,  31,  31,  31,  31,  31,  31,  31},
+    /* 0xe1 */ { 30,  30,  30,  30,  30,  30,  30,  30},
+    /* 0xe2 */ { 32,  32,  32,  32,  32,  32,  32,  32},
+    /* 0xe3 */ { 33,  33,  33,  33,  33,  33,  33,  33},
+    /* 0xe4 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xe5 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xe6 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xe7 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xe8 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xe9 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xea */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xeb */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xec */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xed */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xee */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xef */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xf0 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xf1 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xf2 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xf3 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xf4 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xf5 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xf6 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xf7 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xf8 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xf9 */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xfa */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xfb */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xfc */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xfd */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xfe */ {255, 255, 255, 255, 255, 255, 255, 255},
+    /* 0xff */ {255, 255, 255, 255, 255, 255, 255, 255},
+};
+
+static const uint8_t modrm_displacement_bytes[256] = {
+    /* 0x00 */ 0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 2, 0,
+    /* 0x10 */ 0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 2, 0,
+    /* 0x20 */ 0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 2, 0,
+    /* 0x30 */ 0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 2, 0,
+    /* 0x40 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    /* 0x50 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    /* 0x60 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    /* 0x70 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    /* 0x80 */ 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+    /* 0x90 */ 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+    /* 0xa0 */ 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+    /* 0xb0 */ 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+    /* 0xc0 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    /* 0xd0 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    /* 0xe0 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    /* 0xf0 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+// 0x80 means the ModRM byte's displacement is added
+static const uint8_t opcode_length_table[256][8] = {
+    /* 0x00 */ {0x82, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82},
+    /* 0x01 */ {0x82, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82},
+    /* 0x02 */ {0x82, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82},
+    /* 0x03 */ {0x82, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82},
+    /* 0x04 */ {0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02},
+    /* 0x05 */ {0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03},
+    /* 0x06 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x07 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x08 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x09 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x0a */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x0b */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x0c */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x0d */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x0e */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x0f */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x10 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x11 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x12 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x13 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x14 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x15 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x16 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x17 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x18 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x19 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x1a */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x1b */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x1c */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x1d */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x1e */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x1f */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x20 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x21 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x22 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x23 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x24 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x25 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x26 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x27 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x28 */ {0x82, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82},
+    /* 0x29 */ {0x82, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82},
+    /* 0x2a */ {0x82, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82},
+    /* 0x2b */ {0x82, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82},
+    /* 0x2c */ {0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02},
+    /* 0x2d */ {0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03},
+    /* 0x2e */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x2f */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x30 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x31 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x32 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x33 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x34 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x35 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x36 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x37 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x38 */ {0x82, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82},
+    /* 0x39 */ {0x82, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82},
+    /* 0x3a */ {0x82, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82},
+    /* 0x3b */ {0x82, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82},
+    /* 0x3c */ {0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02},
+    /* 0x3d */ {0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03},
+    /* 0x3e */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x3f */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x40 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x41 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x42 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x43 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x44 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x45 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x46 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x47 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x48 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x49 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x4a */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x4b */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x4c */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x4d */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x4e */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x4f */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x50 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x51 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x52 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x53 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x54 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x55 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x56 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x57 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x58 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x59 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x5a */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x5b */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x5c */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x5d */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x5e */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x5f */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x60 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x61 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x62 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x63 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x64 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x65 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x66 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x67 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x68 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x69 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x6a */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x6b */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x6c */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x6d */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x6e */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x6f */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x70 */ {0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02},
+    /* 0x71 */ {0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02},
+    /* 0x72 */ {0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02},
+    /* 0x73 */ {0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02},
+    /* 0x74 */ {0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02},
+    /* 0x75 */ {0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02},
+    /* 0x76 */ {0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02},
+    /* 0x77 */ {0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02},
+    /* 0x78 */ {0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02},
+    /* 0x79 */ {0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02},
+    /* 0x7a */ {0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02},
+    /* 0x7b */ {0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02},
+    /* 0x7c */ {0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02},
+    /* 0x7d */ {0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02},
+    /* 0x7e */ {0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02},
+    /* 0x7f */ {0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02},
+    /* 0x80 */ {0x83, 0x00, 0x00, 0x00, 0x00, 0x83, 0x00, 0x83},
+    /* 0x81 */ {0x84, 0x00, 0x00, 0x00, 0x00, 0x84, 0x00, 0x84},
+    /* 0x82 */ {0x83, 0x00, 0x00, 0x00, 0x00, 0x83, 0x00, 0x83},
+    /* 0x83 */ {0x83, 0x00, 0x00, 0x00, 0x00, 0x83, 0x00, 0x83},
+    /* 0x84 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x85 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x86 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x87 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x88 */ {0x82, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82},
+    /* 0x89 */ {0x82, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82},
+    /* 0x8a */ {0x82, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82},
+    /* 0x8b */ {0x82, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82},
+    /* 0x8c */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x8d */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x8e */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x8f */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x90 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x91 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x92 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x93 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x94 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x95 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x96 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x97 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x98 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x99 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x9a */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x9b */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x9c */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x9d */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x9e */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0x9f */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xa0 */ {0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03},
+    /* 0xa1 */ {0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03},
+    /* 0xa2 */ {0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03},
+    /* 0xa3 */ {0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03},
+    /* 0xa4 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xa5 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xa6 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xa7 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xa8 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xa9 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xaa */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xab */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xac */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xad */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xae */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xaf */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xb0 */ {0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02},
+    /* 0xb1 */ {0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02},
+    /* 0xb2 */ {0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02},
+    /* 0xb3 */ {0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02},
+    /* 0xb4 */ {0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02},
+    /* 0xb5 */ {0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02},
+    /* 0xb6 */ {0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02},
+    /* 0xb7 */ {0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02},
+    /* 0xb8 */ {0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03},
+    /* 0xb9 */ {0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03},
+    /* 0xba */ {0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03},
+    /* 0xbb */ {0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03},
+    /* 0xbc */ {0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03},
+    /* 0xbd */ {0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03},
+    /* 0xbe */ {0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03},
+    /* 0xbf */ {0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03},
+    /* 0xc0 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xc1 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xc2 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xc3 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xc4 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xc5 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xc6 */ {0x83, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xc7 */ {0x84, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xc8 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xc9 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xca */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xcb */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xcc */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xcd */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xce */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xcf */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xd0 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xd1 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xd2 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xd3 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xd4 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xd5 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xd6 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xd7 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xd8 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xd9 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xda */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xdb */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xdc */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xdd */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xde */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xdf */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xe0 */ {0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02},
+    /* 0xe1 */ {0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02},
+    /* 0xe2 */ {0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02},
+    /* 0xe3 */ {0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02},
+    /* 0xe4 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xe5 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xe6 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xe7 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xe8 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xe9 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xea */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xeb */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xec */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xed */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xee */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xef */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xf0 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xf1 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xf2 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xf3 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xf4 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xf5 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xf6 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xf7 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xf8 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xf9 */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xfa */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xfb */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xfc */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xfd */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xfe */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    /* 0xff */ {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+};
+
+const uint64_t opcode_table_version = 0x29190ce64699e9ab;
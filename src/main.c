@@ -1,34 +1,41 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
 #include <assert.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <time.h>
 
-#ifndef true
-#define true 1
-#endif
-#ifndef false
-#define false 0
-#endif
-
-typedef struct ParsedLines {
-    uint32_t machine_bytes;
-    char parsed_text[800];
-    int32_t label_id;
-    int32_t append_jump_bytes;
-    int32_t jump_targets_label_id;
-} ParsedLines;
+#include "disassembler.h"
+#include "simulator.h"
 
-#define PARSED_LINES_MAX 10000
-static ParsedLines * parsed_lines = NULL;
-static uint32_t parsed_lines_size = 0;
-static uint32_t latest_label_id = 0;
+// the default mode's text starts at this many bytes at most, then grows
+#define RECIPIENT_MAX_INITIAL_CAP (1024 * 1024 * 1024)
 
-static void print_binary(
-    const uint8_t input)
+/*
+Returns the size of the file in bytes, or 0 if it doesn't exist or is too big
+for our 32-bit offsets
+*/
+static uint32_t get_file_size(
+    const char * filename)
 {
-    for (int32_t i = 7; i >= 0; i--) {
-        printf("%u", (input >> i) & 1);
+    struct stat file_stat;
+    if (
+        stat(filename, &file_stat) != 0 ||
+        !S_ISREG(file_stat.st_mode) ||
+        file_stat.st_size <= 0 ||
+        file_stat.st_size >= UINT32_MAX)
+    {
+        return 0;
     }
+    return (uint32_t)file_stat.st_size;
 }
 
 static void read_file(
@@ -51,1339 +58,1451 @@ static void read_file(
     }
 }
 
-static void strcat(
-    char * recipient,
-    char * to_cat)
-{
-    uint32_t i = 0;
-    while (recipient[i] != '\0') {
-        i++;
-    }
-    
-    uint32_t j = 0;
-    while (to_cat[j] != '\0') {
-        recipient[i++] = to_cat[j++];
-    }
-    
-    recipient[i] = '\0';
-}
-
-static void strcpy(
-    char * recipient,
-    char * to_copy)
-{
-    recipient[0] = '\0';
-    strcat(recipient, to_copy);
-}
+/*
+An input file we decode straight from the page cache: it's mmap'd read-only
+and the decoder's input points into the mapping, so nothing is copied and we
+don't wait for the whole file to be read before we start. If mmap doesn't
+work for this file we fall back to reading it into 'heap_copy'
+*/
+typedef struct InputFile {
+    const uint8_t * data;
+    uint32_t size;
+    uint8_t * heap_copy;
+} InputFile;
 
-static void strcat_uint(
-    char * recipient,
-    uint16_t to_cat)
+/*
+Returns false if the file couldn't be opened or is empty
+*/
+static uint32_t open_input_file(
+    const char * filename,
+    InputFile * input)
 {
-    uint32_t i = 0;
-    while (recipient[i] != '\0') {
-        i++;
+    input->data = NULL;
+    input->size = get_file_size(filename);
+    input->heap_copy = NULL;
+    if (input->size == 0) {
+        return false;
     }
     
-    uint32_t found_leader = 0;
-    
-    uint32_t mod = 100000000;
-    while (mod > 0) {
-        uint32_t new_digit = to_cat / mod;
-        assert(new_digit < 10);
-        to_cat -= (new_digit * mod);
-        
-        if (new_digit > 0 || found_leader) {
-            found_leader = 1;
-            recipient[i++] = '0' + new_digit;
-        }
-        mod /= 10;
+    int file_descriptor = open(filename, O_RDONLY);
+    if (file_descriptor < 0) {
+        return false;
     }
-    
-    if (!found_leader) {
-        recipient[i++] = '0';
+    void * mapping = mmap(
+        NULL,
+        input->size,
+        PROT_READ,
+        MAP_PRIVATE,
+        file_descriptor,
+        0);
+    // the mapping stays valid after the file is closed
+    close(file_descriptor);
+    
+    if (mapping != MAP_FAILED) {
+        // we (and every chunk's thread) only ever read forwards
+        posix_madvise(mapping, input->size, POSIX_MADV_SEQUENTIAL);
+        posix_madvise(mapping, input->size, POSIX_MADV_WILLNEED);
+        input->data = (const uint8_t *)mapping;
+        return true;
     }
     
-    recipient[i] = '\0';
-}
-
-static void strcat_binary_uint(
-    char * recipient,
-    uint8_t to_cat,
-    uint8_t digits)
-{
-    for (int32_t i = (digits - 1); i >= 0; i--) {
-        strcat_uint(recipient, (to_cat >> i) & 1);
+    input->heap_copy = (uint8_t *)malloc(input->size);
+    if (input->heap_copy == NULL) {
+        return false;
     }
+    uint32_t size_read = 0;
+    read_file(
+        /* char * filename: */
+            (char *)filename,
+        /* uint8_t * recipient: */
+            input->heap_copy,
+        /* uint32_t * recipient_size: */
+            &size_read,
+        /* uint32_t recipient_cap: */
+            input->size);
+    if (size_read == 0) {
+        free(input->heap_copy);
+        input->heap_copy = NULL;
+        return false;
+    }
+    input->size = size_read;
+    input->data = input->heap_copy;
+    return true;
 }
 
-static void strcat_int(
-    char * recipient,
-    int16_t to_cat)
+static void close_input_file(
+    InputFile * input)
 {
-    if (to_cat < 0) {
-        strcat(recipient, "-");
-        to_cat *= -1;
+    if (input->heap_copy != NULL) {
+        free(input->heap_copy);
+    } else if (input->data != NULL) {
+        munmap((void *)input->data, input->size);
     }
-    strcat_uint(recipient, (uint16_t)to_cat);
+    input->data = NULL;
+    input->size = 0;
+    input->heap_copy = NULL;
 }
 
 /*
-From 1+ bytes of machine code, we will get an opcode, a 'W' flag, a 'D' flag,
-a 'mod' field, a 'reg' field and an 'r_m' field.
-
-Which fields you expect to see are always different depending on the opcode,
-but the order of fields always seems to be the same, and the fields are always
-the same number of bits
+The decode cache, for when the same inputs get disassembled over and over
+(like firmware images in CI). Every entry is a decoded file with compact
+records (see decoded_file.h) in the cache directory, named after the input
+it was decoded from and the version of everything that decoded it:
+    <input hash>-<input size>-<opcode_table_version>-v<file version>.dec
+so once the tables (or the file format) change we just never find the old
+entries again, and they can be deleted at any time.
 
-Here is an example of 1 of the MOV opcodes' signatures:
-
-####################################################
-# Byte 1                 ## Byte 2                 #
-#//////////////////      ##////////////////////////#
-#/0  1  2  3  4  5/ 6  7 ##/8  7/ 6  5  4/ 3  2  1/#
-#/#######/########/########/####/########/########/#
- / O P C O D E    / W  D   / MOD/ R E G  /  R_M   / 
- //////////////////        //////////////////////// 
+An entry is written to a temporary file next to it and then renamed, which
+replaces it in 1 step: readers only ever see whole entries, and writers
+racing on the same entry just replace each other's (identical) files
 */
+static void cache_entry_path(
+    const char * cache_dir,
+    const uint8_t * input,
+    const uint32_t input_size,
+    OutputBuffer * path)
+{
+    char name[96];
+    snprintf(
+        name,
+        sizeof(name),
+        "%016llx-%u-%016llx-v%u.dec",
+        (unsigned long long)hash_input(input, input_size),
+        input_size,
+        (unsigned long long)opcode_table_version,
+        DECODED_FILE_VERSION);
+    
+    path->size = 0;
+    path->text[0] = '\0';
+    output_append(path, cache_dir);
+    output_append(path, "/");
+    output_append(path, name);
+}
 
 /*
-The OPCODE is a 3 to 8 bits and represents the 1st part of the
-assembly instruction
+Writes the text of the entry at 'entry_path' to 'recipient'. Returns false
+if there's no entry, or none we can use
 */
-#define MOV_REGMEMTOREG        34 // binary: 100010
-#define MOV_IMMTOREG           11 // binary: 1011
-#define MOV_IMMTOREGMEM        99 // binary: 1100011
+static uint32_t read_cache_entry(
+    const char * entry_path,
+    const uint32_t input_size,
+    OutputBuffer * recipient)
+{
+    InputFile entry;
+    if (!open_input_file(entry_path, &entry)) {
+        return false;
+    }
+    
+    DecodedFileReader reader;
+    uint32_t good =
+        open_decoded_file(&reader, entry.data, entry.size) &&
+        reader.header->input_size == input_size;
+    if (good) {
+        append_decoded_file_text(&reader, recipient, &good);
+    }
+    close_input_file(&entry);
+    return good;
+}
 
 /*
-note: these names are from the intel manual, actually I would reverse them
-('memory to accumulator' actually moves what's in the accumulator to memory)
+Stores what 'decoder' decoded as the entry at 'entry_path'. Failing to is
+only worth a warning, the output doesn't depend on it
 */
-#define MOV_MEMTOACC           80 // binary: 1010000
-#define MOV_ACCTOMEM           81 // binary: 1010001
-
-
-#define ADD_REGMEMTOREG         0 // binary: 000000
-#define ADD_IMMTOREGMEM        32 // binary: 100000
-#define ADD_IMMTOACC            2 // binary: 0000010
-
-#define SUB_REGMEMTOREG        10 // binary: 001010
-#define SUB_IMMTOREGMEM        32 // binary: 100000
-#define SUB_IMMTOACC           22 // binary: 0010110
-
-#define CMP_REGMEMTOREG        14 // binary: 001110
-#define CMP_IMMTOREGMEM        32 // binary: 100000
-#define CMP_IMMTOACC           30 // binary: 0011110
-
-// #define RET_WITHINSEGMENT  195 // 11000011
-
-#define JO                    112 // 01110000 (jump on overflow)
-#define JNO                   113 // 01110001 (jump on not overflow)
-#define JB                    114 // 01110010 (jump below)
-#define JNB                   115 // 01110011 (jump not below)
-#define JE                    116 // 01110100 (jump equal)
-#define JNE_JNZ               117 // 01110101 (jump not equal, jump not zero)
-#define JBE_JNA               118 // 01110110 (below equal, not above)
-#define JA                    119 // 01110111 (jump above)
-#define JS                    120 // 01111000 (jump on sign)
-#define JNS                   121 // 01111001 (?)
-#define JP                    122 // 01111010 (jump on parity)
-#define JNP                   123 // 01111011 (jump on not parity)
-#define JL                    124 // 01111100 (jump less)
-#define JNL                   125 // 01111101 (jump not less)
-#define JLE                   126 // 01111110 (jump less or equal)
-#define JG                    127 // 01111111 (jump greater)
-#define LOOPNZ_LOOPNE         224 // 11100000 (loop while not 0 / not equal)
-#define LOOPZ_LOOPE           225 // 11100001 (loop while 0 / while equal)
-#define LOOP                  226 // 11100010 (loop cx times)
-#define JCXZ                  227 // 11100011 (jump when cx is 0)
-
-typedef struct OpCode {
-    char text[10];
-    uint8_t number;
-    uint8_t size_in_bits;
-    uint8_t has_secondary_3bit_opcode;
-    uint8_t secondary_3bit_opcode;
-    uint32_t secondary_3bit_offset;
-    uint8_t has_d_field;
-    uint8_t hardcoded_d_field; // this opcode always behaves as if d = x
-    uint8_t has_s_field;
-    uint8_t has_w_field;
-    uint8_t has_mod;
-    uint8_t has_reg;
-    char hardcoded_reg_w[3]; // always use this register if w = 1
-    char hardcoded_reg_b[3]; // always use this register if w = 0
-    uint8_t has_rm;
-    uint8_t data_bytes_are_addresses;
-    uint8_t data_bytes_are_immediates;
-    uint8_t data_bytes_are_jump_offsets;
-    uint8_t has_data_byte_1;
-    uint8_t has_data_byte_2_if_w;
-    uint8_t has_data_byte_2_always;
-} OpCode;
-
-#define OPCODE_TABLE_SIZE 200
-static OpCode * opcode_table = NULL;
-static uint32_t opcode_table_size = 0;
+static void write_cache_entry(
+    const char * cache_dir,
+    const char * entry_path,
+    DecoderContext * decoder)
+{
+    // fails harmlessly if it's already there
+    mkdir(cache_dir, 0777);
+    
+    OutputBuffer temp_path;
+    output_init(&temp_path, 256);
+    output_append(&temp_path, entry_path);
+    output_append(&temp_path, ".tmp-XXXXXX");
+    
+    uint32_t written = false;
+    int file_descriptor = mkstemp(temp_path.text);
+    if (file_descriptor >= 0) {
+        // mkstemp() makes it private, other jobs should be able to read it
+        fchmod(file_descriptor, 0644);
+        FILE * temp_file = fdopen(file_descriptor, "wb");
+        if (temp_file == NULL) {
+            close(file_descriptor);
+        } else {
+            // only we read entries, and only from start to end
+            write_decoded_file(
+                decoder,
+                DECODED_RECORDS_COMPACT,
+                temp_file,
+                &written);
+            written = fclose(temp_file) == 0 && written;
+        }
+        if (written) {
+            written = rename(temp_path.text, entry_path) == 0;
+        }
+        if (!written) {
+            unlink(temp_path.text);
+        }
+    }
+    
+    if (!written) {
+        fprintf(
+            stderr,
+            "Warning - couldn't store the decoded input in the cache %s\n",
+            cache_dir);
+    }
+    free(temp_path.text);
+}
 
 /*
-The reg field and r/m (register/memory) field refer to registers on the cpu
-
-We will use 2 tables to transform the 3 bits in 'reg' and 'r_m' into
-some characters of text (like "BP") that represent the register. The string
-buffer only needs 3 characters
-
-- This table is always used to decode the 'reg' field, regardless of the mod
-- This table is also used to decode the 'r/m' if and only if mod = 3
-is indexed by the value from the 'w' bit and then by 'r/m' to yield 3 chars
-                      w  rm 3 chars
-                      |  |  |
+Batch mode: disassemble many files at once, spread over a pool of worker
+threads. Every worker has its own DecoderContext and buffers, they only share
+the read-only tables and the index of the next file to pick up.
 */
-static char reg_table[2][8][3];
+typedef struct BatchJob {
+    char ** input_filenames;
+    uint32_t input_filenames_size;
+    uint32_t input_filenames_cap;
+    const char * output_dir;
+    const char * cache_dir; // NULL if there's no cache
+    
+    pthread_mutex_t mutex; // guards the fields below
+    uint32_t next_file_i;
+    uint32_t failed_files;
+} BatchJob;
+
+static void batch_add_input_file(
+    BatchJob * job,
+    const char * dir,
+    const char * filename)
+{
+    OutputBuffer path;
+    output_init(&path, 256);
+    if (dir != NULL) {
+        output_append(&path, dir);
+        output_append(&path, "/");
+    }
+    output_append(&path, filename);
+    
+    if (job->input_filenames_size >= job->input_filenames_cap) {
+        job->input_filenames_cap = (job->input_filenames_cap * 2) + 16;
+        job->input_filenames = (char **)realloc(
+            job->input_filenames,
+            sizeof(char *) * job->input_filenames_cap);
+        assert(job->input_filenames != NULL);
+    }
+    // the list takes ownership of the path's text
+    job->input_filenames[job->input_filenames_size++] = path.text;
+}
 
 /*
-The modsub3 rm table shows the r/m for mods 'below 3' (so 00, 01, and 10)
-If you are decoding the REG field, you DON'T use this table for any mod
-it's indexed by the values in mod and r/m, and yields 15 chars
-                            mod rm 15 chars
-                             |  |  |
+Adds 'path' to the batch, or every regular file in it if it's a directory.
+Returns false if 'path' doesn't exist
 */
-static char modsub3_rm_table[3][8][15];
-
-static void init_tables(void) {
-    
-    parsed_lines =
-        (ParsedLines *)malloc(sizeof(ParsedLines) * PARSED_LINES_MAX);
-    parsed_lines_size = 0;
-    
-    for (uint32_t i = 0; i < PARSED_LINES_MAX; i++) {
-        parsed_lines[i].parsed_text[0] = '\0';
-        parsed_lines[i].label_id = -1;
-        parsed_lines[i].machine_bytes = 0;
-        parsed_lines[i].append_jump_bytes = INT32_MIN;
-        parsed_lines[i].jump_targets_label_id = -1;
-    }
-    
-    opcode_table = (OpCode *)malloc(OPCODE_TABLE_SIZE * sizeof(OpCode));
-    
-    assert(OPCODE_TABLE_SIZE > 100);
-    for (uint32_t i = 0; i < OPCODE_TABLE_SIZE; i++) {
-        opcode_table[i].text[0] = '\0';
-        opcode_table[i].size_in_bits = 0;
-        opcode_table[i].has_secondary_3bit_opcode = false;
-        opcode_table[i].secondary_3bit_opcode = 0;
-        opcode_table[i].secondary_3bit_offset = 0;
-        opcode_table[i].has_d_field = false;
-        opcode_table[i].hardcoded_d_field = 0;
-        opcode_table[i].has_s_field = false;
-        opcode_table[i].has_w_field = false;
-        opcode_table[i].has_mod = false;
-        opcode_table[i].has_reg = false;
-        opcode_table[i].hardcoded_reg_w[0] = '\0';
-        opcode_table[i].hardcoded_reg_b[0] = '\0';
-        opcode_table[i].has_rm = false;
-        opcode_table[i].has_data_byte_1 = false;
-        opcode_table[i].has_data_byte_2_if_w = false;
-        opcode_table[i].has_data_byte_2_always = false;
-        opcode_table[i].data_bytes_are_addresses = false;
-        opcode_table[i].data_bytes_are_immediates = false;
-        opcode_table[i].data_bytes_are_jump_offsets = false;
-    }
-    
-    strcpy(opcode_table[opcode_table_size].text, "MOV");
-    opcode_table[opcode_table_size].number = MOV_IMMTOREG; // 1011
-    opcode_table[opcode_table_size].size_in_bits = 4;
-    opcode_table[opcode_table_size].has_d_field = false;
-    opcode_table[opcode_table_size].hardcoded_d_field = 1;
-    opcode_table[opcode_table_size].has_w_field = true;
-    opcode_table[opcode_table_size].has_mod = false;
-    opcode_table[opcode_table_size].has_reg = true;
-    opcode_table[opcode_table_size].has_rm = false;
-    opcode_table[opcode_table_size].has_data_byte_1 = true;
-    opcode_table[opcode_table_size].has_data_byte_2_if_w = true;
-    opcode_table_size += 1;
-    
-    strcpy(opcode_table[opcode_table_size].text, "MOV");
-    opcode_table[opcode_table_size].number = MOV_REGMEMTOREG; // 100010
-    opcode_table[opcode_table_size].size_in_bits = 6;
-    opcode_table[opcode_table_size].has_d_field = true;
-    opcode_table[opcode_table_size].has_w_field = true;
-    opcode_table[opcode_table_size].has_mod = true;
-    opcode_table[opcode_table_size].has_reg = true;
-    opcode_table[opcode_table_size].has_rm = true;
-    opcode_table_size += 1;
-    
-    /* 
-    note: these names are from the intel manual, actually I would reverse them
-    ('memory to accumulator' moves what's in the accumulator to memory)
-    
-    mov [2555], ax
-    */
-    strcpy(opcode_table[opcode_table_size].text, "MOV");
-    opcode_table[opcode_table_size].number = MOV_ACCTOMEM; // 1010001
-    strcpy(opcode_table[opcode_table_size].hardcoded_reg_w, "AX");
-    strcpy(opcode_table[opcode_table_size].hardcoded_reg_b, "AL");
-    opcode_table[opcode_table_size].size_in_bits = 7;
-    opcode_table[opcode_table_size].has_w_field = true;
-    opcode_table[opcode_table_size].hardcoded_d_field = 0;
-    opcode_table[opcode_table_size].has_data_byte_1 = true;
-    opcode_table[opcode_table_size].has_data_byte_2_always = true;
-    opcode_table[opcode_table_size].data_bytes_are_addresses = true;
-    opcode_table_size += 1;
-    
-    /* 
-    mov ax, [2555] (yes, intel's opcode name is reversed)
-    */
-    strcpy(opcode_table[opcode_table_size].text, "MOV");
-    opcode_table[opcode_table_size].number = MOV_MEMTOACC; // 1010000
-    strcpy(opcode_table[opcode_table_size].hardcoded_reg_w, "AX");
-    strcpy(opcode_table[opcode_table_size].hardcoded_reg_b, "AL");
-    opcode_table[opcode_table_size].size_in_bits = 7;
-    opcode_table[opcode_table_size].has_w_field = true;
-    opcode_table[opcode_table_size].hardcoded_d_field = 1;
-    opcode_table[opcode_table_size].has_data_byte_1 = true;
-    opcode_table[opcode_table_size].has_data_byte_2_always = true;
-    opcode_table[opcode_table_size].data_bytes_are_addresses = true;
-    opcode_table_size += 1;
-    
-    strcpy(opcode_table[opcode_table_size].text, "MOV");
-    opcode_table[opcode_table_size].number = MOV_IMMTOREGMEM; // 1100011
-    opcode_table[opcode_table_size].size_in_bits = 7;
-    opcode_table[opcode_table_size].has_secondary_3bit_opcode = true;
-    opcode_table[opcode_table_size].secondary_3bit_opcode = 0; // 000
-    opcode_table[opcode_table_size].secondary_3bit_offset = 10;
-    opcode_table[opcode_table_size].has_w_field = true;
-    opcode_table[opcode_table_size].has_d_field = false;
-    // opcode_table[opcode_table_size].hardcoded_d_field = 0;
-    opcode_table[opcode_table_size].has_mod = true;
-    opcode_table[opcode_table_size].has_reg = false;
-    opcode_table[opcode_table_size].has_rm = true;
-    opcode_table[opcode_table_size].has_data_byte_1 = true;
-    opcode_table[opcode_table_size].has_data_byte_2_if_w = true;
-    opcode_table[opcode_table_size].data_bytes_are_immediates = true;
-    opcode_table_size += 1;
-    
-    strcpy(opcode_table[opcode_table_size].text, "ADD");
-    opcode_table[opcode_table_size].number = ADD_REGMEMTOREG; // 000000
-    opcode_table[opcode_table_size].size_in_bits = 6;
-    opcode_table[opcode_table_size].has_d_field = true;
-    opcode_table[opcode_table_size].has_w_field = true;
-    opcode_table[opcode_table_size].has_mod = true;
-    opcode_table[opcode_table_size].has_reg = true;
-    opcode_table[opcode_table_size].has_rm = true;
-    opcode_table_size += 1;
-    
-    strcpy(opcode_table[opcode_table_size].text, "ADD");
-    opcode_table[opcode_table_size].number = ADD_IMMTOREGMEM; // 100000
-    opcode_table[opcode_table_size].size_in_bits = 6;
-    opcode_table[opcode_table_size].has_secondary_3bit_opcode = true;
-    opcode_table[opcode_table_size].secondary_3bit_opcode = 0; // 100
-    opcode_table[opcode_table_size].secondary_3bit_offset = 10;
-    opcode_table[opcode_table_size].has_s_field = true;
-    opcode_table[opcode_table_size].has_w_field = true;
-    // opcode_table[opcode_table_size].hardcoded_d_field = 0;
-    opcode_table[opcode_table_size].has_mod = true;
-    opcode_table[opcode_table_size].has_reg = false;
-    opcode_table[opcode_table_size].has_rm = true;
-    opcode_table[opcode_table_size].has_data_byte_1 = true;
-    opcode_table[opcode_table_size].has_data_byte_2_if_w = true;
-    opcode_table[opcode_table_size].data_bytes_are_immediates = true;
-    opcode_table_size += 1;
-    
-    strcpy(opcode_table[opcode_table_size].text, "SUB");
-    opcode_table[opcode_table_size].number = SUB_REGMEMTOREG; // 001010
-    opcode_table[opcode_table_size].size_in_bits = 6;
-    opcode_table[opcode_table_size].has_d_field = true;
-    opcode_table[opcode_table_size].has_w_field = true;
-    opcode_table[opcode_table_size].has_mod = true;
-    opcode_table[opcode_table_size].has_reg = true;
-    opcode_table[opcode_table_size].has_rm = true;
-    opcode_table_size += 1;
-    
-    strcpy(opcode_table[opcode_table_size].text, "SUB");
-    opcode_table[opcode_table_size].number = SUB_IMMTOREGMEM; // 100000
-    opcode_table[opcode_table_size].size_in_bits = 6;
-    opcode_table[opcode_table_size].has_secondary_3bit_opcode = true;
-    opcode_table[opcode_table_size].secondary_3bit_opcode = 5; // 101
-    opcode_table[opcode_table_size].secondary_3bit_offset = 10;
-    opcode_table[opcode_table_size].has_s_field = true;
-    opcode_table[opcode_table_size].has_w_field = true;
-    opcode_table[opcode_table_size].hardcoded_d_field = 0;
-    opcode_table[opcode_table_size].has_mod = true;
-    opcode_table[opcode_table_size].has_reg = false;
-    opcode_table[opcode_table_size].has_rm = true;
-    opcode_table[opcode_table_size].has_data_byte_1 = true;
-    opcode_table[opcode_table_size].has_data_byte_2_if_w = true;
-    opcode_table[opcode_table_size].data_bytes_are_immediates = true;
-    opcode_table_size += 1;
-    
-    strcpy(opcode_table[opcode_table_size].text, "CMP");
-    opcode_table[opcode_table_size].number = CMP_REGMEMTOREG; // 001110
-    opcode_table[opcode_table_size].size_in_bits = 6;
-    opcode_table[opcode_table_size].has_d_field = true;
-    opcode_table[opcode_table_size].has_w_field = true;
-    opcode_table[opcode_table_size].has_mod = true;
-    opcode_table[opcode_table_size].has_reg = true;
-    opcode_table[opcode_table_size].has_rm = true;
-    opcode_table_size += 1;
-
-    /*
-    cmp si, 2
-    */
-    strcpy(opcode_table[opcode_table_size].text, "CMP");
-    opcode_table[opcode_table_size].number = SUB_IMMTOREGMEM; // 100000
-    opcode_table[opcode_table_size].size_in_bits = 6;
-    opcode_table[opcode_table_size].has_secondary_3bit_opcode = true;
-    opcode_table[opcode_table_size].secondary_3bit_opcode = 7; // 111
-    opcode_table[opcode_table_size].secondary_3bit_offset = 10;
-    opcode_table[opcode_table_size].has_s_field = true;
-    opcode_table[opcode_table_size].has_w_field = true;
-    opcode_table[opcode_table_size].hardcoded_d_field = 0;
-    opcode_table[opcode_table_size].has_mod = true;
-    opcode_table[opcode_table_size].has_reg = false;
-    opcode_table[opcode_table_size].has_rm = true;
-    opcode_table[opcode_table_size].has_data_byte_1 = true;
-    opcode_table[opcode_table_size].has_data_byte_2_if_w = true;
-    opcode_table[opcode_table_size].data_bytes_are_immediates = true;
-    opcode_table_size += 1;
-
-    /*
-    cmp ax, 2
-    */
-    strcpy(opcode_table[opcode_table_size].text, "CMP");
-    opcode_table[opcode_table_size].number = CMP_IMMTOACC; // binary: 0011110
-    opcode_table[opcode_table_size].size_in_bits = 7;
-    strcpy(opcode_table[opcode_table_size].hardcoded_reg_w, "AX");
-    strcpy(opcode_table[opcode_table_size].hardcoded_reg_b, "AL");
-    opcode_table[opcode_table_size].hardcoded_d_field = 1;
-    opcode_table[opcode_table_size].has_w_field = true;
-    opcode_table[opcode_table_size].has_data_byte_1 = true;
-    opcode_table[opcode_table_size].has_data_byte_2_if_w = true;
-    opcode_table[opcode_table_size].data_bytes_are_immediates = true;
-    opcode_table_size += 1;
-    
-    /*
-    add ax, 1000
-    */
-    strcpy(opcode_table[opcode_table_size].text, "ADD");
-    opcode_table[opcode_table_size].number = ADD_IMMTOACC; // 0000010
-    opcode_table[opcode_table_size].size_in_bits = 7;
-    strcpy(opcode_table[opcode_table_size].hardcoded_reg_w, "AX");
-    strcpy(opcode_table[opcode_table_size].hardcoded_reg_b, "AL");
-    opcode_table[opcode_table_size].hardcoded_d_field = 1;
-    opcode_table[opcode_table_size].has_w_field = true;
-    opcode_table[opcode_table_size].has_data_byte_1 = true;
-    opcode_table[opcode_table_size].has_data_byte_2_if_w = true;
-    opcode_table[opcode_table_size].data_bytes_are_immediates = true;
-    opcode_table_size += 1;
-
-    /*
-    sub ax, 1000
-    */
-    strcpy(opcode_table[opcode_table_size].text, "SUB");
-    opcode_table[opcode_table_size].number = SUB_IMMTOACC; // binary: 0010110
-    opcode_table[opcode_table_size].size_in_bits = 7;
-    strcpy(opcode_table[opcode_table_size].hardcoded_reg_w, "AX");
-    strcpy(opcode_table[opcode_table_size].hardcoded_reg_b, "AL");
-    opcode_table[opcode_table_size].hardcoded_d_field = 1;
-    opcode_table[opcode_table_size].has_w_field = true;
-    opcode_table[opcode_table_size].has_data_byte_1 = true;
-    opcode_table[opcode_table_size].has_data_byte_2_if_w = true;
-    opcode_table[opcode_table_size].data_bytes_are_immediates = true;
-    opcode_table_size += 1;
-    
-    /*
-    jump not zero
-    jnz test_label1
-    */
-    strcpy(opcode_table[opcode_table_size].text, "JNZ");
-    opcode_table[opcode_table_size].number = JNE_JNZ; // binary: 01110101
-    opcode_table[opcode_table_size].size_in_bits = 8;
-    opcode_table[opcode_table_size].has_data_byte_1 = true;
-    opcode_table[opcode_table_size].data_bytes_are_jump_offsets = true;
-    opcode_table_size += 1;
+static uint32_t batch_add_input_path(
+    BatchJob * job,
+    const char * path)
+{
+    struct stat path_stat;
+    if (stat(path, &path_stat) != 0) {
+        return false;
+    }
     
-    /*
-    jump equal
-    je label2
-    */
-    strcpy(opcode_table[opcode_table_size].text, "JE");
-    opcode_table[opcode_table_size].number = JE; // binary: 01110100
-    opcode_table[opcode_table_size].size_in_bits = 8;
-    opcode_table[opcode_table_size].has_data_byte_1 = true;
-    opcode_table[opcode_table_size].data_bytes_are_jump_offsets = true;
-    opcode_table_size += 1;
+    if (!S_ISDIR(path_stat.st_mode)) {
+        batch_add_input_file(job, NULL, path);
+        return true;
+    }
     
-    /*
-    jump on overflow
-    jo label2
-    */
-    strcpy(opcode_table[opcode_table_size].text, "JO");
-    opcode_table[opcode_table_size].number = JO;
-    opcode_table[opcode_table_size].size_in_bits = 8;
-    opcode_table[opcode_table_size].has_data_byte_1 = true;
-    opcode_table[opcode_table_size].data_bytes_are_jump_offsets = true;
-    opcode_table_size += 1;
+    DIR * dir = opendir(path);
+    if (dir == NULL) {
+        return false;
+    }
     
-    /*
-    jump on overflow
-    jno label2
-    */
-    strcpy(opcode_table[opcode_table_size].text, "JNO");
-    opcode_table[opcode_table_size].number = JNO;
-    opcode_table[opcode_table_size].size_in_bits = 8;
-    opcode_table[opcode_table_size].has_data_byte_1 = true;
-    opcode_table[opcode_table_size].data_bytes_are_jump_offsets = true;
-    opcode_table_size += 1;
+    OutputBuffer entry_path;
+    output_init(&entry_path, 256);
+    struct dirent * entry;
+    while ((entry = readdir(dir)) != NULL) {
+        entry_path.size = 0;
+        output_append(&entry_path, path);
+        output_append(&entry_path, "/");
+        output_append(&entry_path, entry->d_name);
+        
+        if (
+            stat(entry_path.text, &path_stat) == 0 &&
+            S_ISREG(path_stat.st_mode))
+        {
+            batch_add_input_file(job, path, entry->d_name);
+        }
+    }
+    free(entry_path.text);
+    closedir(dir);
     
-    /*
-    jump below (TODO: understand how is this different from jump less)
-    jb label2
-    */
-    strcpy(opcode_table[opcode_table_size].text, "JB");
-    opcode_table[opcode_table_size].number = JB; // binary: 01110010
-    opcode_table[opcode_table_size].size_in_bits = 8;
-    opcode_table[opcode_table_size].has_data_byte_1 = true;
-    opcode_table[opcode_table_size].data_bytes_are_jump_offsets = true;
-    opcode_table_size += 1;
+    return true;
+}
+
+static void * batch_worker(void * job_ptr) {
+    BatchJob * job = (BatchJob *)job_ptr;
+    
+    DecoderContext decoder;
+    decoder_init(&decoder);
+    OutputBuffer recipient;
+    output_init(&recipient, 65536);
+    OutputBuffer output_path;
+    output_init(&output_path, 256);
+    OutputBuffer entry_path;
+    output_init(&entry_path, 256);
+    
+    while (true) {
+        pthread_mutex_lock(&job->mutex);
+        uint32_t file_i = job->next_file_i++;
+        pthread_mutex_unlock(&job->mutex);
+        
+        if (file_i >= job->input_filenames_size) {
+            break;
+        }
+        char * input_filename = job->input_filenames[file_i];
+        
+        uint32_t success = false;
+        InputFile input;
+        if (open_input_file(input_filename, &input)) {
+            uint32_t cached = false;
+            if (job->cache_dir != NULL) {
+                cache_entry_path(
+                    job->cache_dir,
+                    input.data,
+                    input.size,
+                    &entry_path);
+                cached = read_cache_entry(
+                    entry_path.text,
+                    input.size,
+                    &recipient);
+                success = cached;
+            }
+            
+            if (!cached) {
+                disassemble(
+                    /* DecoderContext * decoder: */
+                        &decoder,
+                    /* const uint8_t * input: */
+                        input.data,
+                    /* const uint32_t input_size: */
+                        input.size,
+                    /* OutputBuffer * recipient: */
+                        &recipient,
+                    /* uint32_t * success: */
+                        &success);
+                if (success && job->cache_dir != NULL) {
+                    write_cache_entry(
+                        job->cache_dir,
+                        entry_path.text,
+                        &decoder);
+                }
+            }
+            close_input_file(&input);
+        }
+        
+        if (success) {
+            output_append(&recipient, "\n");
+            
+            // output_dir/input_name.asm
+            const char * input_name = input_filename;
+            for (uint32_t i = 0; input_filename[i] != '\0'; i++) {
+                if (input_filename[i] == '/') {
+                    input_name = input_filename + i + 1;
+                }
+            }
+            output_path.size = 0;
+            output_append(&output_path, job->output_dir);
+            output_append(&output_path, "/");
+            output_append(&output_path, input_name);
+            output_append(&output_path, ".asm");
+            
+            FILE * output_file = fopen(output_path.text, "wb");
+            if (output_file == NULL) {
+                success = false;
+            } else {
+                fwrite(recipient.text, 1, recipient.size, output_file);
+                fclose(output_file);
+            }
+        }
+        
+        if (!success) {
+            fprintf(
+                stderr,
+                "Error - failed to disassemble %s\n",
+                input_filename);
+            pthread_mutex_lock(&job->mutex);
+            job->failed_files += 1;
+            pthread_mutex_unlock(&job->mutex);
+        }
+    }
     
-    /*
-    jump not below
-    jnb label2
-    */
-    strcpy(opcode_table[opcode_table_size].text, "JNB");
-    opcode_table[opcode_table_size].number = JNB;
-    opcode_table[opcode_table_size].size_in_bits = 8;
-    opcode_table[opcode_table_size].has_data_byte_1 = true;
-    opcode_table[opcode_table_size].data_bytes_are_jump_offsets = true;
-    opcode_table_size += 1;
+    free(entry_path.text);
+    free(output_path.text);
+    free(recipient.text);
+    decoder_free(&decoder);
+    return NULL;
+}
 
-    /*
-    jump if below or equal
-    jbe label2
-    */ 
-    strcpy(opcode_table[opcode_table_size].text, "JBE");
-    opcode_table[opcode_table_size].number = JBE_JNA; // binary: 01110110
-    opcode_table[opcode_table_size].size_in_bits = 8;
-    opcode_table[opcode_table_size].has_data_byte_1 = true;
-    opcode_table[opcode_table_size].data_bytes_are_jump_offsets = true;
-    opcode_table_size += 1;
+/*
+Returns the number of files that failed
+*/
+static uint32_t run_batch(
+    char ** input_paths,
+    uint32_t input_paths_size,
+    const char * output_dir,
+    const char * cache_dir,
+    uint32_t threads_count)
+{
+    BatchJob job;
+    job.input_filenames = NULL;
+    job.input_filenames_size = 0;
+    job.input_filenames_cap = 0;
+    job.output_dir = output_dir;
+    job.cache_dir = cache_dir;
+    job.next_file_i = 0;
+    job.failed_files = 0;
+    pthread_mutex_init(&job.mutex, NULL);
+    
+    for (uint32_t i = 0; i < input_paths_size; i++) {
+        if (!batch_add_input_path(&job, input_paths[i])) {
+            fprintf(stderr, "Error - failed to read %s\n", input_paths[i]);
+            job.failed_files += 1;
+        }
+    }
     
-    /*
-    jump abovej
-    ja label2
-    */
-    strcpy(opcode_table[opcode_table_size].text, "JA");
-    opcode_table[opcode_table_size].number = JA;
-    opcode_table[opcode_table_size].size_in_bits = 8;
-    opcode_table[opcode_table_size].has_data_byte_1 = true;
-    opcode_table[opcode_table_size].data_bytes_are_jump_offsets = true;
-    opcode_table_size += 1;
+    if (threads_count > job.input_filenames_size) {
+        threads_count = job.input_filenames_size;
+    }
     
-    /*
-    jump on sign
-    js label2
-    */
-    strcpy(opcode_table[opcode_table_size].text, "JS");
-    opcode_table[opcode_table_size].number = JS;
-    opcode_table[opcode_table_size].size_in_bits = 8;
-    opcode_table[opcode_table_size].has_data_byte_1 = true;
-    opcode_table[opcode_table_size].data_bytes_are_jump_offsets = true;
-    opcode_table_size += 1;
-
-    /*
-    JNS (jump on not sign)
-    */
-    strcpy(opcode_table[opcode_table_size].text, "JNS");
-    assert(opcode_table[opcode_table_size].text[0] != '\0');
-    assert(!opcode_table[opcode_table_size].has_secondary_3bit_opcode);
-    opcode_table[opcode_table_size].number = JNS;
-    opcode_table[opcode_table_size].size_in_bits = 8;
-    opcode_table[opcode_table_size].has_data_byte_1 = true;
-    opcode_table[opcode_table_size].data_bytes_are_jump_offsets = true;
-    opcode_table_size += 1;
+    pthread_t * threads =
+        (pthread_t *)malloc(sizeof(pthread_t) * (threads_count + 1));
+    uint32_t threads_started = 0;
+    for (uint32_t i = 0; i < threads_count; i++) {
+        if (pthread_create(&threads[i], NULL, batch_worker, &job) != 0) {
+            break;
+        }
+        threads_started += 1;
+    }
     
-    /*
-    jump parity
-    jp label2
-    */
-    strcpy(opcode_table[opcode_table_size].text, "JP");
-    opcode_table[opcode_table_size].number = JP;
-    opcode_table[opcode_table_size].size_in_bits = 8;
-    opcode_table[opcode_table_size].has_data_byte_1 = true;
-    opcode_table[opcode_table_size].data_bytes_are_jump_offsets = true;
-    opcode_table_size += 1;
+    if (threads_started == 0) {
+        // no threads available, do the work on this one
+        batch_worker(&job);
+    }
     
-    /*
-    jump not parity
-    jnp label2
-    */
-    strcpy(opcode_table[opcode_table_size].text, "JNP");
-    opcode_table[opcode_table_size].number = JNP;
-    opcode_table[opcode_table_size].size_in_bits = 8;
-    opcode_table[opcode_table_size].has_data_byte_1 = true;
-    opcode_table[opcode_table_size].data_bytes_are_jump_offsets = true;
-    opcode_table_size += 1;
+    for (uint32_t i = 0; i < threads_started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
     
-    /*
-    jump less
-    jl label2
-    */
-    strcpy(opcode_table[opcode_table_size].text, "JL");
-    opcode_table[opcode_table_size].number = JL; // binary: 01111100
-    opcode_table[opcode_table_size].size_in_bits = 8;
-    opcode_table[opcode_table_size].has_data_byte_1 = true;
-    opcode_table[opcode_table_size].data_bytes_are_jump_offsets = true;
-    opcode_table_size += 1;
+    for (uint32_t i = 0; i < job.input_filenames_size; i++) {
+        free(job.input_filenames[i]);
+    }
+    free(job.input_filenames);
+    pthread_mutex_destroy(&job.mutex);
     
-    /*
-    jump not less
-    jnl label2
-    */
-    strcpy(opcode_table[opcode_table_size].text, "JNL");
-    opcode_table[opcode_table_size].number = JNL;
-    opcode_table[opcode_table_size].size_in_bits = 8;
-    opcode_table[opcode_table_size].has_data_byte_1 = true;
-    opcode_table[opcode_table_size].data_bytes_are_jump_offsets = true;
-    opcode_table_size += 1;
-
-    /*
-    jump less or equal
-    jle label2
-    */
-    strcpy(opcode_table[opcode_table_size].text, "JLE");
-    opcode_table[opcode_table_size].number = JLE; // binary: 01111110
-    opcode_table[opcode_table_size].size_in_bits = 8;
-    opcode_table[opcode_table_size].has_data_byte_1 = true;
-    opcode_table[opcode_table_size].data_bytes_are_jump_offsets = true;
-    opcode_table_size += 1;
-
-    /*
-    jump greater
-    jg label2
-    */
-    strcpy(opcode_table[opcode_table_size].text, "JG");
-    opcode_table[opcode_table_size].number = JG; // binary: 01111111
-    opcode_table[opcode_table_size].size_in_bits = 8;
-    opcode_table[opcode_table_size].has_data_byte_1 = true;
-    opcode_table[opcode_table_size].data_bytes_are_jump_offsets = true;
-    opcode_table_size += 1;
+    return job.failed_files;
+}
 
-    /*
-    loop while 0 (aka equal)
-    */
-    strcpy(opcode_table[opcode_table_size].text, "LOOPZ");
-    opcode_table[opcode_table_size].number = LOOPZ_LOOPE; // binary: 11100001
-    opcode_table[opcode_table_size].size_in_bits = 8;
-    opcode_table[opcode_table_size].has_data_byte_1 = true;
-    opcode_table[opcode_table_size].data_bytes_are_jump_offsets = true;
-    opcode_table_size += 1;
+/*
+Exec mode: run the program in the simulator and print the registers it ends
+with. Returns 0 if it ran to the end (or to max_instructions)
+*/
+static int run_exec(
+    const char * input_filename,
+    const uint64_t max_instructions,
+    const uint32_t profile)
+{
+    InputFile input;
+    if (!open_input_file(input_filename, &input)) {
+        fprintf(stderr, "Error - failed to read input file\n");
+        return 1;
+    }
     
-    /*
-    loop while not 0 (aka not equal)
-    */
-    strcpy(opcode_table[opcode_table_size].text, "LOOPNZ");
-    opcode_table[opcode_table_size].number = LOOPNZ_LOOPNE; // binary: 11100000
-    opcode_table[opcode_table_size].size_in_bits = 8;
-    opcode_table[opcode_table_size].has_data_byte_1 = true;
-    opcode_table[opcode_table_size].data_bytes_are_jump_offsets = true;
-    opcode_table_size += 1;
-
-    /*
-    'loop cx times' - i think that means the value in the cx register is
-    implicitly used, we'll figure it out
-    loop label2
-    */
-    strcpy(opcode_table[opcode_table_size].text, "LOOP");
-    opcode_table[opcode_table_size].number = LOOP; // binary: 11100010
-    opcode_table[opcode_table_size].size_in_bits = 8;
-    opcode_table[opcode_table_size].has_data_byte_1 = true;
-    opcode_table[opcode_table_size].data_bytes_are_jump_offsets = true;
-    opcode_table_size += 1;
-
-    /*
-    JCXZ (jump when cx is 0)
-    */
-    strcpy(opcode_table[opcode_table_size].text, "JCXZ");
-    opcode_table[opcode_table_size].number = JCXZ; // binary: 11100011
-    opcode_table[opcode_table_size].size_in_bits = 8;
-    opcode_table[opcode_table_size].has_data_byte_1 = true;
-    opcode_table[opcode_table_size].data_bytes_are_jump_offsets = true;
-    opcode_table_size += 1;
-    
-    // mod '11' or 3 with its own table
-    strcpy(reg_table[0][0], "AL");
-    strcpy(reg_table[0][1], "CL");
-    strcpy(reg_table[0][2], "DL");
-    strcpy(reg_table[0][3], "BL");
-    strcpy(reg_table[0][4], "AH");
-    strcpy(reg_table[0][5], "CH");
-    strcpy(reg_table[0][6], "DH");
-    strcpy(reg_table[0][7], "BH");
-    
-    strcpy(reg_table[1][0], "AX");
-    strcpy(reg_table[1][1], "CX");
-    strcpy(reg_table[1][2], "DX");
-    strcpy(reg_table[1][3], "BX");
-    strcpy(reg_table[1][4], "SP");
-    strcpy(reg_table[1][5], "BP");
-    strcpy(reg_table[1][6], "SI");
-    strcpy(reg_table[1][7], "DI");
-    
-    // mod '10' or 2
-    strcpy(modsub3_rm_table[2][0], "BX+SI");
-    strcpy(modsub3_rm_table[2][1], "BX+DI");
-    strcpy(modsub3_rm_table[2][2], "BP+SI");
-    strcpy(modsub3_rm_table[2][3], "BP+DI");
-    strcpy(modsub3_rm_table[2][4], "SI");
-    strcpy(modsub3_rm_table[2][5], "DI");
-    strcpy(modsub3_rm_table[2][6], "BP");
-    strcpy(modsub3_rm_table[2][7], "BX");
-    
-    // mod '01' or 1
-    strcpy(modsub3_rm_table[1][0], "BX+SI");
-    strcpy(modsub3_rm_table[1][1], "BX+DI");
-    strcpy(modsub3_rm_table[1][2], "BP+SI");
-    strcpy(modsub3_rm_table[1][3], "BP+DI");
-    strcpy(modsub3_rm_table[1][4], "SI"); // SI + D8
-    strcpy(modsub3_rm_table[1][5], "DI"); // DI + D8
-    strcpy(modsub3_rm_table[1][6], "BP"); // BP + D8
-    strcpy(modsub3_rm_table[1][7], "BX"); // BX + D8
-    
-    // mod '00' or 0
-    strcpy(modsub3_rm_table[0][0], "BX+SI");
-    strcpy(modsub3_rm_table[0][1], "BX+DI");
-    strcpy(modsub3_rm_table[0][2], "BP+SI");
-    strcpy(modsub3_rm_table[0][3], "BP+DI");
-    strcpy(modsub3_rm_table[0][4], "SI");
-    strcpy(modsub3_rm_table[0][5], "DI");
-    strcpy(modsub3_rm_table[0][6], "DIRADDR");
-    strcpy(modsub3_rm_table[0][7], "BX");
+    Simulator simulator;
+    simulator_init(&simulator);
+    simulator.profile = profile;
+    
+    uint32_t success = false;
+    simulator_load(
+        /* Simulator * simulator: */
+            &simulator,
+        /* const uint8_t * program: */
+            input.data,
+        /* const uint32_t program_size: */
+            input.size,
+        /* uint32_t * good: */
+            &success);
+    close_input_file(&input);
+    
+    struct timespec start;
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (success) {
+        simulator_run(
+            /* Simulator * simulator: */
+                &simulator,
+            /* const uint64_t max_instructions: */
+                max_instructions,
+            /* uint32_t * good: */
+                &success);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds =
+        (double)(end.tv_sec - start.tv_sec) +
+        ((double)(end.tv_nsec - start.tv_nsec) / 1000000000.0);
+    
+    OutputBuffer recipient;
+    output_init(&recipient, 1024);
+    output_append(&recipient, "Final registers:\n");
+    append_simulator_state(&simulator, &recipient);
+    if (profile) {
+        append_profile_report(
+            /* Simulator * simulator: */
+                &simulator,
+            /* const uint32_t max_instructions: */
+                20,
+            /* OutputBuffer * recipient: */
+                &recipient);
+    }
+    fwrite(recipient.text, 1, recipient.size, stdout);
+    
+    // stderr, so the registers can be diffed against a known good run
+    fprintf(
+        stderr,
+        "executed %llu instructions in %.3f ms (%.1f million per second)\n",
+        (unsigned long long)simulator.instructions_executed,
+        seconds * 1000.0,
+        seconds > 0.0 ?
+            ((double)simulator.instructions_executed / 1000000.0) / seconds :
+            0.0);
+    fprintf(
+        stderr,
+        "translated %llu basic blocks, flushed the block cache %llu times\n",
+        (unsigned long long)simulator.blocks_translated,
+        (unsigned long long)simulator.block_cache_flushes);
+    
+    free(recipient.text);
+    simulator_free(&simulator);
+    return success ? 0 : 1;
 }
 
-static uint8_t * input = NULL;
-static uint32_t input_size = 0;
-static uint32_t bytes_consumed = 0;
-static uint32_t bits_consumed  = 0;
-
-static uint8_t try_bits_with_offset(
-    const uint32_t count,
-    const uint32_t using_offset)
+/*
+Stats mode: writes the instruction mix of 'input' to 'output_filename' (or
+stdout if it's NULL). Returns 0 if the whole input decoded
+*/
+static int run_stats(
+    InputFile * input,
+    const char * output_filename,
+    const uint32_t threads_count)
 {
-    /*
-    Let's say bits_consumed is 2
-    x x |
-    0 1 2 3 4 5 6 7
-    .. and we want 3 bits
-    0 1[2 3 4]5 6 7
-    
-    then first we << bits_consumed (2)
-    2 3 4 5 6 7 8 0
-    
-    next, >> (8 - count) or (8 - 3) or >> 5
-    0 0 0 0 0 2 3 4
-    
-    next, we bitmask to be safe
-    */
-    uint32_t offset_bytes = using_offset / 8;
-    uint32_t offset_bits = using_offset % 8;
-    
-    uint8_t return_value =
-        (input[bytes_consumed + offset_bytes] <<
-            (bits_consumed + offset_bits));
-    
-    return_value >>= (8 - count);
+    InstructionMix * mix = (InstructionMix *)malloc(sizeof(InstructionMix));
+    assert(mix != NULL);
+    instruction_mix_init(mix);
+    
+    uint32_t success = false;
+    collect_instruction_mix(
+        /* const uint8_t * input: */
+            input->data,
+        /* const uint32_t input_size: */
+            input->size,
+        /* const uint32_t threads_count: */
+            threads_count,
+        /* InstructionMix * mix: */
+            mix,
+        /* uint32_t * good: */
+            &success);
+    close_input_file(input);
+    if (!success) {
+        free(mix);
+        return 1;
+    }
     
-    uint8_t bitmask = (1 << count) - 1;
-    return_value &= bitmask;
+    OutputBuffer report;
+    output_init(&report, 16384);
+    append_instruction_mix(mix, &report);
+    free(mix);
+    
+    FILE * output_file = stdout;
+    if (output_filename != NULL) {
+        output_file = fopen(output_filename, "wb");
+        if (output_file == NULL) {
+            fprintf(
+                stderr,
+                "Error - failed to open output file %s\n",
+                output_filename);
+            free(report.text);
+            return 1;
+        }
+    }
+    fwrite(report.text, 1, report.size, output_file);
+    if (output_file != stdout) {
+        fclose(output_file);
+    }
     
-    return return_value;
+    free(report.text);
+    return 0;
 }
 
-static uint8_t try_bits(
-    const uint32_t count)
+/*
+Opens 'output_filename' for writing, or returns stdout if it's NULL. Returns
+NULL (and says so) if it can't be opened
+*/
+static FILE * open_output_file(
+    const char * output_filename)
 {
-    return try_bits_with_offset(
-        /* const uint32_t count: */
-            count,
-        /* const uint32_t using_offset: */
-            0);
+    if (output_filename == NULL) {
+        return stdout;
+    }
+    FILE * output_file = fopen(output_filename, "wb");
+    if (output_file == NULL) {
+        fprintf(
+            stderr,
+            "Error - failed to open output file %s\n",
+            output_filename);
+    }
+    return output_file;
 }
 
-static uint8_t consume_byte() {
-    assert(bits_consumed == 0);
-    uint8_t return_value = input[bytes_consumed];
-    bytes_consumed += 1;
+/*
+Binary mode: decodes 'input' and writes it to 'output_filename' (or stdout)
+as a decoded file. Returns 0 if the whole input decoded and was written
+*/
+static int run_binary(
+    InputFile * input,
+    const char * output_filename)
+{
+    DecoderContext decoder;
+    decoder_init(&decoder);
+    
+    uint32_t success = false;
+    decode_all_instructions(
+        /* DecoderContext * decoder: */
+            &decoder,
+        /* const uint8_t * input: */
+            input->data,
+        /* const uint32_t input_size: */
+            input->size,
+        /* uint32_t * good: */
+            &success);
+    
+    FILE * output_file = NULL;
+    if (success) {
+        output_file = open_output_file(output_filename);
+        success = output_file != NULL;
+    }
+    if (success) {
+        write_decoded_file(
+            &decoder,
+            DECODED_RECORDS_FULL,
+            output_file,
+            &success);
+        if (output_file != stdout) {
+            success = fclose(output_file) == 0 && success;
+        }
+        if (!success) {
+            fprintf(stderr, "Error - failed to write the decoded file\n");
+        }
+    }
     
-    return return_value;
+    decoder_free(&decoder);
+    close_input_file(input);
+    return success ? 0 : 1;
 }
 
-static uint8_t consume_bits(const uint32_t count) {
-    uint8_t return_value = try_bits(count);
-    
-    bits_consumed += count;
+/*
+The other way around: writes the text of the decoded file in 'input'.
+Returns 0 if it was a decoded file we can read
+*/
+static int run_from_binary(
+    InputFile * input,
+    const char * output_filename)
+{
+    DecodedFileReader reader;
+    if (!open_decoded_file(&reader, input->data, input->size)) {
+        close_input_file(input);
+        return 1;
+    }
     
-    while (bits_consumed >= 8) {
-        bits_consumed -= 8;
-        bytes_consumed += 1;
+    OutputBuffer recipient;
+    output_init(&recipient, input->size + 64);
+    uint32_t success = false;
+    append_decoded_file_text(&reader, &recipient, &success);
+    close_input_file(input);
+    
+    FILE * output_file = NULL;
+    if (success) {
+        output_append(&recipient, "\n");
+        output_file = open_output_file(output_filename);
+        success = output_file != NULL;
+    }
+    if (success) {
+        fwrite(recipient.text, 1, recipient.size, output_file);
+        if (output_file != stdout) {
+            fclose(output_file);
+        }
     }
     
-    return return_value;
+    free(recipient.text);
+    return success ? 0 : 1;
 }
 
-static void disassemble(
-    char * recipient,
-    uint32_t * good)
+static double seconds_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + ((double)now.tv_nsec / 1000000000.0);
+}
+
+static uint32_t hex_digit_value(
+    const char digit,
+    uint8_t * value)
 {
-    bytes_consumed = 0;
-    bits_consumed = 0;
-    parsed_lines_size = 0;
-    
-    while (bytes_consumed < input_size) {
-        if (bits_consumed != 0) {
-            printf(
-                "Error - bits consumed %u (not 0) at new line\n",
-                bits_consumed);
-            *good = false;
-            return;
-        }
-        uint32_t bytes_consumed_at_sol = bytes_consumed;
-        
-        OpCode * opcode = NULL;
-        uint8_t bits_to_try = 1;
-        while (
-            bits_to_try < 8 &&
-            opcode == NULL)
-        {
-            bits_to_try += 1;
-            
-            uint32_t try_opcode = try_bits(bits_to_try);
-            
-            for (
-                uint32_t try_i = 0;
-                try_i < opcode_table_size;
-                try_i++)
+    if (digit >= '0' && digit <= '9') {
+        *value = (uint8_t)(digit - '0');
+    } else if (digit >= 'a' && digit <= 'f') {
+        *value = (uint8_t)(digit - 'a' + 10);
+    } else if (digit >= 'A' && digit <= 'F') {
+        *value = (uint8_t)(digit - 'A' + 10);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/*
+Writes the bytes of a patch like "0x10=90eb02" (an offset, then the new
+bytes in hex) over 'input' and sets 'patch' to the bytes it changed. Returns
+false (and says why) if the patch is broken or doesn't fit in the input
+*/
+static uint32_t apply_patch(
+    const char * patch_text,
+    uint8_t * input,
+    const uint32_t input_size,
+    PatchedRange * patch)
+{
+    char * bytes_text = NULL;
+    unsigned long offset = strtoul(patch_text, &bytes_text, 0);
+    uint32_t good = bytes_text != patch_text && *bytes_text == '=';
+    
+    uint32_t bytes_size = 0;
+    if (good) {
+        bytes_text += 1;
+        while (bytes_text[bytes_size * 2] != '\0') {
+            uint8_t high = 0;
+            uint8_t low = 0;
+            if (
+                !hex_digit_value(bytes_text[bytes_size * 2], &high) ||
+                !hex_digit_value(bytes_text[(bytes_size * 2) + 1], &low))
             {
-                if (
-                    opcode_table[try_i].number == try_opcode &&
-                    opcode_table[try_i].size_in_bits == bits_to_try &&
-                    opcode_table[try_i].text[0] != '\0')
-                {
-                    /*
-                    hit! but this may still be a miss if there's a secondary
-                    opcode
-                    */
-                    if (opcode_table[try_i].has_secondary_3bit_opcode) {
-                        uint8_t secondary_opcode = try_bits_with_offset(
-                            /* const uint32_t count: */
-                                3,
-                            /* const uint32_t using_offset: */
-                                opcode_table[try_i].secondary_3bit_offset);
-                        
-                        if (
-                            secondary_opcode !=
-                                opcode_table[try_i].secondary_3bit_opcode)
-                        {
-                            continue;
-                        }
-                    }
-                    
-                    uint8_t throwaway = consume_bits(bits_to_try);
-                    opcode = &opcode_table[try_i];
-                    assert(opcode->number == throwaway);
-                    break;
-                }
+                good = false;
+                break;
             }
+            bytes_size += 1;
         }
-        
-        if (opcode == NULL) {
-            uint32_t try_opcode = try_bits(bits_to_try);
-            printf(
-                "failed to find opcode: %u - ",
-                try_opcode);
-            print_binary(try_opcode);
-            printf("\nAvailable opcodes were: ");
-            for (uint32_t i = 0; i < opcode_table_size; i++) {
-                if (opcode_table[i].text[0] == '\0') {
-                    printf("*");
-                }
-                printf("%u, ", opcode_table[i].number);
-            }
-            *good = false;
-            assert(0);
-            return;
-        }
-        
-        assert(bits_consumed < 9);
-        if (bits_consumed == 8) {
-            bits_consumed -= 8;
-            bytes_consumed += 1;
+    }
+    if (!good || bytes_size == 0) {
+        fprintf(
+            stderr,
+            "Error - a patch is offset=hex bytes (like 0x10=90eb02), not %s\n",
+            patch_text);
+        return false;
+    }
+    if (offset > input_size || bytes_size > input_size - offset) {
+        fprintf(
+            stderr,
+            "Error - the patch %s goes past the end of the %u byte input\n",
+            patch_text,
+            input_size);
+        return false;
+    }
+    
+    for (uint32_t i = 0; i < bytes_size; i++) {
+        uint8_t high = 0;
+        uint8_t low = 0;
+        hex_digit_value(bytes_text[i * 2], &high);
+        hex_digit_value(bytes_text[(i * 2) + 1], &low);
+        input[offset + i] = (uint8_t)((high << 4) | low);
+    }
+    patch->start = (uint32_t)offset;
+    patch->end = (uint32_t)offset + bytes_size;
+    return true;
+}
+
+/*
+Returns true if 'a' and 'b' are the same text, except that their labels may
+be numbered differently (but consistently: every label of 1 always goes with
+the same label of the other). 'a_labels_size' and 'b_labels_size' are how
+many label numbers each uses
+*/
+static uint32_t texts_match_ignoring_labels(
+    const char * a,
+    const uint32_t a_labels_size,
+    const char * b,
+    const uint32_t b_labels_size)
+{
+    // -1 until we've seen the label
+    int32_t * a_to_b = (int32_t *)malloc(sizeof(int32_t) * (a_labels_size + 1));
+    int32_t * b_to_a = (int32_t *)malloc(sizeof(int32_t) * (b_labels_size + 1));
+    assert(a_to_b != NULL);
+    assert(b_to_a != NULL);
+    for (uint32_t i = 0; i < a_labels_size; i++) {
+        a_to_b[i] = -1;
+    }
+    for (uint32_t i = 0; i < b_labels_size; i++) {
+        b_to_a[i] = -1;
+    }
+    
+    uint32_t match = false;
+    while (*a == *b) {
+        if (*a == '\0') {
+            match = true;
+            break;
         }
-        
-        // the 'd' field generally specifies the 'direction',
-        // to or from register?
-        // 0 means the left hand registry is the destination
-        // 1 means the REG field in the second byte is the destination
-        uint8_t d = opcode->hardcoded_d_field;
         if (
-            opcode->has_d_field)
+            strncmp(a, "label_", 6) != 0 ||
+            strncmp(b, "label_", 6) != 0)
         {
-            d = consume_bits(1);
-        }
-
-        // sign extension flag
-        uint8_t s = UINT8_MAX;
-        if (opcode->has_s_field) {
-            s = consume_bits(1);
+            a++;
+            b++;
+            continue;
         }
         
-        // word or byte operation? 
-        // 0 = instruction operates on byte data
-        // 1 = instruction operates on word data (2 bytes)
-        uint8_t w = UINT8_MAX;
-        if (opcode->has_w_field) {
-            w = consume_bits(1);
+        char * a_end = NULL;
+        char * b_end = NULL;
+        unsigned long a_id = strtoul(a + 6, &a_end, 10);
+        unsigned long b_id = strtoul(b + 6, &b_end, 10);
+        if (a_id >= a_labels_size || b_id >= b_labels_size) {
+            break;
         }
-        
-        // register mode / memory mode with discplacement 
-        uint8_t mod = UINT8_MAX;
-        if (opcode->has_mod) {
-            mod = consume_bits(2);
+        if (a_to_b[a_id] < 0 && b_to_a[b_id] < 0) {
+            a_to_b[a_id] = (int32_t)b_id;
+            b_to_a[b_id] = (int32_t)a_id;
+        } else if (
+            a_to_b[a_id] != (int32_t)b_id ||
+            b_to_a[b_id] != (int32_t)a_id)
+        {
+            break;
         }
+        a = a_end;
+        b = b_end;
+    }
+    
+    free(a_to_b);
+    free(b_to_a);
+    return match;
+}
 
-        uint8_t reg = UINT8_MAX;
-        if (opcode->has_reg) {
-            reg = consume_bits(3);
-        }
+/*
+Patch mode: disassembles 'input', writes the patches over it (each
+"offset=hex bytes"), has redecode_patches() catch up with them and writes the
+text of the patched input. With 'check' it also disassembles the patched
+input from scratch, fails unless both texts match (up to the label numbers),
+and says how long each took on stderr. Returns 0 if everything decoded
+*/
+static int run_patch(
+    InputFile * input,
+    char ** patches_texts,
+    const uint32_t patches_size,
+    const uint32_t check,
+    const char * output_filename)
+{
+    // the input is mapped read-only, we patch a copy
+    uint32_t input_size = input->size;
+    uint8_t * patched = (uint8_t *)malloc(input_size);
+    assert(patched != NULL);
+    memcpy(patched, input->data, input_size);
+    close_input_file(input);
+    
+    DecoderContext decoder;
+    decoder_init(&decoder);
+    uint32_t success = false;
+    decode_all_instructions(
+        /* DecoderContext * decoder: */
+            &decoder,
+        /* const uint8_t * input: */
+            patched,
+        /* const uint32_t input_size: */
+            input_size,
+        /* uint32_t * good: */
+            &success);
+    if (success) {
+        resolve_jump_labels(&decoder);
+    }
+    
+    PatchedRange * patches =
+        (PatchedRange *)malloc(sizeof(PatchedRange) * patches_size);
+    assert(patches != NULL);
+    for (uint32_t i = 0; i < patches_size && success; i++) {
+        success = apply_patch(
+            /* const char * patch_text: */
+                patches_texts[i],
+            /* uint8_t * input: */
+                patched,
+            /* const uint32_t input_size: */
+                input_size,
+            /* PatchedRange * patch: */
+                &patches[i]);
+    }
+    
+    double redecode_start = seconds_now();
+    if (success) {
+        redecode_patches(
+            /* DecoderContext * decoder: */
+                &decoder,
+            /* const PatchedRange * patches: */
+                patches,
+            /* const uint32_t patches_size: */
+                patches_size,
+            /* uint32_t * good: */
+                &success);
+    }
+    double redecode_seconds = seconds_now() - redecode_start;
+    
+    OutputBuffer recipient;
+    output_init(&recipient, 65536);
+    if (success) {
+        append_decoded_text(&decoder, &recipient);
+    }
+    
+    if (success && check) {
+        DecoderContext fresh;
+        decoder_init(&fresh);
+        OutputBuffer fresh_text;
+        output_init(&fresh_text, 65536);
         
-        uint8_t secondary_3bit_opcode = UINT8_MAX;
-        if (opcode->has_secondary_3bit_opcode) {
-            secondary_3bit_opcode = consume_bits(3);
+        double fresh_start = seconds_now();
+        decode_all_instructions(
+            /* DecoderContext * decoder: */
+                &fresh,
+            /* const uint8_t * input: */
+                patched,
+            /* const uint32_t input_size: */
+                input_size,
+            /* uint32_t * good: */
+                &success);
+        if (success) {
+            resolve_jump_labels(&fresh);
         }
+        double fresh_seconds = seconds_now() - fresh_start;
         
-        uint8_t r_m = UINT8_MAX;
-        if (opcode->has_rm) {
-            r_m = consume_bits(3);
+        if (success) {
+            append_decoded_text(&fresh, &fresh_text);
+            success = texts_match_ignoring_labels(
+                /* const char * a: */
+                    recipient.text,
+                /* const uint32_t a_labels_size: */
+                    decoder.latest_label_id,
+                /* const char * b: */
+                    fresh_text.text,
+                /* const uint32_t b_labels_size: */
+                    fresh.latest_label_id);
+            if (!success) {
+                fprintf(
+                    stderr,
+                    "Error - the patched text doesn't match a fresh "
+                    "disassembly of the patched input\n");
+            }
         }
+        fprintf(
+            stderr,
+            "redecoded %u patches in %.3f ms, decoding the whole input "
+            "again (with its labels) took %.3f ms\n",
+            patches_size,
+            redecode_seconds * 1000.0,
+            fresh_seconds * 1000.0);
         
-        uint8_t num_displacement_bytes = 0;
-        char secondary_reg[10];
-        secondary_reg[0] = '\0';
-        uint8_t treat_secondary_reg_as_address = 0;
-        
-        if (opcode->has_mod) {
-            switch (mod) {
-                case 0: {
-                    // memory mode, no displacement follows
-                    if (r_m == 6) {
-                        // 'except when r/m = 110, then 16 bit discplacement
-                        // follows'
-                        num_displacement_bytes = 2;
-                        
-                        // strcpy(secondary_reg, reg_table[w][reg]);
-                    } else {
-                        // TODO: not verified.. sure this is called '
-                        // memory mode' but so are the others and they dont
-                        // represent addresses. I can't find a reference to
-                        // this being an address anywhere in the manual
-                        treat_secondary_reg_as_address = 1;
-                        strcpy(secondary_reg, modsub3_rm_table[mod][r_m]);
-                    }
+        free(fresh_text.text);
+        decoder_free(&fresh);
+    }
+    
+    FILE * output_file = NULL;
+    if (success) {
+        output_append(&recipient, "\n");
+        output_file = open_output_file(output_filename);
+        success = output_file != NULL;
+    }
+    if (success) {
+        fwrite(recipient.text, 1, recipient.size, output_file);
+        if (output_file != stdout) {
+            fclose(output_file);
+        }
+    }
+    
+    free(recipient.text);
+    free(patches);
+    decoder_free(&decoder);
+    free(patched);
+    return success ? 0 : 1;
+}
 
-                    assert(num_displacement_bytes < 3);
-                    break;
-                }
-                case 1: {
-                    // memory mode, 8-bit displacement follows
-                    treat_secondary_reg_as_address = true;
-                    num_displacement_bytes = 1;
-                    
-                    strcpy(secondary_reg, modsub3_rm_table[mod][r_m]);
-                    assert(secondary_reg[0] != '\0');
-                    assert(num_displacement_bytes < 3);
-                    break;
-                }
-                case 2: {
-                    // memory mode, 16-bit displacement follows
-                    treat_secondary_reg_as_address = true;
-                    num_displacement_bytes = 2;
-                    
-                    strcpy(secondary_reg, modsub3_rm_table[mod][r_m]);
-                    assert(num_displacement_bytes < 3);
-                    break;
-                }
-                case 3: {
-                    // register mode (no displacement)
-                    assert(num_displacement_bytes == 0);
-                    
-                    strcpy(secondary_reg, reg_table[w][r_m]);
-                    break;
-                }
-                default:
-                    printf("Error - mod was %u, expected < 4\n", mod);
-                    assert(0);
-            }
+/*
+Writes what the instrumentation recorded to stderr, or as JSON to
+'json_filename' if it's not NULL. Only a build with -DINSTRUMENT records
+anything, without it we only write a report when 1 was asked for
+*/
+static uint32_t write_instrumentation_report(
+    const char * json_filename)
+{
+#ifndef INSTRUMENT
+    if (json_filename == NULL) {
+        return true;
+    }
+#endif
+    
+    OutputBuffer report;
+    output_init(&report, 4096);
+    append_instrumentation_report(&report, json_filename != NULL);
+    
+    uint32_t written = true;
+    if (json_filename == NULL) {
+        fwrite(report.text, 1, report.size, stderr);
+    } else {
+        FILE * json_file = fopen(json_filename, "wb");
+        written =
+            json_file != NULL &&
+            fwrite(report.text, 1, report.size, json_file) == report.size;
+        if (json_file != NULL) {
+            fclose(json_file);
         }
-        assert(num_displacement_bytes < 3);
-        
-        uint8_t displacement_byte_1 = 0;
-        uint8_t displacement_byte_2 = 0;
-        int16_t displacement_bytes_combined = 0;
-        
-        if (num_displacement_bytes > 0) {
-            displacement_byte_1 = consume_byte();
-            
-            if (num_displacement_bytes > 1) {
-                displacement_byte_2 = consume_byte();
-                
-                displacement_bytes_combined =
-                    (displacement_byte_2 << 8) |
-                    (displacement_byte_1 & UINT8_MAX);
-            } else {
-                displacement_bytes_combined =
-                    (int16_t)((int8_t)displacement_byte_1);
-            }
+        if (!written) {
+            fprintf(
+                stderr,
+                "Error - failed to write the instrumentation report to %s\n",
+                json_filename);
         }
-        
-        int8_t data_bytes = 0;
-        uint8_t data_byte_1 = 0;
-        uint8_t data_byte_2 = 0;
-        int16_t data_bytes_combined = 0;
-        if (opcode->has_data_byte_1)
+    }
+    
+    free(report.text);
+    return written;
+}
+
+/*
+usage:
+disassembler [--stream] [--threads count] [input_file [output_file]]
+disassembler --cycles [input_file [output_file]]
+disassembler --recursive [--entry offset]... [input_file [output_file]]
+disassembler --stats [--threads count] [input_file [output_file]]
+disassembler --binary [input_file [output_file]]
+disassembler --from-binary decoded_file [output_file]
+disassembler --patch offset=hex [--patch offset=hex]... [--check]
+    [input_file [output_file]]
+disassembler --batch [--threads count] output_dir input_file_or_dir...
+disassembler --exec [--max-instructions count] [--profile] [input_file]
+The first 3 also take [--instrument-json file].
+The first 1 (without --stream) and --batch also take [--cache dir].
+
+By default we read "build/machinecode" and write to stdout. The whole input
+is mmap'd (not copied) and decoded in parallel on 1 thread per core (or
+--threads). Inputs go up to just under 4GB, but the whole text (about 9
+bytes per byte of input) is built in memory before it's written.
+--stream decodes the input in bounded memory instead and writes the output
+as it goes, use it when the text won't fit in memory.
+--batch disassembles every input file (or every file in an input directory)
+to output_dir/input_name.asm, using 1 thread per core unless --threads says
+otherwise.
+--cycles adds the estimated 8086 clocks of every instruction to the output
+as comments, with the total of every basic block and of the whole program.
+--recursive only disassembles the code the jumps can reach from the entry
+points (offset 0 unless there are --entry options, which also take 0x...
+offsets) and writes the rest as db data.
+--stats writes the instruction mix instead of the text: how often every
+opcode form, addressing mode and range of jump offsets comes up, and the
+share of byte and word operations. It's as fast as decoding gets, on 1 thread
+per core (or --threads).
+--binary writes a decoded file (see decoded_file.h) instead of the text, for
+tools that want the instructions without parsing them, and --from-binary
+turns a decoded file back into the text.
+--patch disassembles the input, then writes the bytes after each = (in hex)
+over it at the offset before the = (which also takes 0x... offsets), and
+only decodes again around the patches to write the text of the patched
+input. With --check it also disassembles the patched input from scratch,
+fails unless the texts match (apart from label numbers) and reports both
+times on stderr. The input file isn't changed.
+--exec runs the input in the 8086 simulator instead of disassembling it, and
+prints the registers it ends with. With --profile it also lists the
+instructions that took the most estimated clocks.
+--cache keeps what we decoded in a directory, named after a hash of the
+input, so a later run on the same bytes skips decoding and writes the text
+straight from there. Any number of runs can share the directory.
+
+A build with -DINSTRUMENT writes how long each phase of the disassembly took
+and how often the hot paths ran to stderr when it's done, or as JSON to the
+file after --instrument-json. It decodes on 1 thread unless there's a
+--threads, because the counters aren't thread safe.
+*/
+int main(int argc, char * argv[]) {
+    
+    char * input_filename = "build/machinecode";
+    char * output_filename = NULL;
+    uint32_t streaming = false;
+    uint32_t batch = false;
+    uint32_t exec = false;
+    uint32_t cycles = false;
+    uint32_t recursive = false;
+    uint32_t stats = false;
+    uint32_t binary = false;
+    uint32_t from_binary = false;
+    uint32_t profile = false;
+    uint32_t check = false;
+    uint64_t max_instructions = 0;
+    char * instrument_json_filename = NULL;
+    char * cache_dir = NULL;
+#ifdef INSTRUMENT
+    int32_t threads_count = 1;
+#else
+    int32_t threads_count = (int32_t)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    
+    char ** filenames = (char **)malloc(sizeof(char *) * argc);
+    uint32_t filenames_found = 0;
+    uint32_t * entry_points = (uint32_t *)malloc(sizeof(uint32_t) * argc);
+    uint32_t entry_points_size = 0;
+    char ** patches_texts = (char **)malloc(sizeof(char *) * argc);
+    uint32_t patches_size = 0;
+    for (int32_t arg_i = 1; arg_i < argc; arg_i++) {
+        if (are_equal_strings(argv[arg_i], "--stream")) {
+            streaming = true;
+        } else if (are_equal_strings(argv[arg_i], "--batch")) {
+            batch = true;
+        } else if (are_equal_strings(argv[arg_i], "--exec")) {
+            exec = true;
+        } else if (are_equal_strings(argv[arg_i], "--cycles")) {
+            cycles = true;
+        } else if (are_equal_strings(argv[arg_i], "--profile")) {
+            profile = true;
+        } else if (are_equal_strings(argv[arg_i], "--recursive")) {
+            recursive = true;
+        } else if (are_equal_strings(argv[arg_i], "--stats")) {
+            stats = true;
+        } else if (are_equal_strings(argv[arg_i], "--binary")) {
+            binary = true;
+        } else if (are_equal_strings(argv[arg_i], "--from-binary")) {
+            from_binary = true;
+        } else if (are_equal_strings(argv[arg_i], "--check")) {
+            check = true;
+        } else if (
+            are_equal_strings(argv[arg_i], "--patch") &&
+            arg_i + 1 < argc)
         {
-            data_bytes = 1;
-            data_byte_1 = (consume_byte() & UINT8_MAX);
-            
-            if (data_byte_1 < 0) {
-                data_bytes_combined = INT16_MAX;
-            }
-            
-            if (
-                opcode->has_data_byte_2_always ||
-                (
-                opcode->has_data_byte_2_if_w &&
-                    w &&
-                    (!opcode->has_s_field || !s)))
-            {
-                data_bytes = 2;
-                data_byte_2 = consume_byte();
-                
-                data_bytes_combined =
-                    (data_byte_2 << 8) |
-                    (data_byte_1 & UINT8_MAX);
-            } else {
-                assert(data_bytes == 1);
-                data_bytes_combined = (int16_t)(int8_t)data_byte_1;
-            }
-        }
-        
-        char first_part[20];
-        first_part[0] = '\0';
-        char second_part[20];
-        second_part[0] = '\0';
-        
-        strcat(parsed_lines[parsed_lines_size].parsed_text, opcode->text);
-        strcat(parsed_lines[parsed_lines_size].parsed_text, " ");
-        
-        assert(reg <= UINT8_MAX);
-        if (opcode->data_bytes_are_jump_offsets) {
-        
-        } else if (opcode->hardcoded_reg_w[0] != '\0') {
-            assert(opcode->hardcoded_reg_b[0] != '\0');
-            if (w) {
-                strcat(first_part, opcode->hardcoded_reg_w);
-            } else {
-                strcat(first_part, opcode->hardcoded_reg_b);
-            }
-        } else if (opcode->data_bytes_are_immediates) {
-            if (
-                w &&
-                opcode->has_s_field)
-            {
-                strcat(first_part, "word ");
-            } else {
-                strcat(first_part, "byte ");
-            }
-            strcat_int(first_part, data_bytes_combined);
+            arg_i += 1;
+            patches_texts[patches_size++] = argv[arg_i];
+        } else if (
+            are_equal_strings(argv[arg_i], "--entry") &&
+            arg_i + 1 < argc)
+        {
+            arg_i += 1;
+            entry_points[entry_points_size++] =
+                (uint32_t)strtoul(argv[arg_i], NULL, 0);
+        } else if (
+            are_equal_strings(argv[arg_i], "--max-instructions") &&
+            arg_i + 1 < argc)
+        {
+            arg_i += 1;
+            max_instructions = strtoull(argv[arg_i], NULL, 10);
+        } else if (
+            are_equal_strings(argv[arg_i], "--instrument-json") &&
+            arg_i + 1 < argc)
+        {
+            arg_i += 1;
+            instrument_json_filename = argv[arg_i];
+        } else if (
+            are_equal_strings(argv[arg_i], "--cache") &&
+            arg_i + 1 < argc)
+        {
+            arg_i += 1;
+            cache_dir = argv[arg_i];
+        } else if (
+            are_equal_strings(argv[arg_i], "--threads") &&
+            arg_i + 1 < argc)
+        {
+            arg_i += 1;
+            threads_count = atoi(argv[arg_i]);
         } else {
-            strcat(first_part, reg_table[w][reg]);
+            filenames[filenames_found++] = argv[arg_i];
         }
-        assert(
-            opcode->data_bytes_are_jump_offsets ||
-            (first_part[0] != '\0'));
-        
-        if (secondary_reg[0] != '\0') {
-            
-            if (treat_secondary_reg_as_address) {
-                strcat(second_part, "[");
-            }
-            strcat(second_part, secondary_reg);
-            if (
-                num_displacement_bytes > 0 &&
-                displacement_bytes_combined != 0)
-            {
-                if (displacement_bytes_combined >= 0) {
-                    strcat(second_part, "+");
-                }
-                strcat_int(second_part, displacement_bytes_combined);
-            }
-            if (treat_secondary_reg_as_address) {
-                strcat(second_part, "]");
-            }
-        } else if (data_bytes > 0) {
-            if (opcode->data_bytes_are_addresses) {
-            strcat(second_part, "[");
-            }
-            strcat_int(second_part, data_bytes_combined);
-            if (opcode->data_bytes_are_addresses) {
-            strcat(second_part, "]");
-            }
-        } else if (num_displacement_bytes > 0) {
-            strcat(second_part, "[");
-            strcat_int(second_part, displacement_bytes_combined);
-            strcat(second_part, "]");
-        } else {
-            printf("error - no data or secondary register\n");
-            *good = false;
-            return;
+    }
+    
+    if (
+        (batch && (filenames_found < 2 || streaming || exec)) ||
+        (exec && (filenames_found > 1 || streaming)) ||
+        (cycles && (batch || exec || streaming || recursive)) ||
+        (recursive && (batch || exec || streaming)) ||
+        (stats && (batch || exec || streaming || cycles || recursive)) ||
+        (
+            (binary || from_binary) &&
+            (batch || exec || streaming || cycles || recursive || stats)) ||
+        (binary && from_binary) ||
+        (
+            patches_size > 0 &&
+            (batch || exec || streaming || cycles || recursive || stats ||
+                binary || from_binary || cache_dir != NULL)) ||
+        (check && patches_size == 0) ||
+        (
+            cache_dir != NULL &&
+            (exec || streaming || cycles || recursive || stats || binary ||
+                from_binary)) ||
+        (from_binary && filenames_found == 0) ||
+        (entry_points_size > 0 && !recursive) ||
+        (profile && !exec) ||
+        (
+            instrument_json_filename != NULL &&
+            (batch || exec || stats || binary || from_binary)) ||
+        (!batch && filenames_found > 2))
+    {
+        fprintf(
+            stderr,
+            "usage:\n"
+            "%s [--stream] [--threads count] [input_file [output_file]]\n"
+            "%s --cycles [input_file [output_file]]\n"
+            "%s --recursive [--entry offset]... "
+                "[input_file [output_file]]\n"
+            "%s --stats [--threads count] [input_file [output_file]]\n"
+            "%s --binary [input_file [output_file]]\n"
+            "%s --from-binary decoded_file [output_file]\n"
+            "%s --patch offset=hex [--patch offset=hex]... [--check] "
+                "[input_file [output_file]]\n"
+            "%s --batch [--threads count] output_dir input_file_or_dir...\n"
+            "%s --exec [--max-instructions count] [--profile] "
+                "[input_file]\n"
+            "The first 3 also take [--instrument-json file].\n"
+            "The first 1 (without --stream) and --batch also take "
+                "[--cache dir].\n",
+            argv[0],
+            argv[0],
+            argv[0],
+            argv[0],
+            argv[0],
+            argv[0],
+            argv[0],
+            argv[0],
+            argv[0]);
+        free(filenames);
+        free(entry_points);
+        free(patches_texts);
+        return 1;
+    }
+    if (!batch && filenames_found > 0) {
+        input_filename = filenames[0];
+    }
+    if (!batch && filenames_found > 1) {
+        output_filename = filenames[1];
+    }
+    if (threads_count < 1) {
+        threads_count = 1;
+    }
+    
+    if (batch) {
+        uint32_t failed_files = run_batch(
+            /* char ** input_paths: */
+                filenames + 1,
+            /* uint32_t input_paths_size: */
+                filenames_found - 1,
+            /* const char * output_dir: */
+                filenames[0],
+            /* const char * cache_dir: */
+                cache_dir,
+            /* uint32_t threads_count: */
+                (uint32_t)threads_count);
+        free(filenames);
+        free(entry_points);
+        free(patches_texts);
+        return failed_files > 0 ? 1 : 0;
+    }
+    free(filenames);
+    if (entry_points_size == 0) {
+        entry_points[entry_points_size++] = 0;
+    }
+    
+    if (exec) {
+        free(entry_points);
+        free(patches_texts);
+        return run_exec(input_filename, max_instructions, profile);
+    }
+    
+    if (streaming) {
+        free(entry_points);
+        free(patches_texts);
+        FILE * input_file = fopen(input_filename, "rb");
+        if (input_file == NULL) {
+            fprintf(
+                stderr,
+                "Error - failed to open input file %s\n",
+                input_filename);
+            return 1;
         }
-        
-        if (opcode->data_bytes_are_jump_offsets) {
-            parsed_lines[parsed_lines_size].append_jump_bytes =
-                (int32_t)data_bytes_combined;
-        } else {
-            assert(first_part[0] != '\0');
-            assert(second_part[0] != '\0');
-            if (d) {
-                strcat(
-                    parsed_lines[parsed_lines_size].parsed_text,
-                    first_part);
-                strcat(parsed_lines[parsed_lines_size].parsed_text, ", ");
-                strcat(
-                    parsed_lines[parsed_lines_size].parsed_text,
-                    second_part);
-            } else {
-                strcat(
-                    parsed_lines[parsed_lines_size].parsed_text,
-                    second_part);
-                strcat(
-                    parsed_lines[parsed_lines_size].parsed_text,
-                    ",");
-                strcat(
-                    parsed_lines[parsed_lines_size].parsed_text,
-                    first_part);
+        FILE * output_file = stdout;
+        if (output_filename != NULL) {
+            output_file = fopen(output_filename, "wb");
+            if (output_file == NULL) {
+                fprintf(
+                    stderr,
+                    "Error - failed to open output file %s\n",
+                    output_filename);
+                fclose(input_file);
+                return 1;
             }
         }
         
-        #if 0
-        strcat(parsed_lines[parsed_lines_size].parsed_text, " ; opcode: ");
-        strcat_binary_uint(
-            parsed_lines[parsed_lines_size].parsed_text,
-            opcode->number,
-            opcode->size_in_bits);
-        if (opcode->has_secondary_3bit_opcode) {
-            strcat(parsed_lines[parsed_lines_size].parsed_text, ", opc_ext: ");
-            strcat_binary_uint(
-                parsed_lines[parsed_lines_size].parsed_text,
-                secondary_3bit_opcode, 3);
-        }
-        if (opcode->has_s_field) {
-            strcat(parsed_lines[parsed_lines_size].parsed_text, ", s: ");
-            strcat_binary_uint(
-                parsed_lines[parsed_lines_size].parsed_text,
-                s,
-                1);
-        }
-        if (opcode->has_w_field) {
-            strcat(parsed_lines[parsed_lines_size].parsed_text, ", w: ");
-            strcat_binary_uint(
-                parsed_lines[parsed_lines_size].parsed_text,
-                w,
-                1);
-        }
-        if (opcode->has_d_field) {
-            strcat(parsed_lines[parsed_lines_size].parsed_text, ", d: ");
-            strcat_binary_uint(
-                parsed_lines[parsed_lines_size].parsed_text,
-                d,
-                1);
-        }
-        if (opcode->has_mod) {
-            strcat(parsed_lines[parsed_lines_size].parsed_text, ", mod: ");
-            strcat_binary_uint(
-                parsed_lines[parsed_lines_size].parsed_text,
-                mod,
-                2);
-        }
-        if (opcode->has_reg) {
-            strcat(parsed_lines[parsed_lines_size].parsed_text, ", reg: ");
-            strcat_binary_uint(
-                parsed_lines[parsed_lines_size].parsed_text,
-                reg,
-                3);
+        uint32_t success = 0;
+        disassemble_stream(input_file, output_file, &success);
+        fclose(input_file);
+        
+        if (success) {
+            fprintf(output_file, "\n");
         }
-        if (opcode->has_rm) {
-            strcat(parsed_lines[parsed_lines_size].parsed_text, ", rm: ");
-            strcat_binary_uint(
-                parsed_lines[parsed_lines_size].parsed_text,
-                r_m,
-                3);
+        if (output_file != stdout) {
+            fclose(output_file);
         }
-        if (num_displacement_bytes > 0) {
-            strcat(parsed_lines[parsed_lines_size].parsed_text, ", disp_1: ");
-            strcat_binary_uint(
-                parsed_lines[parsed_lines_size].parsed_text,
-                displacement_byte_1,
-                8);
-            if (num_displacement_bytes > 1) {
-                strcat(
-                    parsed_lines[parsed_lines_size].parsed_text,
-                    ",
-                    disp_2: ");
-                strcat_binary_uint(
-                    parsed_lines[parsed_lines_size].parsed_text,
-                    displacement_byte_2,
-                    8);
-            }
-            strcat(
-                parsed_lines[parsed_lines_size].parsed_text,
-                ",
-                combined: ");
-            strcat_binary_uint(
-                parsed_lines[parsed_lines_size].parsed_text,
-                displacement_bytes_combined >> 8,
-                8);
-            strcat(
-                parsed_lines[parsed_lines_size].parsed_text,
-                " ");
-            strcat_binary_uint(
-                parsed_lines[parsed_lines_size].parsed_text,
-                displacement_bytes_combined & UINT8_MAX,
-                8);
+        if (!write_instrumentation_report(instrument_json_filename)) {
+            return 1;
         }
-        if (data_bytes > 0) {
-            strcat(
-                parsed_lines[parsed_lines_size].parsed_text,
-                ",
-                data_byte_1: ");
-            strcat_int(
-                parsed_lines[parsed_lines_size].parsed_text,
-                data_byte_1);
-            if (data_bytes > 1) {
-                strcat(
-                    parsed_lines[parsed_lines_size].parsed_text,
-                    ",
-                    data_byte_2: ");
-                strcat_int(
-                    parsed_lines[parsed_lines_size].parsed_text,
-                    data_byte_2);
-            }
-        }
-        #endif
-        
-        parsed_lines[parsed_lines_size].machine_bytes =
-            bytes_consumed - bytes_consumed_at_sol;
-        parsed_lines_size += 1;
+        return success ? 0 : 1;
     }
     
-    *good = true;
+    InputFile input;
+    if (!open_input_file(input_filename, &input)) {
+        fprintf(stderr, "Error - failed to read input file\n");
+        free(entry_points);
+        free(patches_texts);
+        return 1;
+    }
     
-    // copy our parsed output to 'recipient'
-    // in this step we have to do some extra work to add labels
-    recipient[0] = '\0';
-    strcpy(recipient, "bits 16\n");
+    if (stats) {
+        free(entry_points);
+        free(patches_texts);
+        return run_stats(&input, output_filename, (uint32_t)threads_count);
+    }
+    if (binary) {
+        free(entry_points);
+        free(patches_texts);
+        return run_binary(&input, output_filename);
+    }
+    if (from_binary) {
+        free(entry_points);
+        free(patches_texts);
+        return run_from_binary(&input, output_filename);
+    }
+    if (patches_size > 0) {
+        free(entry_points);
+        int exit_code = run_patch(
+            /* InputFile * input: */
+                &input,
+            /* char ** patches_texts: */
+                patches_texts,
+            /* const uint32_t patches_size: */
+                patches_size,
+            /* const uint32_t check: */
+                check,
+            /* const char * output_filename: */
+                output_filename);
+        free(patches_texts);
+        return exit_code;
+    }
     
     /*
-    We want to iterate through the parsed lines looking for jumps, and cache
-    the exact parsed line that they need to jump to
+    this grows as needed, start with a few characters per byte of input (in
+    64 bits, that's more than 4GB for a big input) but not more than
+    RECIPIENT_MAX_INITIAL_CAP up front
     */
-    for (uint32_t i = 0; i < parsed_lines_size; i++) {
-        if (parsed_lines[i].append_jump_bytes != INT32_MIN) {
-            int32_t bytes_left = parsed_lines[i].append_jump_bytes;
-            int32_t direction = 1;
-            if (bytes_left < 0) {
-                direction = -1;
-                bytes_left *= -1;
-            }
-            
-            uint32_t target_line = i;
-            while (bytes_left > 0) {
-                assert(parsed_lines[target_line].machine_bytes <= bytes_left);
-                bytes_left -= parsed_lines[target_line].machine_bytes;
-                target_line += direction;
-            }
-            target_line += 1;
-                        
-            if (parsed_lines[target_line].label_id < 0) {
-                parsed_lines[target_line].label_id = latest_label_id++;
-            }
-            assert(parsed_lines[target_line].label_id >= 0);
-            parsed_lines[i].jump_targets_label_id =
-                parsed_lines[target_line].label_id;
-        }
+    uint64_t initial_cap = ((uint64_t)input.size * 8) + 64;
+    if (initial_cap > RECIPIENT_MAX_INITIAL_CAP) {
+        initial_cap = RECIPIENT_MAX_INITIAL_CAP;
     }
-    
-    for (uint32_t i = 0; i < parsed_lines_size; i++) {
-        if (parsed_lines[i].label_id >= 0) {
-            strcat(recipient, "label_");
-            strcat_int(recipient, parsed_lines[i].label_id);
-            strcat(recipient, ":\n");
-        }
-        strcat(recipient, parsed_lines[i].parsed_text);
-        if (parsed_lines[i].jump_targets_label_id >= 0) {
-            strcat(recipient, "label_");
-            strcat_int(recipient, parsed_lines[i].jump_targets_label_id);
-        }
-        strcat(recipient, "\n");
+    OutputBuffer recipient;
+    output_init(&recipient, (size_t)initial_cap);
+    
+    DecoderContext decoder;
+    decoder_init(&decoder);
+    
+    // on a hit, we don't decode anything
+    OutputBuffer entry_path;
+    output_init(&entry_path, 256);
+    uint32_t cached = false;
+    if (cache_dir != NULL) {
+        cache_entry_path(cache_dir, input.data, input.size, &entry_path);
+        cached = read_cache_entry(entry_path.text, input.size, &recipient);
     }
-}
-
-int main() {
-    
-    init_tables();
     
-    #define MACHINE_CODE_CAP 10000 
-    uint8_t * machine_code = (uint8_t *)malloc(MACHINE_CODE_CAP);
-    machine_code[0] = '\0';
-    uint32_t machine_code_size = 0;
-    
-    read_file(
-        /* char * filename: */
-            "build/machinecode",
-        /* uint8_t * recipient: */
-            machine_code,
-        /* uint32_t * recipient_size: */
-            &machine_code_size,
-        /* uint32_t recipient_cap: */
-            MACHINE_CODE_CAP);
-    
-    if (machine_code_size == 0) {
-        printf("failed to read input file\n");
-        return 1;
+    uint32_t success = 0;
+    if (cached) {
+        success = true;
+    } else if (recursive) {
+        disassemble_recursive(
+            /* DecoderContext * decoder: */
+                &decoder,
+            /* const uint8_t * input: */
+                input.data,
+            /* const uint32_t input_size: */
+                input.size,
+            /* const uint32_t * entry_points: */
+                entry_points,
+            /* const uint32_t entry_points_size: */
+                entry_points_size,
+            /* OutputBuffer * recipient: */
+                &recipient,
+            /* uint32_t * success: */
+                &success);
+    } else if (cycles) {
+        // block totals follow the lines in order, so this 1 isn't parallel
+        disassemble_with_clocks(
+            /* DecoderContext * decoder: */
+                &decoder,
+            /* const uint8_t * input: */
+                input.data,
+            /* const uint32_t input_size: */
+                input.size,
+            /* OutputBuffer * recipient: */
+                &recipient,
+            /* uint32_t * success: */
+                &success);
+    } else {
+        disassemble_parallel(
+            /* DecoderContext * decoder: */
+                &decoder,
+            /* const uint8_t * input: */
+                input.data,
+            /* const uint32_t input_size: */
+                input.size,
+            /* const uint32_t threads_count: */
+                (uint32_t)threads_count,
+            /* OutputBuffer * recipient: */
+                &recipient,
+            /* uint32_t * success: */
+                &success);
     }
     
-    bytes_consumed = 0;
-    bits_consumed = 0;
-    
-    char * recipient = (char *)malloc(2000000);
-    recipient[0] = '\0';
-    input = machine_code;
-    input_size = machine_code_size;
+    // the decoder said what's wrong with the input already
+    if (!success) {
+        fprintf(stderr, "Error - failed to disassemble %s\n", input_filename);
+    }
     
-    uint32_t success = 0;
-    disassemble(
-        /* char * recipient: */
-            recipient,
-        /* uint32_t * success: */
-            &success);
+    FILE * output_file = NULL;
+    if (success) {
+        output_append(&recipient, "\n");
+        output_file = open_output_file(output_filename);
+        success = output_file != NULL;
+    }
+    if (success) {
+        fwrite(recipient.text, 1, recipient.size, output_file);
+        if (output_file != stdout) {
+            fclose(output_file);
+        }
+        
+        if (cache_dir != NULL && !cached) {
+            write_cache_entry(cache_dir, entry_path.text, &decoder);
+        }
+    }
     
-    if (!success) {
-        printf("unknown error\n");
+    free(entry_path.text);
+    decoder_free(&decoder);
+    free(recipient.text);
+    free(entry_points);
+    free(patches_texts);
+    close_input_file(&input);
+    if (!write_instrumentation_report(instrument_json_filename)) {
         return 1;
     }
-    
-    strcat(recipient, "\n");
-    printf("%s", recipient);
-    return 0;
+    return success ? 0 : 1;
 }
 
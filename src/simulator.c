@@ -0,0 +1,1149 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "simulator.h"
+
+#define CODE_SEGMENT_SIZE 65536
+
+/*
+The block cache pools. A block is cut after MAX_BLOCK_INSTRUCTIONS, and
+takes 1 more entry than its instructions for the extra one at the end. When
+a pool can't fit another block we flush the whole cache
+*/
+#define MAX_BLOCK_INSTRUCTIONS 64
+#define BLOCKS_CAP 16384
+#define BLOCK_INSTRUCTIONS_CAP (BLOCKS_CAP * 8)
+
+/*
+Every handler an ExecutableInstruction can have. The MOV/ADD/SUB/CMP ones are
+specialized by operand form (destination_source) and by w, in this exact
+order, so translate_instruction() can compute the handler from the 3 of them.
+REG_MEM means 'register <- memory' and so on.
+*/
+#define FOR_EACH_ALU_HANDLER(X) \
+    X(MOV, REG_REG, 0) X(MOV, REG_REG, 1) \
+    X(MOV, REG_MEM, 0) X(MOV, REG_MEM, 1) \
+    X(MOV, MEM_REG, 0) X(MOV, MEM_REG, 1) \
+    X(MOV, REG_IMM, 0) X(MOV, REG_IMM, 1) \
+    X(MOV, MEM_IMM, 0) X(MOV, MEM_IMM, 1) \
+    X(ADD, REG_REG, 0) X(ADD, REG_REG, 1) \
+    X(ADD, REG_MEM, 0) X(ADD, REG_MEM, 1) \
+    X(ADD, MEM_REG, 0) X(ADD, MEM_REG, 1) \
+    X(ADD, REG_IMM, 0) X(ADD, REG_IMM, 1) \
+    X(ADD, MEM_IMM, 0) X(ADD, MEM_IMM, 1) \
+    X(SUB, REG_REG, 0) X(SUB, REG_REG, 1) \
+    X(SUB, REG_MEM, 0) X(SUB, REG_MEM, 1) \
+    X(SUB, MEM_REG, 0) X(SUB, MEM_REG, 1) \
+    X(SUB, REG_IMM, 0) X(SUB, REG_IMM, 1) \
+    X(SUB, MEM_IMM, 0) X(SUB, MEM_IMM, 1) \
+    X(CMP, REG_REG, 0) X(CMP, REG_REG, 1) \
+    X(CMP, REG_MEM, 0) X(CMP, REG_MEM, 1) \
+    X(CMP, MEM_REG, 0) X(CMP, MEM_REG, 1) \
+    X(CMP, REG_IMM, 0) X(CMP, REG_IMM, 1) \
+    X(CMP, MEM_IMM, 0) X(CMP, MEM_IMM, 1)
+
+// the conditional jumps, in opcode order (JO is 0x70, JG is 0x7F)
+#define FOR_EACH_JUMP_HANDLER(X) \
+    X(JO) X(JNO) X(JB) X(JNB) X(JE) X(JNE_JNZ) X(JBE_JNA) X(JA) \
+    X(JS) X(JNS) X(JP) X(JNP) X(JL) X(JNL) X(JLE) X(JG)
+
+typedef enum Handler {
+    HANDLER_END_BLOCK = 0, // the block ended without a jump, go to the next
+    #define ALU_HANDLER_ENUM(operation, form, w) \
+        HANDLER_##operation##_##form##_##w,
+    FOR_EACH_ALU_HANDLER(ALU_HANDLER_ENUM)
+    #undef ALU_HANDLER_ENUM
+    #define JUMP_HANDLER_ENUM(condition) HANDLER_##condition,
+    FOR_EACH_JUMP_HANDLER(JUMP_HANDLER_ENUM)
+    #undef JUMP_HANDLER_ENUM
+    // every handler from here on is a jump, and ends its block
+    HANDLER_LOOP,
+    HANDLER_LOOPZ,
+    HANDLER_LOOPNZ,
+    HANDLER_JCXZ,
+    HANDLERS_COUNT
+} Handler;
+
+void simulator_init(Simulator * simulator) {
+    for (uint32_t i = 0; i < 9; i++) {
+        simulator->registers[i] = 0;
+    }
+    for (uint32_t i = 0; i < 4; i++) {
+        simulator->segment_registers[i] = 0;
+    }
+    simulator->ip = 0;
+    simulator->flags = 0;
+
+    simulator->memory = (uint8_t *)calloc(SIMULATOR_MEMORY_SIZE, 1);
+    assert(simulator->memory != NULL);
+    simulator->blocks = (BasicBlock *)calloc(BLOCKS_CAP, sizeof(BasicBlock));
+    simulator->block_instructions = (ExecutableInstruction *)calloc(
+        BLOCK_INSTRUCTIONS_CAP,
+        sizeof(ExecutableInstruction));
+    simulator->block_at_ip = (BasicBlock **)calloc(
+        CODE_SEGMENT_SIZE,
+        sizeof(BasicBlock *));
+    simulator->is_translated = (uint8_t *)calloc(CODE_SEGMENT_SIZE, 1);
+    simulator->is_jump_target = (uint8_t *)calloc(CODE_SEGMENT_SIZE, 1);
+    simulator->clocks_at_ip =
+        (uint64_t *)calloc(CODE_SEGMENT_SIZE, sizeof(uint64_t));
+    simulator->runs_at_ip =
+        (uint64_t *)calloc(CODE_SEGMENT_SIZE, sizeof(uint64_t));
+    assert(simulator->blocks != NULL);
+    assert(simulator->block_instructions != NULL);
+    assert(simulator->block_at_ip != NULL);
+    assert(simulator->is_translated != NULL);
+    assert(simulator->is_jump_target != NULL);
+    assert(simulator->clocks_at_ip != NULL);
+    assert(simulator->runs_at_ip != NULL);
+    simulator->blocks_size = 0;
+    simulator->block_instructions_size = 0;
+    simulator->code_was_written = false;
+
+    decoder_init(&simulator->decoder);
+    // we report bad instructions ourselves, with the IP they were at
+    simulator->decoder.speculative = true;
+
+    /*
+    The mnemonic tells us what to do, except for the jumps where the opcode
+    number is easier (and they are all 1 full byte)
+    */
+    for (uint32_t op_i = 0; op_i < OPCODE_TABLE_SIZE; op_i++) {
+        simulator->operations[op_i] = OPERATION_UNSUPPORTED;
+        if (op_i >= opcode_table_size || opcode_table[op_i].text[0] == '\0') {
+            continue;
+        }
+
+        const OpCode * opcode = &opcode_table[op_i];
+        if (are_equal_strings(opcode->text, "MOV")) {
+            simulator->operations[op_i] = OPERATION_MOV;
+        } else if (are_equal_strings(opcode->text, "ADD")) {
+            simulator->operations[op_i] = OPERATION_ADD;
+        } else if (are_equal_strings(opcode->text, "SUB")) {
+            simulator->operations[op_i] = OPERATION_SUB;
+        } else if (are_equal_strings(opcode->text, "CMP")) {
+            simulator->operations[op_i] = OPERATION_CMP;
+        } else if (opcode->size_in_bits == 8 && opcode->number == LOOP) {
+            simulator->operations[op_i] = OPERATION_LOOP;
+        } else if (
+            opcode->size_in_bits == 8 &&
+            opcode->number == LOOPZ_LOOPE)
+        {
+            simulator->operations[op_i] = OPERATION_LOOPZ;
+        } else if (
+            opcode->size_in_bits == 8 &&
+            opcode->number == LOOPNZ_LOOPNE)
+        {
+            simulator->operations[op_i] = OPERATION_LOOPNZ;
+        } else if (opcode->size_in_bits == 8 && opcode->number == JCXZ) {
+            simulator->operations[op_i] = OPERATION_JCXZ;
+        } else if (
+            opcode->size_in_bits == 8 &&
+            opcode->number >= JO &&
+            opcode->number <= JG)
+        {
+            simulator->operations[op_i] = OPERATION_JUMP_IF;
+        }
+    }
+
+    simulator->program_end = 0;
+    simulator->instructions_executed = 0;
+    simulator->blocks_translated = 0;
+    simulator->block_cache_flushes = 0;
+    simulator->profile = false;
+}
+
+void simulator_free(Simulator * simulator) {
+    free(simulator->memory);
+    free(simulator->blocks);
+    free(simulator->block_instructions);
+    free(simulator->block_at_ip);
+    free(simulator->is_translated);
+    free(simulator->is_jump_target);
+    free(simulator->clocks_at_ip);
+    free(simulator->runs_at_ip);
+    decoder_free(&simulator->decoder);
+    simulator->memory = NULL;
+    simulator->blocks = NULL;
+    simulator->block_instructions = NULL;
+    simulator->block_at_ip = NULL;
+    simulator->is_translated = NULL;
+    simulator->is_jump_target = NULL;
+    simulator->clocks_at_ip = NULL;
+    simulator->runs_at_ip = NULL;
+}
+
+/*
+Forgets every block. Only the entries the blocks set are cleared, so this is
+cheap when there are few blocks
+*/
+static void flush_blocks(Simulator * simulator) {
+    for (uint32_t i = 0; i < simulator->blocks_size; i++) {
+        BasicBlock * block = &simulator->blocks[i];
+        simulator->block_at_ip[block->start_ip] = NULL;
+        for (uint32_t ip = block->start_ip; ip < block->end_ip; ip++) {
+            simulator->is_translated[ip] = false;
+        }
+    }
+    simulator->blocks_size = 0;
+    simulator->block_instructions_size = 0;
+    simulator->block_cache_flushes += 1;
+}
+
+/*
+The labels a linear sweep of the program finds, like the disassembler's jump
+labels: every jump target starts a block. The sweep stops at the first thing
+we can't decode, targets we only find while running get marked then
+*/
+static void mark_jump_targets(Simulator * simulator) {
+    for (uint32_t ip = 0; ip < CODE_SEGMENT_SIZE; ip++) {
+        simulator->is_jump_target[ip] = false;
+    }
+
+    uint32_t ip = 0;
+    while (ip < simulator->program_end) {
+        DecodedInstruction instruction;
+        uint32_t decoded = true;
+        decode_instruction_at(&simulator->decoder, ip, &instruction, &decoded);
+        if (!decoded) {
+            break;
+        }
+        ip += instruction.machine_bytes;
+        if (instruction.second_operand == OPERAND_JUMP_OFFSET) {
+            uint16_t target = (uint16_t)(ip + (uint16_t)instruction.data);
+            simulator->is_jump_target[target] = true;
+        }
+    }
+}
+
+void simulator_load(
+    Simulator * simulator,
+    const uint8_t * program,
+    const uint32_t program_size,
+    uint32_t * good)
+{
+    if (program_size == 0 || program_size > CODE_SEGMENT_SIZE) {
+        fprintf(
+            stderr,
+            "Error - a program must be 1 to %u bytes, this one is %u\n",
+            CODE_SEGMENT_SIZE,
+            program_size);
+        *good = false;
+        return;
+    }
+
+    for (uint32_t i = 0; i < 9; i++) {
+        simulator->registers[i] = 0;
+    }
+    for (uint32_t i = 0; i < 4; i++) {
+        simulator->segment_registers[i] = 0;
+    }
+    simulator->ip = 0;
+    simulator->flags = 0;
+
+    for (uint32_t i = 0; i < SIMULATOR_MEMORY_SIZE; i++) {
+        simulator->memory[i] = 0;
+    }
+    for (uint32_t i = 0; i < program_size; i++) {
+        simulator->memory[i] = program[i];
+    }
+
+    // CS is 0, so the code segment is the first 64K of memory
+    simulator->decoder.input = simulator->memory;
+    simulator->decoder.input_size = CODE_SEGMENT_SIZE;
+
+    for (uint32_t ip = 0; ip < CODE_SEGMENT_SIZE; ip++) {
+        simulator->clocks_at_ip[ip] = 0;
+        simulator->runs_at_ip[ip] = 0;
+    }
+
+    simulator->program_end = program_size;
+    flush_blocks(simulator);
+    mark_jump_targets(simulator);
+    simulator->code_was_written = false;
+
+    simulator->instructions_executed = 0;
+    simulator->blocks_translated = 0;
+    simulator->block_cache_flushes = 0;
+    *good = true;
+}
+
+static uint32_t physical_address(
+    const uint16_t segment,
+    const uint16_t offset)
+{
+    return (((uint32_t)segment << 4) + offset) & (SIMULATOR_MEMORY_SIZE - 1);
+}
+
+/*
+A write to memory might change code we already translated. If any block was
+translated from 'address' we flush them all, and tell the handler doing the
+write so it leaves its block (which might be the 1 that changed)
+*/
+static void invalidate_blocks_at(
+    Simulator * simulator,
+    const uint32_t address)
+{
+    uint32_t code_start =
+        physical_address(simulator->segment_registers[SEGMENT_CS], 0);
+    uint32_t ip = (address - code_start) & (SIMULATOR_MEMORY_SIZE - 1);
+    if (ip < CODE_SEGMENT_SIZE && simulator->is_translated[ip]) {
+        flush_blocks(simulator);
+        simulator->code_was_written = true;
+    }
+}
+
+static uint16_t read_memory(
+    Simulator * simulator,
+    const uint32_t address,
+    const uint8_t w)
+{
+    uint16_t value = simulator->memory[address];
+    if (w) {
+        value |= (uint16_t)(
+            simulator->memory[(address + 1) & (SIMULATOR_MEMORY_SIZE - 1)] <<
+                8);
+    }
+    return value;
+}
+
+static void write_memory(
+    Simulator * simulator,
+    const uint32_t address,
+    const uint8_t w,
+    const uint16_t value)
+{
+    simulator->memory[address] = (uint8_t)value;
+    invalidate_blocks_at(simulator, address);
+    if (w) {
+        uint32_t high_address = (address + 1) & (SIMULATOR_MEMORY_SIZE - 1);
+        simulator->memory[high_address] = (uint8_t)(value >> 8);
+        invalidate_blocks_at(simulator, high_address);
+    }
+}
+
+/*
+Lazy flags: ADD, SUB and CMP don't compute any flags, they only remember what
+they computed. Most of the time the next arithmetic instruction overwrites it
+before anything looked at the flags, so we only work out the flags a jump
+actually asks for (and all of them when simulator_run() returns).
+'result' is the full result before it's cut down to the operand size, so we
+can still see the carry / borrow
+*/
+typedef enum LazyFlagsFrom {
+    LAZY_FLAGS_NONE = 0, // the flags word is up to date
+    LAZY_FLAGS_FROM_ADD,
+    LAZY_FLAGS_FROM_SUB, // also CMP
+} LazyFlagsFrom;
+
+typedef struct LazyFlags {
+    uint32_t left;
+    uint32_t right;
+    uint32_t result;
+    uint8_t w;
+    uint8_t from; // LazyFlagsFrom
+} LazyFlags;
+
+/*
+Returns whether 'flag' (1 of the FLAG_ bits) is set. It's inlined with a
+constant 'flag', so only that 1 flag gets computed
+*/
+static inline uint32_t lazy_flag(
+    const LazyFlags * lazy,
+    const uint16_t flags,
+    const uint16_t flag)
+{
+    if (lazy->from == LAZY_FLAGS_NONE) {
+        return (flags & flag) != 0;
+    }
+
+    uint32_t mask = lazy->w ? 0xFFFF : 0xFF;
+    uint32_t sign_bit = lazy->w ? 0x8000 : 0x80;
+    uint32_t result = lazy->result;
+
+    switch (flag) {
+        case FLAG_CARRY:
+            return (result & (mask + 1)) != 0;
+        case FLAG_PARITY: {
+            // parity only looks at the low 8 bits, set if an even number are 1
+            uint8_t low_byte = (uint8_t)result;
+            low_byte ^= low_byte >> 4;
+            low_byte ^= low_byte >> 2;
+            low_byte ^= low_byte >> 1;
+            return !(low_byte & 1);
+        }
+        case FLAG_AUXILIARY:
+            return ((lazy->left ^ lazy->right ^ result) & 0x10) != 0;
+        case FLAG_ZERO:
+            return (result & mask) == 0;
+        case FLAG_SIGN:
+            return (result & sign_bit) != 0;
+        case FLAG_OVERFLOW: {
+            /*
+            For an add, both inputs had the same sign and the result has the
+            other one. For a subtract, the inputs had different signs and the
+            result's sign isn't the left one's
+            */
+            uint32_t overflow_bits = lazy->from == LAZY_FLAGS_FROM_SUB ?
+                ((lazy->left ^ lazy->right) & (lazy->left ^ result)) :
+                ((lazy->left ^ result) & (lazy->right ^ result));
+            return (overflow_bits & sign_bit) != 0;
+        }
+        default:
+            assert(0);
+            return false;
+    }
+}
+
+static uint16_t materialize_flags(
+    const LazyFlags * lazy,
+    const uint16_t flags)
+{
+    if (lazy->from == LAZY_FLAGS_NONE) {
+        return flags;
+    }
+
+    static const uint16_t arithmetic_flags[6] = {
+        FLAG_CARRY, FLAG_PARITY, FLAG_AUXILIARY,
+        FLAG_ZERO, FLAG_SIGN, FLAG_OVERFLOW};
+    uint16_t materialized = 0;
+    for (uint32_t i = 0; i < 6; i++) {
+        if (lazy_flag(lazy, flags, arithmetic_flags[i])) {
+            materialized |= arithmetic_flags[i];
+        }
+    }
+    return materialized;
+}
+
+/*
+Registers are numbered like in reg_table: with w = 1 they're the 8 word
+registers, with w = 0 the first 4 are AL, CL, DL, BL (the low bytes of AX,
+CX, DX, BX) and the last 4 AH, CH, DH, BH (their high bytes). We store a byte
+register as the word it's in plus a shift
+*/
+static void translate_register(
+    const uint8_t reg,
+    const uint8_t w,
+    uint8_t * index,
+    uint8_t * shift)
+{
+    if (w) {
+        *index = reg;
+        *shift = 0;
+    } else {
+        *index = reg & 3;
+        *shift = (uint8_t)((reg >> 2) * 8);
+    }
+}
+
+/*
+Memory operands are always [base_1 + base_2 + displacement], mod and r_m
+pick the registers like in modsub3_rm_table. Anything based on BP is in the
+stack segment
+*/
+static void translate_memory_operand(
+    const DecodedInstruction * instruction,
+    const uint8_t operand_kind,
+    ExecutableInstruction * executable)
+{
+    static const uint8_t bases[8][2] = {
+        {REGISTER_BX, REGISTER_SI},
+        {REGISTER_BX, REGISTER_DI},
+        {REGISTER_BP, REGISTER_SI},
+        {REGISTER_BP, REGISTER_DI},
+        {REGISTER_SI, REGISTER_ZERO},
+        {REGISTER_DI, REGISTER_ZERO},
+        {REGISTER_BP, REGISTER_ZERO},
+        {REGISTER_BX, REGISTER_ZERO}};
+
+    executable->displacement = (uint16_t)instruction->displacement;
+    executable->segment = SEGMENT_DS;
+
+    if (operand_kind == OPERAND_DIRECT_ADDRESS) {
+        executable->base_1 = REGISTER_ZERO;
+        executable->base_2 = REGISTER_ZERO;
+        return;
+    }
+
+    executable->base_1 = bases[instruction->r_m][0];
+    executable->base_2 = bases[instruction->r_m][1];
+    if (executable->base_1 == REGISTER_BP) {
+        executable->segment = SEGMENT_SS;
+    }
+}
+
+/*
+Decodes the instruction at CS:ip and works out which handler executes it,
+and everything that handler needs. Only prints why it failed if
+'report_errors' is set
+*/
+static void translate_instruction(
+    Simulator * simulator,
+    const uint16_t ip,
+    const uint32_t report_errors,
+    ExecutableInstruction * executable,
+    uint32_t * good)
+{
+    DecodedInstruction instruction;
+    decode_instruction_at(&simulator->decoder, ip, &instruction, good);
+    if (!*good) {
+        if (report_errors) {
+            fprintf(
+                stderr,
+                "Error - no instruction we know at ip %u\n",
+                ip);
+        }
+        return;
+    }
+
+    executable->length = instruction.machine_bytes;
+    executable->opcode_i = instruction.opcode_i;
+    executable->immediate = (uint16_t)instruction.data;
+
+    ClockEstimate clocks;
+    estimate_clocks(&instruction, &clocks);
+    executable->clocks = (uint8_t)clocks.clocks;
+    executable->extra_clocks_if_taken =
+        (uint8_t)(clocks.clocks_if_taken - clocks.clocks);
+
+    const OpCode * opcode = &opcode_table[instruction.opcode_i];
+    uint8_t operation = simulator->operations[instruction.opcode_i];
+    switch (operation) {
+        case OPERATION_JUMP_IF:
+            executable->handler =
+                (uint8_t)(HANDLER_JO + (opcode->number - JO));
+            return;
+        case OPERATION_LOOP:
+            executable->handler = HANDLER_LOOP;
+            return;
+        case OPERATION_LOOPZ:
+            executable->handler = HANDLER_LOOPZ;
+            return;
+        case OPERATION_LOOPNZ:
+            executable->handler = HANDLER_LOOPNZ;
+            return;
+        case OPERATION_JCXZ:
+            executable->handler = HANDLER_JCXZ;
+            return;
+        case OPERATION_MOV:
+        case OPERATION_ADD:
+        case OPERATION_SUB:
+        case OPERATION_CMP:
+            break;
+        default:
+            if (report_errors) {
+                fprintf(
+                    stderr,
+                    "Error - can't execute %s (at ip %u)\n",
+                    opcode->text,
+                    ip);
+            }
+            *good = false;
+            return;
+    }
+
+    // the same rule as the text: d says whether the first operand is written
+    uint8_t destination_kind = instruction.d ?
+        instruction.first_operand :
+        instruction.second_operand;
+    uint8_t source_kind = instruction.d ?
+        instruction.second_operand :
+        instruction.first_operand;
+    uint8_t w = instruction.w;
+
+    executable->immediate &= w ? 0xFFFF : 0xFF;
+
+    // the first operand is always the 'reg' register or an immediate
+    uint8_t first_index = 0;
+    uint8_t first_shift = 0;
+    uint8_t second_index = 0;
+    uint8_t second_shift = 0;
+    translate_register(instruction.reg, w, &first_index, &first_shift);
+    translate_register(instruction.r_m, w, &second_index, &second_shift);
+    if (instruction.d) {
+        executable->destination = first_index;
+        executable->destination_shift = first_shift;
+        executable->source = second_index;
+        executable->source_shift = second_shift;
+    } else {
+        executable->destination = second_index;
+        executable->destination_shift = second_shift;
+        executable->source = first_index;
+        executable->source_shift = first_shift;
+    }
+
+    uint8_t destination_is_memory =
+        destination_kind == OPERAND_MEMORY ||
+        destination_kind == OPERAND_DIRECT_ADDRESS;
+    uint8_t source_is_memory =
+        source_kind == OPERAND_MEMORY ||
+        source_kind == OPERAND_DIRECT_ADDRESS;
+    if (destination_is_memory) {
+        translate_memory_operand(&instruction, destination_kind, executable);
+    } else if (source_is_memory) {
+        translate_memory_operand(&instruction, source_kind, executable);
+    }
+
+    // the order of the forms in FOR_EACH_ALU_HANDLER
+    uint8_t form = 0;
+    if (destination_kind == OPERAND_REGISTER) {
+        if (source_kind == OPERAND_REGISTER) {
+            form = 0; // REG_REG
+        } else if (source_is_memory) {
+            form = 1; // REG_MEM
+        } else {
+            assert(source_kind == OPERAND_IMMEDIATE);
+            form = 3; // REG_IMM
+        }
+    } else {
+        assert(destination_is_memory);
+        if (source_kind == OPERAND_REGISTER) {
+            form = 2; // MEM_REG
+        } else {
+            assert(source_kind == OPERAND_IMMEDIATE);
+            form = 4; // MEM_IMM
+        }
+    }
+
+    uint8_t first_handler_of_operation = HANDLER_MOV_REG_REG_0;
+    if (operation == OPERATION_ADD) {
+        first_handler_of_operation = HANDLER_ADD_REG_REG_0;
+    } else if (operation == OPERATION_SUB) {
+        first_handler_of_operation = HANDLER_SUB_REG_REG_0;
+    } else if (operation == OPERATION_CMP) {
+        first_handler_of_operation = HANDLER_CMP_REG_REG_0;
+    }
+    executable->handler =
+        (uint8_t)(first_handler_of_operation + (form * 2) + w);
+}
+
+/*
+Translates the block starting at CS:start_ip and adds it to the cache. The
+block stops early (without an error) at anything we can't translate, so the
+error only happens if we actually get there. Returns NULL if even the 1st
+instruction can't be translated
+*/
+static BasicBlock * translate_block(
+    Simulator * simulator,
+    const uint16_t start_ip,
+    uint32_t * good)
+{
+    if (
+        simulator->blocks_size == BLOCKS_CAP ||
+        simulator->block_instructions_size + MAX_BLOCK_INSTRUCTIONS + 1 >
+            BLOCK_INSTRUCTIONS_CAP)
+    {
+        flush_blocks(simulator);
+    }
+
+    BasicBlock * block = &simulator->blocks[simulator->blocks_size];
+    block->instructions =
+        &simulator->block_instructions[simulator->block_instructions_size];
+    block->instructions_count = 0;
+    block->start_ip = start_ip;
+    block->successors[0] = NULL;
+    block->successors[1] = NULL;
+
+    uint32_t ip = start_ip;
+    uint32_t ends_with_jump = false;
+    while (true) {
+        ExecutableInstruction * executable =
+            &block->instructions[block->instructions_count];
+        translate_instruction(
+            /* Simulator * simulator: */
+                simulator,
+            /* const uint16_t ip: */
+                (uint16_t)ip,
+            /* const uint32_t report_errors: */
+                block->instructions_count == 0,
+            /* ExecutableInstruction * executable: */
+                executable,
+            /* uint32_t * good: */
+                good);
+        if (!*good) {
+            if (block->instructions_count == 0) {
+                return NULL;
+            }
+            *good = true;
+            break;
+        }
+
+        block->instructions_count += 1;
+        ip += executable->length;
+
+        if (executable->handler >= HANDLER_JO) {
+            uint16_t target = (uint16_t)(ip + executable->immediate);
+            simulator->is_jump_target[target] = true;
+            ends_with_jump = true;
+            break;
+        }
+        if (
+            ip >= simulator->program_end ||
+            simulator->is_jump_target[ip] ||
+            block->instructions_count == MAX_BLOCK_INSTRUCTIONS)
+        {
+            break;
+        }
+    }
+
+    uint32_t entries = block->instructions_count;
+    if (!ends_with_jump) {
+        block->instructions[entries].handler = HANDLER_END_BLOCK;
+        entries += 1;
+    }
+    block->end_ip = ip;
+
+    for (uint32_t i = start_ip; i < ip && i < CODE_SEGMENT_SIZE; i++) {
+        simulator->is_translated[i] = true;
+    }
+    simulator->block_at_ip[start_ip] = block;
+    simulator->blocks_size += 1;
+    simulator->block_instructions_size += entries;
+    simulator->blocks_translated += 1;
+    return block;
+}
+
+/*
+The operand accessors the handlers are built from. _0 is for bytes and _1 for
+words, so a handler can paste its w onto them
+*/
+#define READ_REG_0(index, shift) ((registers[index] >> (shift)) & 0xFF)
+#define READ_REG_1(index, shift) (registers[index])
+#define WRITE_REG_0(index, shift, value) \
+    registers[index] = (uint16_t)( \
+        (registers[index] & ~(0xFF << (shift))) | \
+        (((value) & 0xFF) << (shift)))
+#define WRITE_REG_1(index, shift, value) \
+    registers[index] = (uint16_t)(value)
+
+#define EFFECTIVE_ADDRESS() \
+    physical_address( \
+        simulator->segment_registers[instruction->segment], \
+        (uint16_t)( \
+            registers[instruction->base_1] + \
+            registers[instruction->base_2] + \
+            instruction->displacement))
+
+#define READ_DESTINATION_REG(w) \
+    READ_REG_##w(instruction->destination, instruction->destination_shift)
+#define WRITE_DESTINATION_REG(w, value) \
+    WRITE_REG_##w( \
+        instruction->destination, \
+        instruction->destination_shift, \
+        value)
+#define READ_SOURCE_REG(w) \
+    READ_REG_##w(instruction->source, instruction->source_shift)
+#define READ_DESTINATION_MEM(w) read_memory(simulator, address, w)
+#define WRITE_DESTINATION_MEM(w, value) \
+    write_memory(simulator, address, w, (uint16_t)(value))
+#define READ_SOURCE_MEM(w) read_memory(simulator, address, w)
+#define READ_SOURCE_IMM(w) (instruction->immediate)
+
+// only the forms with a memory operand need its address
+#define ADDRESS_REG_REG()
+#define ADDRESS_REG_IMM()
+#define ADDRESS_REG_MEM() uint32_t address = EFFECTIVE_ADDRESS();
+#define ADDRESS_MEM_REG() uint32_t address = EFFECTIVE_ADDRESS();
+#define ADDRESS_MEM_IMM() uint32_t address = EFFECTIVE_ADDRESS();
+
+// and only the ones writing to memory can change code
+#define CHECK_CODE_WRITE_REG_REG()
+#define CHECK_CODE_WRITE_REG_IMM()
+#define CHECK_CODE_WRITE_REG_MEM()
+#define CHECK_CODE_WRITE_MEM_REG() CHECK_CODE_WRITE()
+#define CHECK_CODE_WRITE_MEM_IMM() CHECK_CODE_WRITE()
+
+#define DESTINATION_OF_REG_REG REG
+#define DESTINATION_OF_REG_MEM REG
+#define DESTINATION_OF_REG_IMM REG
+#define DESTINATION_OF_MEM_REG MEM
+#define DESTINATION_OF_MEM_IMM MEM
+#define SOURCE_OF_REG_REG REG
+#define SOURCE_OF_REG_MEM MEM
+#define SOURCE_OF_REG_IMM IMM
+#define SOURCE_OF_MEM_REG REG
+#define SOURCE_OF_MEM_IMM IMM
+
+// 1 more level so DESTINATION_OF_... is expanded before it's pasted
+#define PASTE(a, b) a##b
+#define EXPAND_PASTE(a, b) PASTE(a, b)
+#define READ_DESTINATION(form, w) \
+    EXPAND_PASTE(READ_DESTINATION_, DESTINATION_OF_##form)(w)
+#define WRITE_DESTINATION(form, w, value) \
+    EXPAND_PASTE(WRITE_DESTINATION_, DESTINATION_OF_##form)(w, value)
+#define READ_SOURCE(form, w) \
+    EXPAND_PASTE(READ_SOURCE_, SOURCE_OF_##form)(w)
+
+// what each operation does with its operands
+#define EXECUTE_MOV(form, w) \
+    WRITE_DESTINATION(form, w, READ_SOURCE(form, w));
+#define REMEMBER_FOR_FLAGS(is_word, operation) \
+    lazy.left = left; \
+    lazy.right = right; \
+    lazy.result = result; \
+    lazy.w = is_word; \
+    lazy.from = operation;
+#define EXECUTE_ADD(form, w) { \
+    uint32_t left = READ_DESTINATION(form, w); \
+    uint32_t right = READ_SOURCE(form, w); \
+    uint32_t result = left + right; \
+    REMEMBER_FOR_FLAGS(w, LAZY_FLAGS_FROM_ADD) \
+    WRITE_DESTINATION(form, w, result); }
+#define EXECUTE_SUB(form, w) { \
+    uint32_t left = READ_DESTINATION(form, w); \
+    uint32_t right = READ_SOURCE(form, w); \
+    uint32_t result = left - right; \
+    REMEMBER_FOR_FLAGS(w, LAZY_FLAGS_FROM_SUB) \
+    WRITE_DESTINATION(form, w, result); }
+#define EXECUTE_CMP(form, w) { \
+    uint32_t left = READ_DESTINATION(form, w); \
+    uint32_t right = READ_SOURCE(form, w); \
+    uint32_t result = left - right; \
+    REMEMBER_FOR_FLAGS(w, LAZY_FLAGS_FROM_SUB) }
+
+void simulator_run(
+    Simulator * simulator,
+    const uint64_t max_instructions,
+    uint32_t * good)
+{
+    /*
+    Threaded dispatch: every handler ends by jumping straight to the handler
+    of the next instruction in its block (computed goto, a GCC / Clang
+    extension), so there's no central switch and every handler gets its own
+    branch prediction. The labels are in Handler order.
+    Only the jumps at the end of a block look at the IP to find the next
+    block, and after the 1st time they don't even do that, the blocks are
+    chained
+    */
+    static void * handler_labels[HANDLERS_COUNT] = {
+        &&handle_end_block,
+        #define ALU_HANDLER_LABEL(operation, form, w) \
+            &&handle_##operation##_##form##_##w,
+        FOR_EACH_ALU_HANDLER(ALU_HANDLER_LABEL)
+        #undef ALU_HANDLER_LABEL
+        #define JUMP_HANDLER_LABEL(condition) &&handle_##condition,
+        FOR_EACH_JUMP_HANDLER(JUMP_HANDLER_LABEL)
+        #undef JUMP_HANDLER_LABEL
+        &&handle_loop,
+        &&handle_loopz,
+        &&handle_loopnz,
+        &&handle_jcxz,
+    };
+
+    /*
+    When profiling, every instruction first goes through profile_instruction
+    instead, which then jumps to its real handler. That way the handlers
+    don't need to check whether we're profiling
+    */
+    static void * profile_labels[HANDLERS_COUNT] = {
+        &&handle_end_block, // not an instruction
+        #define ALU_PROFILE_LABEL(operation, form, w) &&profile_instruction,
+        FOR_EACH_ALU_HANDLER(ALU_PROFILE_LABEL)
+        #undef ALU_PROFILE_LABEL
+        #define JUMP_PROFILE_LABEL(condition) &&profile_instruction,
+        FOR_EACH_JUMP_HANDLER(JUMP_PROFILE_LABEL)
+        #undef JUMP_PROFILE_LABEL
+        &&profile_instruction,
+        &&profile_instruction,
+        &&profile_instruction,
+        &&profile_instruction,
+    };
+    void ** dispatch_labels =
+        simulator->profile ? profile_labels : handler_labels;
+    uint32_t profile = simulator->profile;
+    uint64_t * clocks_at_ip = simulator->clocks_at_ip;
+
+    *good = true;
+    BasicBlock ** block_at_ip = simulator->block_at_ip;
+    uint16_t * registers = simulator->registers;
+    uint16_t ip = simulator->ip;
+    uint16_t flags = simulator->flags;
+    LazyFlags lazy = {0}; // LAZY_FLAGS_NONE
+    uint64_t executed = 0;
+    uint64_t limit = max_instructions > 0 ? max_instructions : UINT64_MAX;
+    BasicBlock * block = NULL;
+    ExecutableInstruction * instruction = NULL;
+
+    /*
+    The block (and which of its successors) we left without a chain, it gets
+    chained to wherever we end up
+    */
+    BasicBlock * chain_from = NULL;
+    uint32_t chain_successor_i = 0;
+
+    #define DISPATCH() \
+        if (executed >= limit) { \
+            goto finished; \
+        } \
+        goto *dispatch_labels[instruction->handler];
+
+    // every instruction moves the IP past itself before it executes
+    #define NEXT() \
+        executed += 1; \
+        instruction += 1; \
+        DISPATCH();
+
+    // leaves the block, the IP is already where its successor starts
+    #define FOLLOW(successor_i) \
+        if (block->successors[successor_i] != NULL) { \
+            block = block->successors[successor_i]; \
+            instruction = block->instructions; \
+            DISPATCH(); \
+        } \
+        chain_from = block; \
+        chain_successor_i = successor_i; \
+        goto next_block;
+
+    // a write flushed the blocks, maybe even this 1
+    #define CHECK_CODE_WRITE() \
+        if (simulator->code_was_written) { \
+            simulator->code_was_written = false; \
+            executed += 1; \
+            chain_from = NULL; \
+            goto next_block; \
+        }
+
+    next_block:
+        if (executed >= limit || ip >= simulator->program_end) {
+            goto finished;
+        }
+        block = block_at_ip[ip];
+        if (block == NULL) {
+            uint64_t flushes = simulator->block_cache_flushes;
+            block = translate_block(simulator, ip, good);
+            if (!*good) {
+                goto finished;
+            }
+            if (simulator->block_cache_flushes != flushes) {
+                chain_from = NULL; // flushed to make room
+            }
+        }
+        if (chain_from != NULL) {
+            chain_from->successors[chain_successor_i] = block;
+            chain_from = NULL;
+        }
+        instruction = block->instructions;
+        DISPATCH();
+
+    profile_instruction:
+        clocks_at_ip[ip] += instruction->clocks;
+        simulator->runs_at_ip[ip] += 1;
+        goto *handler_labels[instruction->handler];
+
+    handle_end_block:
+        FOLLOW(0)
+
+    #define ALU_HANDLER(operation, form, w) \
+        handle_##operation##_##form##_##w: { \
+            ip += instruction->length; \
+            ADDRESS_##form() \
+            EXECUTE_##operation(form, w) \
+            CHECK_CODE_WRITE_##form() \
+            NEXT(); \
+        }
+    FOR_EACH_ALU_HANDLER(ALU_HANDLER)
+    #undef ALU_HANDLER
+
+    #define JUMP_HANDLER(condition, is_met) \
+        handle_##condition: { \
+            ip += instruction->length; \
+            executed += 1; \
+            if (is_met) { \
+                if (profile) { \
+                    clocks_at_ip[(uint16_t)(ip - instruction->length)] += \
+                        instruction->extra_clocks_if_taken; \
+                } \
+                ip += instruction->immediate; \
+                FOLLOW(1) \
+            } \
+            FOLLOW(0) \
+        }
+    #define CARRY lazy_flag(&lazy, flags, FLAG_CARRY)
+    #define ZERO lazy_flag(&lazy, flags, FLAG_ZERO)
+    #define SIGN lazy_flag(&lazy, flags, FLAG_SIGN)
+    #define OVERFLOW lazy_flag(&lazy, flags, FLAG_OVERFLOW)
+    #define PARITY lazy_flag(&lazy, flags, FLAG_PARITY)
+    JUMP_HANDLER(JO, OVERFLOW)
+    JUMP_HANDLER(JNO, !OVERFLOW)
+    JUMP_HANDLER(JB, CARRY)
+    JUMP_HANDLER(JNB, !CARRY)
+    JUMP_HANDLER(JE, ZERO)
+    JUMP_HANDLER(JNE_JNZ, !ZERO)
+    JUMP_HANDLER(JBE_JNA, CARRY || ZERO)
+    JUMP_HANDLER(JA, !CARRY && !ZERO)
+    JUMP_HANDLER(JS, SIGN)
+    JUMP_HANDLER(JNS, !SIGN)
+    JUMP_HANDLER(JP, PARITY)
+    JUMP_HANDLER(JNP, !PARITY)
+    JUMP_HANDLER(JL, SIGN != OVERFLOW)
+    JUMP_HANDLER(JNL, SIGN == OVERFLOW)
+    JUMP_HANDLER(JLE, ZERO || (SIGN != OVERFLOW))
+    JUMP_HANDLER(JG, !ZERO && (SIGN == OVERFLOW))
+
+    // LOOP doesn't change any flags, even though CX goes down
+    JUMP_HANDLER(loop, --registers[REGISTER_CX] != 0)
+    JUMP_HANDLER(loopz, --registers[REGISTER_CX] != 0 && ZERO)
+    JUMP_HANDLER(loopnz, --registers[REGISTER_CX] != 0 && !ZERO)
+    JUMP_HANDLER(jcxz, registers[REGISTER_CX] == 0)
+    #undef CARRY
+    #undef ZERO
+    #undef SIGN
+    #undef OVERFLOW
+    #undef PARITY
+    #undef JUMP_HANDLER
+    #undef CHECK_CODE_WRITE
+    #undef FOLLOW
+    #undef NEXT
+    #undef DISPATCH
+
+    finished:
+    simulator->ip = ip;
+    simulator->flags = materialize_flags(&lazy, flags);
+    simulator->instructions_executed += executed;
+}
+
+static void append_hex_word(
+    OutputBuffer * recipient,
+    const uint16_t value)
+{
+    char digits[7] = "0x0000";
+    for (uint32_t i = 0; i < 4; i++) {
+        digits[5 - i] = "0123456789abcdef"[(value >> (i * 4)) & 0xF];
+    }
+    output_append(recipient, digits);
+}
+
+static void append_register_line(
+    OutputBuffer * recipient,
+    const char * name,
+    const uint16_t value)
+{
+    output_append(recipient, "    ");
+    output_append(recipient, name);
+    output_append(recipient, ": ");
+    append_hex_word(recipient, value);
+    output_append(recipient, " (");
+    output_append_uint(recipient, value);
+    output_append(recipient, ")\n");
+}
+
+void append_simulator_state(
+    const Simulator * simulator,
+    OutputBuffer * recipient)
+{
+    static const char * register_names[8] =
+        {"ax", "cx", "dx", "bx", "sp", "bp", "si", "di"};
+    static const char * segment_names[4] = {"es", "cs", "ss", "ds"};
+
+    // in the order people usually list them: ax, bx, cx, dx, ...
+    static const uint8_t listing_order[8] = {
+        REGISTER_AX, REGISTER_BX, REGISTER_CX, REGISTER_DX,
+        REGISTER_SP, REGISTER_BP, REGISTER_SI, REGISTER_DI};
+
+    for (uint32_t i = 0; i < 8; i++) {
+        uint8_t reg = listing_order[i];
+        append_register_line(
+            recipient,
+            register_names[reg],
+            simulator->registers[reg]);
+    }
+    for (uint32_t i = 0; i < 4; i++) {
+        append_register_line(
+            recipient,
+            segment_names[i],
+            simulator->segment_registers[i]);
+    }
+    append_register_line(recipient, "ip", simulator->ip);
+
+    static const uint16_t flag_bits[6] = {
+        FLAG_CARRY, FLAG_PARITY, FLAG_AUXILIARY,
+        FLAG_ZERO, FLAG_SIGN, FLAG_OVERFLOW};
+    static const char * flag_letters[6] = {"C", "P", "A", "Z", "S", "O"};
+
+    output_append(recipient, "    flags: ");
+    for (uint32_t i = 0; i < 6; i++) {
+        if (simulator->flags & flag_bits[i]) {
+            output_append(recipient, flag_letters[i]);
+        }
+    }
+    output_append(recipient, "\n");
+}
+
+void append_profile_report(
+    Simulator * simulator,
+    const uint32_t max_instructions,
+    OutputBuffer * recipient)
+{
+    uint64_t total_clocks = 0;
+    for (uint32_t ip = 0; ip < CODE_SEGMENT_SIZE; ip++) {
+        total_clocks += simulator->clocks_at_ip[ip];
+    }
+    output_append(recipient, "estimated clocks: ");
+    output_append_uint64(recipient, total_clocks);
+    output_append(recipient, " in total\n");
+    if (total_clocks == 0) {
+        return;
+    }
+
+    /*
+    Picks the IP with the most clocks that's below the previous pick, we only
+    want a few of them so that's simpler than sorting all of them
+    */
+    uint64_t previous_clocks = UINT64_MAX;
+    uint32_t previous_ip = 0;
+    for (uint32_t line_i = 0; line_i < max_instructions; line_i++) {
+        uint64_t best_clocks = 0;
+        uint32_t best_ip = CODE_SEGMENT_SIZE;
+        for (uint32_t ip = 0; ip < CODE_SEGMENT_SIZE; ip++) {
+            uint64_t clocks = simulator->clocks_at_ip[ip];
+            // equal clocks are listed by IP
+            uint32_t is_after_previous =
+                clocks < previous_clocks ||
+                (clocks == previous_clocks && ip > previous_ip);
+            if (is_after_previous && clocks > best_clocks) {
+                best_clocks = clocks;
+                best_ip = ip;
+            }
+        }
+        if (best_ip == CODE_SEGMENT_SIZE) {
+            break;
+        }
+        previous_clocks = best_clocks;
+        previous_ip = best_ip;
+
+        uint64_t tenths_of_percent = (best_clocks * 1000) / total_clocks;
+        output_append(recipient, "    ip ");
+        append_hex_word(recipient, (uint16_t)best_ip);
+        output_append(recipient, ": ");
+        output_append_uint64(recipient, best_clocks);
+        output_append(recipient, " clocks (");
+        output_append_uint(recipient, (uint32_t)(tenths_of_percent / 10));
+        output_append(recipient, ".");
+        output_append_uint(recipient, (uint32_t)(tenths_of_percent % 10));
+        output_append(recipient, "%) in ");
+        output_append_uint64(recipient, simulator->runs_at_ip[best_ip]);
+        output_append(recipient, " runs: ");
+
+        // the code might have changed since, this is what's there now
+        DecodedInstruction instruction;
+        uint32_t decoded = true;
+        decode_instruction_at(
+            &simulator->decoder,
+            best_ip,
+            &instruction,
+            &decoded);
+        if (decoded) {
+            append_instruction_text(recipient, &instruction);
+            if (instruction.second_operand == OPERAND_JUMP_OFFSET) {
+                uint16_t target = (uint16_t)(
+                    best_ip + instruction.machine_bytes + instruction.data);
+                append_hex_word(recipient, target);
+            }
+        } else {
+            output_append(recipient, "(no instruction we know)");
+        }
+        output_append(recipient, "\n");
+    }
+}
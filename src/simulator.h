@@ -0,0 +1,197 @@
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <stdint.h>
+
+#include "disassembler.h"
+
+/*
+Runs 8086 programs, using the same decoder and opcode_table as the
+disassembler, so it can execute every form we can decode: MOV, ADD, SUB, CMP,
+the conditional jumps, LOOP/LOOPZ/LOOPNZ and JCXZ.
+
+The program is loaded at CS:0 with every segment register 0 and runs until
+the IP leaves the program (or a limit on the number of instructions is hit).
+*/
+
+#define SIMULATOR_MEMORY_SIZE (1024 * 1024)
+
+// the registers in reg_table order (the order the 'reg' field uses for w = 1)
+#define REGISTER_AX 0
+#define REGISTER_CX 1
+#define REGISTER_DX 2
+#define REGISTER_BX 3
+#define REGISTER_SP 4
+#define REGISTER_BP 5
+#define REGISTER_SI 6
+#define REGISTER_DI 7
+#define REGISTER_ZERO 8 // not a real register, always 0
+
+#define SEGMENT_ES 0
+#define SEGMENT_CS 1
+#define SEGMENT_SS 2
+#define SEGMENT_DS 3
+
+// bits in the flags register
+#define FLAG_CARRY     (1 << 0)
+#define FLAG_PARITY    (1 << 2)
+#define FLAG_AUXILIARY (1 << 4)
+#define FLAG_ZERO      (1 << 6)
+#define FLAG_SIGN      (1 << 7)
+#define FLAG_OVERFLOW  (1 << 11)
+
+/*
+What an opcode_table entry does when executed, the simulator works this out
+once per entry so it doesn't compare mnemonics while running
+*/
+typedef enum Operation {
+    OPERATION_UNSUPPORTED = 0,
+    OPERATION_MOV,
+    OPERATION_ADD,
+    OPERATION_SUB,
+    OPERATION_CMP,
+    OPERATION_JUMP_IF, // any of the 16 conditional jumps
+    OPERATION_LOOP,
+    OPERATION_LOOPZ,
+    OPERATION_LOOPNZ,
+    OPERATION_JCXZ,
+} Operation;
+
+/*
+An instruction translated for execution: everything that depends on its
+operand form (which registers, where the memory operand is, byte or word) is
+decided once, when it's translated, and picks which handler runs it. The
+handler then doesn't have to look at any OpCode flags
+*/
+typedef struct ExecutableInstruction {
+    uint8_t handler; // which specialized handler executes this
+    uint8_t length; // in bytes, the IP moves past it before it executes
+    uint8_t destination; // register index (for bytes: of the word holding it)
+    uint8_t destination_shift; // 8 for AH, CH, DH and BH, 0 otherwise
+    uint8_t source; // register index, like 'destination'
+    uint8_t source_shift;
+    uint8_t base_1; // memory operand: [base_1 + base_2 + displacement]
+    uint8_t base_2; // REGISTER_ZERO if there's no 2nd (or 1st) base
+    uint8_t segment; // SEGMENT_DS or SEGMENT_SS
+    uint8_t opcode_i; // index in opcode_table, for error messages
+    uint8_t clocks; // estimate_clocks(), for a jump: when it's not taken
+    uint8_t extra_clocks_if_taken;
+    uint16_t displacement;
+    uint16_t immediate; // immediate data or jump offset
+} ExecutableInstruction;
+
+/*
+A basic block: the instructions from 'start_ip' up to and including the first
+jump (or LOOP/JCXZ), translated once and then executed straight from its
+array. A block also ends right before an IP something jumps to, so every
+label starts its own block. If it ends without a jump its last entry is an
+extra one that only moves on to the next block
+*/
+typedef struct BasicBlock {
+    ExecutableInstruction * instructions;
+    uint32_t instructions_count; // not counting the extra one
+    uint32_t start_ip;
+    uint32_t end_ip; // the IP right after its last instruction
+
+    /*
+    Chaining: the block that runs next when the jump at the end isn't taken
+    (or there's no jump), and the one when it is. Filled in the first time
+    we go there, after that we go straight from block to block
+    */
+    struct BasicBlock * successors[2];
+} BasicBlock;
+
+typedef struct Simulator {
+    /*
+    AX, CX, DX, BX, SP, BP, SI, DI and then 1 register that is always 0, so
+    every memory operand can be computed as 2 registers + displacement
+    */
+    uint16_t registers[9];
+    uint16_t segment_registers[4]; // ES, CS, SS, DS
+    uint16_t ip;
+    uint16_t flags;
+
+    uint8_t * memory; // SIMULATOR_MEMORY_SIZE bytes
+
+    /*
+    The basic block cache. block_at_ip[ip] is the block starting at CS:ip, or
+    NULL if we didn't get there yet. The blocks and their instructions are
+    allocated from 2 fixed pools, when either is full we flush everything
+    and start over. We also flush when the program writes to memory that
+    any block was translated from ('is_translated'), so self-modifying code
+    still works
+    */
+    BasicBlock * blocks;
+    uint32_t blocks_size;
+    ExecutableInstruction * block_instructions;
+    uint32_t block_instructions_size;
+    BasicBlock ** block_at_ip; // 65536 entries
+    uint8_t * is_translated; // per code segment byte
+    uint8_t * is_jump_target; // per code segment byte, blocks start there
+    uint32_t code_was_written; // set by a write that flushed the blocks
+    DecoderContext decoder; // its input is the code segment in 'memory'
+
+    uint8_t operations[OPCODE_TABLE_SIZE]; // Operation per opcode_table entry
+
+    uint32_t program_end; // the IP at which we stop
+    uint64_t instructions_executed;
+    uint64_t blocks_translated;
+    uint64_t block_cache_flushes;
+
+    /*
+    If 'profile' is set, simulator_run() adds up the estimated 8086 clocks
+    (see estimate_clocks()) and the number of runs of every instruction, by
+    the IP it's at. It's off by default, when off it costs nothing
+    */
+    uint32_t profile;
+    uint64_t * clocks_at_ip; // 65536 entries
+    uint64_t * runs_at_ip; // 65536 entries
+} Simulator;
+
+void simulator_init(Simulator * simulator);
+
+void simulator_free(Simulator * simulator);
+
+/*
+Resets the registers and memory and copies 'program' to CS:0
+*/
+void simulator_load(
+    Simulator * simulator,
+    const uint8_t * program,
+    const uint32_t program_size,
+    uint32_t * good);
+
+/*
+Executes instructions until the IP leaves the program, or until
+'max_instructions' more have been executed (0 means no limit). Sets 'good' to
+false if it hits something it can't decode or execute, the IP is then left
+at that instruction
+*/
+void simulator_run(
+    Simulator * simulator,
+    const uint64_t max_instructions,
+    uint32_t * good);
+
+/*
+Appends the registers and flags as text, for example:
+    ax: 0x0037 (55)
+    ...
+    flags: PZ
+*/
+void append_simulator_state(
+    const Simulator * simulator,
+    OutputBuffer * recipient);
+
+/*
+Appends the instructions with the most estimated clocks (at most
+'max_instructions' of them) from a run with 'profile' set, and the total:
+    estimated clocks: 1234 in total
+    ip 0x0005: 532 clocks (43.1%) in 20 runs: add ax, 1
+    ...
+*/
+void append_profile_report(
+    Simulator * simulator,
+    const uint32_t max_instructions,
+    OutputBuffer * recipient);
+
+#endif // SIMULATOR_H